@@ -86,11 +86,17 @@
 
 ; // void fftR4(short *y, short *x, int N);   // radix 4 FFT
 ; // void ifftR4(short *y, short *x, int N);  // radix 4 inverse FFT
+; // and the same two with the coefficient table passed in (e.g. built in RAM, see fft_plan.h)
+; // void fftR4c(short *y, short *x, int N, const short *c);
+; // void ifftR4c(short *y, short *x, int N, const short *c);
+; // c is the coef_table layout below, from N=16 up to at least the N used
          
 ;        .syntax unified
 ;//    .thumb
     EXPORT fftR4  
     EXPORT ifftR4   
+    EXPORT fftR4c
+    EXPORT ifftR4c
 
     AREA FFT, CODE, READONLY
 
@@ -271,7 +277,9 @@ TableRBIT_V1
 ;        nop.n //alignment optimization
 
 ifftR4 
-        push {r4-r11, lr}
+        adr      r3, coef_table
+ifftR4c
+        push {r3-r11, lr}  ;// c is kept at [sp] until the stages need it
         mov      tmp0, #0  ;// bit reversed counter
         movs     tmp1, N    ; //; first tmp1=N  
         MYRBIT   R, N
@@ -308,7 +316,9 @@ L2
 ; // void fftR4(short *y, short *x, int N)
 ;      .thumb_func
 fftR4
-        push {r4-r11, lr}
+        adr     r3, coef_table
+fftR4c
+        push {r3-r11, lr}  ;// c is kept at [sp] until the stages need it
         mov     tmp0, #0 ;           // bit reversed counter
         mov     tmp1, #0
         MYRBIT  R, N
@@ -335,8 +345,8 @@ firstStageFinished        ;// finished the first stage
         sub     x, y, N, lsl #2  ; // x = working buffer
         mov     R, #16
         lsrs Bl,N, #4  
-        popeq  {r4-r11, pc}     ;// for N==4 return from function
-        adr     c, coef_table    ;//change if table in RAM 
+        popeq  {r3-r11, pc}     ;// for N==4 return from function
+        ldr     c, [sp]          ;// coef_table or the caller's table
                 
 nextStage
         ;// Bl = the number of blocks
@@ -385,7 +395,7 @@ nextButterfly
         mov     R, R, lsl#2     ;// block size *=4
         lsrs Bl,Bl, #2            ;//# of blocks /=4
         bne     nextStage
-        pop    {r4-r11, pc}     ;//return
+        pop    {r3-r11, pc}     ;//return
       
         align 4 ;//32 bit access acceleration
 
@@ -5,8 +5,21 @@
  
 #include "mbed.h"
 #include "MODDMA.h"
+#include "adc_defs.h"
+#include "logger.h"
+#include "sram.h"
 
 #define SAMPLE_BUFFER_LENGTH 1000
+#define LOG_FILE "/local/PEAKLOG.THL"  //Binary, logger_dump turns it into CSV
+
+//Log events, what goes in a and b
+enum {
+    LOG_SAMPLE,     //12 bit code, index
+    LOG_SLOPE,      //slope, index
+    LOG_PEAK,       //-, index
+    LOG_FREQUENCY   //-, estimate in Hz
+};
+static const char *const log_names[] = { "sample", "slope", "peak", "frequency" };
 
 DigitalOut led1(LED1);
 DigitalOut led2(LED2);
@@ -33,10 +46,14 @@ LocalFileSystem local("local");
 
 bool slope = false;
 
+//DMA destination, in the AHB0 bank rather than on main()'s stack
+uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH] SRAM_IN(AHB0);
+SRAM_LIST(AHB0, adcInputBuffer);
+
 
 int main() {
 
-    uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH];    
+    if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
     memset(adcInputBuffer, 0, sizeof(adcInputBuffer));
     
     // We use the ADC irq to trigger DMA and the manual says
@@ -65,10 +82,8 @@ int main() {
     
     
     
-    // Open up output file for debugging
-    FILE *log = fopen("/local/log.txt","w");
-    fprintf(log,"ADC with DMA example\n");
-    fprintf(log,"====================\n");
+    //Debug log, nothing here has a deadline so a full ring is written out on the spot
+    logger_start(LOG_FILE, log_names, 4, LOGGER_FLUSH_INLINE);
     
     
     //Configuration for DMA
@@ -87,12 +102,9 @@ int main() {
             delete conf; // No memory leaks, delete the configuration.
             dmaTransferComplete = false;
             
-			//RAW DATA PRINTING BLOCK
+			//RAW DATA LOGGING BLOCK, a record per sample into RAM, volts are worked out on the PC
             for (int i = 0; i < SAMPLE_BUFFER_LENGTH; i++) {
-                int channel = (adcInputBuffer[i] >> 24) & 0x7;
-                int iVal = (adcInputBuffer[i] >> 4) & 0xFFF;
-                double fVal = 3.3 * (double)((double)iVal) / ((double)0x1000); // scale to 0v to 3.3v
-                fprintf(log,"Array index %02d : ADC input channel %d = 0x%03x %01.3f volts\n", i, channel, iVal, fVal);                  
+                logger_write(LOG_SAMPLE, ADC_CHANNEL(adcInputBuffer[i]), ADC_RESULT(adcInputBuffer[i]), i);
             }
             
             //Starting off the Peak Detector Sequence
@@ -101,9 +113,8 @@ int main() {
             //PeakTicker is the counter for PeakBuf
             
             
-            fprintf(log, "Peak Detection Starting");
             slope = cal_slope(adcInputBuffer[2], adcInputBuffer[1]);
-            fprintf(log, "Slope starts %s", slope);
+            logger_write(LOG_SLOPE, 0, slope, 0);
             int PeakBuf[10];
                 memset(PeakBuf, 0, sizeof(PeakBuf));
             int diffBuff[9];
@@ -111,13 +122,13 @@ int main() {
 			int PeakTicker = 0;
             double sum =0;
             for(int i = 1; i < SAMPLE_BUFFER_LENGTH - 1; i++){
-                fprintf(log, "Slope is %s @ index %d\n", slope,i);
+                logger_write(LOG_SLOPE, 0, slope, i);
                 switch(cal_slope(adcInputBuffer[i], adcInputBuffer[i-1])){
 					case 1:
 						if (slope == false){  // This is the condition in which you have found a Peak
 							PeakBuf[PeakTicker] = i - 1; //Detects Peak After it has passed
 							PeakTicker++;				 //Increment index of PeakBuf
-							fprintf(log, "There is a peak @ index %d\n",i);
+							logger_write(LOG_PEAK, 0, 0, i);
 
 						 }
 						 break;
@@ -132,10 +143,10 @@ int main() {
 			for (int i = 0; i < sizeof(PeakBuf); i++){
 				sum += diffBuff[i];
 			}
-			int mean = 200000/sum;
+			int mean = adc_sample_rate(LPC_ADC->ADCR, 0)/sum;	//Burst rate from CLKDIV, was a guessed 200000
 			
-			fprintf(log,"The estimated frequency is %d\n", (int)mean);
-			fclose(log);
+			logger_write(LOG_FREQUENCY, 0, 0, mean);
+			logger_stop();
 
         // Just flash LED1 for something to do.
         led1 = !led1;
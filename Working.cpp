@@ -5,34 +5,60 @@
  
 #include "mbed.h"
 #include "MODDMA.h"
+#include "adc_defs.h"
+#include "logger.h"
+#include "scheduler.h"
 
 #define SAMPLE_BUFFER_LENGTH 4800
+#define LOG_FILE   "/local/ADCLOG.THL"  //Binary, logger_dump turns it into CSV
+#define LOG_EVERY  8        //A record per sample would be 57KB a block, every 8th fits the ring
+#define LOG_BLOCKS 100      //Blocks logged before the file is closed
+
+//Log events: a is the 12 bit code, b the index in the buffer; block has the block number in b
+enum { LOG_BLOCK, LOG_SAMPLE };
+static const char *const log_names[] = { "block", "sample" };
+static int blocks_logged = 0;
 
 DigitalOut led1(LED1);
 DigitalOut led2(LED2);
 
 MODDMA dma;
 
-// ISR set's this when transfer complete.
-bool dmaTransferComplete = false;
-
 LocalFileSystem local("local"); //Creating local filesystem 
 
+Serial pc(USBTX, USBRX);
+
+Ticker heartbeat;   //Posts EVT_HEARTBEAT, replaces wait(0.25) in the old polling loop
+
 
 // Function prototypes for IRQ callbacks.
 // See definitions following main() below.
 void TC0_callback(void);
 void ERR0_callback(void);
+
+// Event handlers, run from sched_run() in priority order
+void adc_block_handler(void);
+void heartbeat_handler(void);
+void heartbeat_tick(void);
+
 MODDMA_Config conf;
+
+// Create a buffer to hold the ADC samples.
+// Note, we are going to sample two ADC inputs so they
+// end up in this buffer "interleaved". So you will want
+// a buffer twice this size to a real life given sample
+// frequency. See the printf() output for details.
+// It lives outside main() so the event handlers can reach it.
+uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH];    
+
 int main() {
 
-    // Create a buffer to hold the ADC samples and clear it.
-    // Note, we are going to sample two ADC inputs so they
-    // end up in this buffer "interleaved". So you will want
-    // a buffer twice this size to a real life given sample
-    // frequency. See the printf() output for details.
-    uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH];    
     memset(adcInputBuffer, 0, sizeof(adcInputBuffer));
+
+    sched_init();
+    sched_attach(EVT_ADC_BLOCK, &adc_block_handler);
+    sched_attach(EVT_HEARTBEAT, &heartbeat_handler);
+    sched_attach(EVT_LOG_FLUSH, &logger_flush_handler);
     
     // We use the ADC irq to trigger DMA and the manual says
     // that in this case the NVIC for ADC must be disabled.
@@ -56,6 +82,10 @@ int main() {
     pc.printf("ADC with DMA example\n");
     pc.printf("====================\n");
     
+    //Real-time from here on: the file is only written when the core would sleep, and a
+    //full ring loses the newest records (logged as a gap) rather than stall anything
+    if (!logger_start(LOG_FILE, log_names, 2, LOGGER_DROP_NEWEST)) pc.printf("Cannot create %s\n", LOG_FILE);
+    
     // Prepare an ADC configuration.
     
     conf
@@ -86,26 +116,36 @@ int main() {
     // Enable burst mode on inputs 0 and 1.
     LPC_ADC->ADCR |= (1UL << 16); 
     
-    while (1) {
-        // When transfer complete do this block.
-        if (dmaTransferComplete) {
-            //delete conf; // No memory leaks, delete the configuration.
-            dmaTransferComplete = false;
-            for (int i = 0; i < SAMPLE_BUFFER_LENGTH; i++) {
-                int channel = (adcInputBuffer[i] >> 24) & 0x7;
-                int iVal = (adcInputBuffer[i] >> 4) & 0xFFF;
-                double fVal = 3.3 * (double)((double)iVal) / ((double)0x1000); // scale to 0v to 3.3v
-                FILE *log = fopen("/local/output.txt","w");
-                fprintf(*log,"Array index %02d : ADC input channel %d = 0x%03x %01.3f volts\n", i, channel, iVal, fVal);                  
-            }
-        }
-        
-        // Just flash LED1 for something to do.
-        led1 = !led1;
-        wait(0.25);        
+    heartbeat.attach(&heartbeat_tick, 0.25);
+
+    // Nothing else to do here, the core sleeps until an ISR posts an event
+    sched_run();
+}
+
+// Runs when the DMA has filled adcInputBuffer, records go to RAM and EVT_LOG_FLUSH writes them at idle
+void adc_block_handler(void) {
+    if (blocks_logged == LOG_BLOCKS) return;
+    logger_write(LOG_BLOCK, 0, 0, blocks_logged);
+    for (int i = 0; i < SAMPLE_BUFFER_LENGTH; i += LOG_EVERY) {
+        logger_write(LOG_SAMPLE, ADC_CHANNEL(adcInputBuffer[i]), ADC_RESULT(adcInputBuffer[i]), i);
+    }
+    if (++blocks_logged == LOG_BLOCKS) {
+        logger_stop();
+        pc.printf("Logged %u records, dropped %u\n", logger_records_written(), logger_records_dropped());
     }
 }
 
+// Just flash LED1 for something to do, and show how busy the core is.
+void heartbeat_handler(void) {
+    led1 = !led1;
+    uint32_t idle = sched_idle_permille(true);
+    pc.printf("CPU idle %u.%u%%\n", idle / 10, idle % 10);
+}
+
+void heartbeat_tick(void) {
+    sched_post(EVT_HEARTBEAT);
+}
+
 // Configuration callback on TC
 void TC0_callback(void) {
     
@@ -119,8 +159,8 @@ void TC0_callback(void) {
     dma.haltAndWaitChannelComplete( (MODDMA::CHANNELS)config->channelNum());
     dma.Disable( (MODDMA::CHANNELS)config->channelNum() );
     
-    // Tell main() while(1) loop to print the results.
-    dmaTransferComplete = true;            
+    // Tell the scheduler to print the results.
+    sched_post(EVT_ADC_BLOCK);
     
     // Switch on LED2 to show transfer complete.
     led2 = 1;        
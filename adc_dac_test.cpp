@@ -27,6 +27,8 @@ The DMA Channels:
 
 #include "mbed.h"
 #include "MODDMA.h"
+#include "scheduler.h"
+#include "sram.h"
 
 AnalogOut output(p18);       
 
@@ -43,7 +45,8 @@ void ERR1_callback(void);
 void TC2_callback(void);
 void TC2_callback(void);
 
-int wave_table[2][OUTPUT_BUFFER_LENGTH];
+int wave_table[2][OUTPUT_BUFFER_LENGTH] SRAM_IN(AHB1);  //DMA source, away from the CPU's SRAM
+SRAM_LIST(AHB1, wave_table);
 int NoteVal = 152;
 /* 
  * Determining the value for DACCNTVAL
@@ -70,6 +73,7 @@ uint16_t NoteBuffer[] =
 
 
 int main() {
+    if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
 /*
  * Generation of a Sine Wave of 360 Points
  */
@@ -174,9 +178,9 @@ int main() {
         
         
 
-    while(1) {
-		//
-       }
+    //The DMA ISRs do all the work, so the core can sleep in between
+    sched_init();
+    sched_run();
 }
 
 void TC0_callback(void){
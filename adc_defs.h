@@ -0,0 +1,96 @@
+/*
+ * ADC Definitions
+ * Objective: One place for the LPC17xx ADC register bits and result word layout
+ *
+ * Every program used to re-type (adcInputBuffer[i] >> 4) & 0xFFF and friends.
+ * These come from Ch.29 of the LPC17xx User Manual.
+ *
+ * Result word (ADGDR / ADDRn, what the DMA copies into memory):
+ *   Bits 15:4  RESULT   12 bit conversion
+ *   Bits 26:24 CHN      Channel the result came from
+ *   Bit  30    OVERRUN  A result was overwritten before it was read
+ *   Bit  31    DONE     Conversion finished
+ */
+
+#ifndef ADC_DEFS_H
+#define ADC_DEFS_H
+
+#include <stdint.h>
+
+#define ADC_RESULT(w)   (((w) >> 4) & 0xFFF)
+#define ADC_CHANNEL(w)  (((w) >> 24) & 0x7)
+#define ADC_OVERRUN(w)  (((w) >> 30) & 0x1)
+#define ADC_DONE(w)     (((w) >> 31) & 0x1)
+
+//Builds a result word the way the hardware would, used by the host simulator
+#define ADC_WORD(ch, code) ((1UL << 31) | (((uint32_t)(ch) & 0x7) << 24) | (((uint32_t)(code) & 0xFFF) << 4))
+
+//ADCR fields
+#define ADCR_SEL(mask)     ((uint32_t)(mask) & 0xFF)        //Bits 7:0 channel select
+#define ADCR_CLKDIV(div)   (((uint32_t)(div) & 0xFF) << 8)  //Bits 15:8 ADC clock = PCLK/(CLKDIV+1), must be <= 13MHz
+#define ADCR_BURST         (1UL << 16)
+#define ADCR_PDN           (1UL << 21)
+#define ADCR_START(mode)   (((uint32_t)(mode) & 0x7) << 24) //Bits 26:24, only with BURST = 0 and one channel selected
+#define ADCR_START_MASK    (7UL << 24)
+#define ADCR_EDGE          (1UL << 27)                      //0 = rising edge on the match output starts a conversion
+
+//START modes
+#define ADC_START_NOW      1
+#define ADC_START_MAT10    6    //Edge on MAT1.0, see adc_timer.h
+
+#define ADC_CLKS_PER_SAMPLE 65  //This is the number of cycles it takes to convert a sample
+
+//PCLK_ADC with PCLKSEL0 bits 25:24 = 00, CCLK/4 96M/4 = 24MHz
+#define ADC_PCLK_HZ 24000000UL
+
+//PCLK_TIMER1 with PCLKSEL0 bits 5:4 = 00, also CCLK/4
+#define ADC_TIMER_PCLK_HZ 24000000UL
+
+//Number of channels selected in an ADCR value
+static inline int adcr_channel_count(uint32_t adcr) {
+    int n = 0;
+    for (int i = 0; i < 8; i++) if (adcr & (1UL << i)) n++;
+    return n;
+}
+
+/*
+ * Per-channel sample rate in burst mode
+ * Burst converts the selected channels round robin as fast as the ADC clock allows,
+ * so the rate is PCLK/(CLKDIV+1)/65 split between the channels
+ * e.g. CLKDIV = 1 -> 12MHz/65 = 184.6kHz on one channel
+ */
+static inline uint32_t adc_burst_rate(uint32_t adcr) {
+    uint32_t clkdiv = (adcr >> 8) & 0xFF;
+    int channels = adcr_channel_count(adcr);
+    if (channels == 0) channels = 1;
+    return ADC_PCLK_HZ / (clkdiv + 1) / ADC_CLKS_PER_SAMPLE / channels;
+}
+
+/*
+ * Per-channel sample rate when Timer 1 triggers conversions
+ * MAT1.0 toggles on every MR0 match and only its rising edge starts a conversion,
+ * so one sample takes two match periods: PCLK/(2*(MR0+1))
+ * Rounded to the nearest Hz, exact whenever the rate divides 12MHz (8k, 16k, 32k, 48k, 96k...)
+ */
+static inline uint32_t adc_timer_rate(uint32_t mr0) {
+    uint32_t ticks = 2 * (mr0 + 1);
+    return (ADC_TIMER_PCLK_HZ + ticks / 2) / ticks;
+}
+
+//MR0 for the nearest achievable rate
+static inline uint32_t adc_timer_match(uint32_t rate) {
+    uint32_t ticks = (ADC_TIMER_PCLK_HZ / 2 + rate / 2) / rate;
+    return ticks ? ticks - 1 : 0;
+}
+
+/*
+ * The one place the rest of the code should get the sample rate from
+ * Works out which mode the ADCR is set up for and returns that mode's rate,
+ * mr0 is only looked at for timer triggered conversions
+ */
+static inline uint32_t adc_sample_rate(uint32_t adcr, uint32_t mr0) {
+    if ((adcr & ADCR_START_MASK) == ADCR_START(ADC_START_MAT10)) return adc_timer_rate(mr0);
+    return adc_burst_rate(adcr);
+}
+
+#endif
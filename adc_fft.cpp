@@ -2,79 +2,430 @@
  * Sampling with FFT
  * Tim Alexander
  * November 23, 2011
+ *
+ * Results go out as binary telemetry frames (telemetry.h), decode them on the PC with
+ * telemetry_decode. Every block sends pitch, every TIMING_EVERY blocks the stage timings,
+ * every SPECTRUM_EVERY blocks a decimated spectrum and once a second the CPU load.
+ *
+ * The frame size can be changed while running: send 'f' for MN_FAST frames
+ * (low latency, for fast passages) or 'r' for MN_FINE frames (finer bins, for
+ * held notes). The FFT runs from an FftPlan, twiddles in RAM.
+ *
+ * Send 'p' for the cycle profile (profile.h): the next status report is followed
+ * by one TLM_PROFILE frame per stage, and the counters start over.
+ *
+ * The health counters (health.h) go out with every status report as TLM_HEALTH:
+ * bad ADC words, blocks dropped before analysis, how late the TC interrupt ran and
+ * how long the DMA was off.
+ *
+ * Analysis is lazy (change_detect.h): while the block looks like the last analysed
+ * one (same level, same zero crossing spacing) the FFT is skipped and the last pitch
+ * is sent again. The status report carries the share of blocks skipped.
+ *
+ * The tracked antenna pitch is mapped to the pitch to play through the calibration
+ * table (calibration.h), loaded from CALIB_FILE at boot, straight through if there
+ * is none. To record a new one: send 'c', then for each note the TLM_CALIB frame
+ * asks for (CALIB_STEP semitones apart from CALIB_FIRST_NOTE) hold the hand where
+ * it should play and send 'n'. 's' builds the table, saves it and puts it in use.
+ *
+ * Send 'm' to turn the MIDI output on or off (midi_out.h): UART3 (p9 TX, through the
+ * usual opto/5 pin DIN circuit) plays the played pitch as a note with 14 bit pitch
+ * bend and the input level as MIDI_CONTROLLER, on MIDI_CHANNEL. The bytes are put
+ * together as the UART takes them, from the newest result, and each status report
+ * is followed by a TLM_MIDI frame with the message counts and the result to UART latency.
+ *
+ * The DMA fills adcInputBuffer in the AHB0 SRAM bank (sram.h) while the FFT works in
+ * local SRAM, so neither waits on the other for the bus. Boot stops with an error if
+ * the linker did not put it there.
+ *
+ * The DMA ping-pongs between the two halves of adcInputBuffer, as adc_record.cpp
+ * does: the TC interrupt for one arms the other, so the ADC is never left
+ * converting into a stopped channel and the overrun count only moves when a
+ * conversion really was lost.
+ *
+ * The DMA Channels:
+ *     Channel 0 : ADC Buffer 0
+ *     Channel 1 : ADC Buffer 1
  */
 
 
-#include 'mbed.h'
-#include 'MODDMA.h'
+#include "mbed.h"
+#include "MODDMA.h"
+#include "adc_defs.h"
+#include "adc_timer.h"
+#include "adc_unpack.h"
+#include "calibration.h"
+#include "change_detect.h"
+#include "cycle_counter.h"
+#include "fft_plan.h"
+#include "fft_sized.h"
+#include "frontend.h"
+#include "health.h"
+#include "midi_out.h"
+#include "pitch.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "sram.h"
+#include "telemetry.h"
 
 
-#define MN 256 //This is the number of points for the FFT
-#define SAMPLE_RATE 48000	//48kHz is standard sampling rate
-#define SAMPLE_BUFFER_LENGTH 4000 //Need to math this out
+#define MN_FAST 256	//5.3ms frames, 188Hz bins at 48kHz
+#define MN_FINE 1024	//21ms frames, 47Hz bins
+#define MN MN_FINE		//Buffers are sized for the biggest frame
+#define SAMPLE_RATE 48000	//Timer triggered, exact since it divides 12MHz, see adc_timer.h
+#define SAMPLE_BUFFER_LENGTH MN //One DMA block is one FFT frame, fft_cfg.N of it is used
 #define SERIAL_BAUD 115200 // Must be same as Serial Monitor baud
+#define TIMING_EVERY 4		//Keeps the stream at ~60% of the link at 48kHz/256
+#define SPECTRUM_EVERY 8
+#define SPECTRUM_LEVELS 32
+#define LAZY_REFRESH_MS 50	//Longest a held note goes without a full analysis
+#define CALIB_FILE "/local/CALIB.LUT"
+#define CALIB_FIRST_NOTE PITCH_Q8(110)	//A2, the note of the first reference point
+#define CALIB_STEP 2	//Semitones between reference points
+#define MIDI_CHANNEL 0	//1 to the receiver
+#define MIDI_BEND_RANGE 2	//Semitones, must match the receiver
+#define MIDI_CONTROLLER 7	//Channel volume, 11 for expression
+#define MIDI_INTERVAL_MS 2	//Least time between two bends, or two controller values
 
 MODDMA dma;	//GPDMA Controller Object
 
-//Configuration Settings for Single Channel ADC
-MODDMA_Config conf = new MODDMA_Config; 
+//Configuration Settings for Single Channel ADC, one per buffer
+MODDMA_Config conf[2];
 
 Serial pc(USBTX,USBRX);
+Serial midi_port(p9, p10);	//UART3, MIDI out
 
-/*
-//Might use this bit later for file output if i need it
-LocalFileSystem local("local");	//Setting filesystem so i can write output to the Mbed
-FILE *fp; //File Pointer
-*/
+Ticker report_ticker;	//Posts EVT_REPORT once a second
 
-bool dmaTransferComplete = false;
+LocalFileSystem local("local");	//Setting filesystem so i can write output to the Mbed
 
 //ADC Activation, Configuration and Pin Selection Routine
 void configure_ADC(void);
-//GPDMA Timer Callback Interrupt Request Routine
+//GPDMA Timer Callback Interrupt Request Routines, one per buffer
 void TC0_callback(void);
+void TC1_callback(void);
+void adc_block_landed(int b);
 //GPDMA Error Callback Interrupt Request Routine
 void ERR0_callback(void);
+//Event Handler for a finished ADC block
+void adc_block_handler(void);
+//Event Handler for the once a second load report
+void report_handler(void);
+void report_tick(void);
+//UART TX interrupt, feeds telemetry into the FIFO
+void tx_isr(void);
+void telemetry_kick(void);
+//UART3 TX interrupt, one MIDI byte at a time
+void midi_tx_isr(void);
+//UART RX interrupt, frame size commands
+void rx_isr(void);
+//Switches FFT size, window and DMA block length
+void set_frame_size(int N);
+//Sends the profile counters as telemetry and clears them
+void send_profile(void);
+uint32_t block_cycles(int N);
+//Event Handler for the calibration commands
+void calib_handler(void);
+
+//Raw ADC result words from the DMA, not zeroed at reset
+uint32_t adcInputBuffer[2][SAMPLE_BUFFER_LENGTH] SRAM_IN(AHB0);
+SRAM_LIST(AHB0, adcInputBuffer);
+volatile int ReadyBuffer = 0;	//Buffer the DMA just finished
+volatile bool block_ready = false;	//ReadyBuffer has not been taken by the handler yet
+volatile int block_N[2];	//Conversions each buffer is armed for
 
+//Analysis state, MN_FAST and MN_FINE frames share the buffers
+static_assert(fft_sized_ok(MN_FAST) && fft_sized_ok(MN_FINE), "MN_FAST and MN_FINE must be fftR4 sizes");
+int16_t samples[MN];	//Zero mean and levelled by the front end
+Frontend frontend;
+ChangeDetect change;
+short window[MN];
+ComplexQ15Buffer<MN> fft_x SRAM_IN(LOCAL);	//2*MN shorts, 4 byte aligned, as fftR4 wants
+ComplexQ15Buffer<MN> fft_y SRAM_IN(LOCAL);
+SRAM_LIST(LOCAL, samples);
+SRAM_LIST(LOCAL, window);
+SRAM_LIST(LOCAL, fft_x);
+SRAM_LIST(LOCAL, fft_y);
+PitchFft fft_cfg;
+FftPlan fft_plan;
+volatile int requested_N = MN_FAST;	//Applied between blocks
+PitchTracker tracker;
+PitchResult last_result;
+uint32_t block_count = 0;
+volatile uint32_t block_landed;	//cycle_count() in the TC callback
+volatile bool profile_requested = false;
 
-//FFT Radix 4 Function Declaration
-extern "C" void fftR4(short *y,short *x, int N);
+//Antenna pitch to played pitch
+CalibLut calib;
+CalibPoint calib_points[CALIB_MAX_POINTS];
+int calib_count = -1;	//Points recorded, -1 when not calibrating
+volatile char calib_command = 0;	//'c', 'n' or 's' from the serial port
+
+MidiOut midi;
+volatile bool midi_enabled = false;	//'m' from the serial port
 
 int main() {
 	pc.baud(SERIAL_BAUD); //Setting Serial Up	
+	cycle_counter_init();
+	tlm_init();
+	pc.attach(&tx_isr, Serial::TxIrq);
+	pc.attach(&rx_isr, Serial::RxIrq);
+	midi_init(&midi, MIDI_CHANNEL, MIDI_BEND_RANGE, MIDI_CONTROLLER, CCLK_HZ / 1000 * MIDI_INTERVAL_MS);
+	midi_port.baud(MIDI_BAUD);
+	midi_port.attach(&midi_tx_isr, Serial::TxIrq);
 
-	uint16_t adcInputBuffer[SAMPLE_BUFFER_LENGTH);
-	memset(adcInputBuffer, 0 sizeof(adcInputBuffer));
-	
-	configure_ADC();
-	
-	// !!! This Activates the A/D Conversions !!!
-	LPC->ADCR |= (1UL << 16);
-	
+	sched_init();
+	sched_attach(EVT_ADC_BLOCK, &adc_block_handler);
+	sched_attach(EVT_REPORT, &report_handler);
+	sched_attach(EVT_CONTROL, &calib_handler);
+
+	if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
+	memset(adcInputBuffer, 0, sizeof(adcInputBuffer));
 	
-	if (dmaTransferComplete) { //This Triggers when
-		//Do Interesting Stuff Here
-		dmaTransferComplete = false;
-	}
+	//DC corner 7.5Hz at 48kHz, AGC gain up to 32x
+	frontend_init(&frontend, 10, FRONTEND_MAX_GAIN);
+	//1/4 level, 1/128 crossing spacing (~14 cents), level moves under the AGC gate ignored
+	//A frame is one block so settle 1, set_frame_size() sets the refresh
+	change_detect_init(&change, 8192, 256, frontend.gate, 1, 1);
 	
+	//Building the arena for the biggest size now keeps a later switch to it quick
+	if (!fft_plan_init(&fft_plan, MN_FINE)) error("FFT_PLAN_MAX_N is below MN_FINE");
 	
+	configure_ADC();
+
+	//Same analysis path the batch_analyzer runs on the PC
+	fft_cfg.sample_rate = adc_rate();	//What the ADC really runs at, not SAMPLE_RATE
+	fft_cfg.fmin_q8 = PITCH_Q8(25);
+	fft_cfg.fmax_q8 = PITCH_Q8(4200);
+	fft_cfg.window = window;
+	fft_cfg.x = fft_x.data();
+	fft_cfg.y = fft_y.data();
+	set_frame_size(requested_N);	//After sample_rate, the lazy refresh is worked out from it
+	pitch_tracker_init(&tracker, 6554, 8192, 4);	//0.2 confidence, 1/4 smoothing
+	if (!calib_load(CALIB_FILE, &calib)) calib_identity(&calib, fft_cfg.fmin_q8, fft_cfg.fmax_q8);
 	
-	/*
-		Psuedocode:
-		Sample then wait for TC Callback
-		Cut 2 Bits from All Samples
-		Run FFT with samples
-		Find highest value in output array
-		Convert that to a frequency
-		Print
-	 */
+	// !!! This Activates the A/D Conversions !!!
+	adc_timer_start();
+	health_adc_armed(cycle_count(), block_cycles(fft_cfg.N));
 	
 	
+	report_ticker.attach(&report_tick, 1.0);
 	
+	//Everything from here on is driven by events, the core sleeps in between
+	sched_run();
+}
+
+/*
+	Psuedocode:
+	Sample then wait for TC Callback
+	Unpack and check the words, remove DC and level
+	Skip to the tracker if the block matches the last analysed one
+	Run FFT with samples
+	Find highest value in output array
+	Convert that to a frequency
+	Print
+ */
+void adc_block_handler(void) {
+	uint32_t stage[TLM_TIMING_STAGES];
+	uint32_t start = cycle_count();
+	PROFILE_ADD(PROF_CAPTURE_WAIT, start - block_landed);
+
+	//The other buffer is filling, this one must be unpacked before it lands
+	__disable_irq();
+	int b = ReadyBuffer;
+	block_ready = false;
+	__enable_irq();
+	int N = fft_cfg.N;
+	int next_N = requested_N;	//Read once, rx_isr can change it under us
+	frontend_process(&frontend, adcInputBuffer[b], samples, N, 0, &health.adc);	//Checked, unpacked and levelled in one pass
+	PROFILE_ADD(PROF_UNPACK, cycle_count() - start);
 	
+	//A new frame size goes to this buffer, armed again when the other one lands.
+	//If that has already happened (this handler ran a block late) it waits for the next
+	if (next_N != block_N[b]) {
+		__disable_irq();
+		if (ReadyBuffer == b) {
+			conf[b].transferSize(next_N);
+			block_N[b] = next_N;
+		}
+		__enable_irq();
+	}
+	uint32_t t1 = cycle_count();
 	
+	bool analysed = change_detect_block(&change, frontend.level, frontend.spacing_q8);
+	if (analysed) {
+		PROFILE_START(t_window);
+		pitch_window_q15(&fft_cfg, samples);
+		PROFILE_STOP(PROF_WINDOW, t_window);
+		PROFILE_START(t_fft);
+		pitch_transform(&fft_cfg);
+		PROFILE_STOP(PROF_FFT, t_fft);
+	}
+	PROFILE_START(t_pitch);
+	if (analysed) {
+		pitch_peak(&fft_cfg, &last_result);
+		pitch_octave_correct(&fft_cfg, &last_result);
+	}
+	uint32_t t2 = cycle_count();
+	pitch_tracker_update(&tracker, &last_result);
+	uint32_t t3 = cycle_count();
+	PROFILE_STOP(PROF_PITCH, t_pitch);
+
+	stage[0] = t1 - start;
+	stage[1] = t2 - t1;
+	stage[2] = t3 - t2;
+	stage[3] = t3 - start;
+
+	PROFILE_START(t_publish);
+	uint32_t played = tracker.freq_q8 ? calib_map(&calib, tracker.freq_q8) : 0;
+	tlm_send_pitch(last_result.freq_q8, tracker.freq_q8, last_result.confidence, frontend.level, played);
+	//One more update after 'm' turns it off, to let the note go
+	if (midi_enabled || midi.want_note >= 0) {
+		int value = midi_level_value(frontend.level, frontend.gate);
+		__disable_irq();
+		midi_update(&midi, midi_enabled ? played : 0, value, cycle_count());
+		midi_tx_isr();
+		__enable_irq();
+	}
+	if (block_count % TIMING_EVERY == 0) tlm_send_timing(stage, TLM_TIMING_STAGES);
+	if (analysed && block_count % SPECTRUM_EVERY == 0) tlm_send_spectrum(fft_y.data(), N, fft_cfg.sample_rate, SPECTRUM_LEVELS);
+	block_count++;
+	telemetry_kick();
+	PROFILE_STOP(PROF_PUBLISH, t_publish);
 	
+	//This block was analysed and sent at N, switch once the one filling now is another length
+	if (block_N[b ^ 1] != N) set_frame_size(block_N[b ^ 1]);
+}
 
+/*
+	Idle percentage over the last second
+	Compare this across MN and SAMPLE_RATE settings to see the real load
+ */
+void report_handler(void) {
+	tlm_send_status(sched_idle_permille(true), change_skip_permille(&change, true));
+	tlm_send_health(&health);
+	health_reset_peaks();
+	if (midi_enabled) {
+		MidiStats ms;
+		midi_stats(&midi, &ms, true);
+		tlm_send_midi(&ms);
+	}
+	if (profile_requested) {
+		profile_requested = false;
+		send_profile();
+	}
+	telemetry_kick();
+}
+
+void send_profile(void) {
+	for (int s = 0; s < PROF_SCOPES; s++) {
+		ProfileCounter c;
+		if (!profile_get(s, &c) || c.runs == 0) continue;
+		tlm_send_profile(s, c.runs, c.min, (uint32_t)(c.total / c.runs), c.max, c.hist, PROFILE_BINS);
+	}
+	profile_reset();
+}
+
+/*
+	THRE means the whole 16 byte FIFO is empty, so up to 16 bytes go in without
+	checking again. The interrupt comes back when they have all gone out.
+ */
+void tx_isr(void) {
+	uint8_t burst[16];
+	if (!(LPC_UART0->LSR & (1UL << 5))) return;
+	int n = tlm_read(burst, sizeof(burst));
+	for (int i = 0; i < n; i++) LPC_UART0->THR = burst[i];
+}
+
+/*
+	Only one byte goes in when THRE says the FIFO is empty, so nothing waits
+	there to go stale: the next byte is chosen when this one has moved out
+ */
+void midi_tx_isr(void) {
+	if (!(LPC_UART3->LSR & (1UL << 5))) return;
+	int b = midi_next_byte(&midi, cycle_count());
+	if (b >= 0) LPC_UART3->THR = (uint8_t)b;
+}
+
+void rx_isr(void) {
+	while (pc.readable()) {
+		int c = pc.getc();
+		if (c == 'f') requested_N = MN_FAST;
+		if (c == 'r') requested_N = MN_FINE;
+		if (c == 'p') profile_requested = true;
+		if (c == 'm') midi_enabled = !midi_enabled;
+		if (c == 'c' || c == 'n' || c == 's') {
+			calib_command = (char)c;
+			sched_post(EVT_CONTROL);
+		}
+	}
+}
+
+/*
+	Calibration runs from main context, between blocks, since 's' writes a file
+	The LocalFileSystem blocks for tens of ms, the DMA keeps ping-ponging
+	meanwhile and the blocks that land are overwritten before they are analysed
+ */
+void calib_handler(void) {
+	char c = calib_command;
+	calib_command = 0;
+	if (c == 'c') {
+		calib_count = 0;
+		tlm_send_calib(TLM_CALIB_START, 0, 0, CALIB_FIRST_NOTE);
+	} else if (c == 'n' && calib_count >= 0) {
+		uint32_t note = calib_note_q8(CALIB_FIRST_NOTE, calib_count * CALIB_STEP);
+		if (tracker.freq_q8 == 0 || calib_count == CALIB_MAX_POINTS) {
+			tlm_send_calib(TLM_CALIB_REJECT, calib_count, tracker.freq_q8, note);
+		} else {
+			calib_points[calib_count].in_q8 = tracker.freq_q8;
+			calib_points[calib_count].out_q8 = note;
+			calib_count++;
+			tlm_send_calib(TLM_CALIB_POINT, calib_count, tracker.freq_q8, note);
+		}
+	} else if (c == 's' && calib_count >= 0) {
+		//Built aside, a failed run leaves the table in use alone
+		static CalibLut built;
+		int n = calib_count;
+		calib_count = -1;
+		if (calib_build(calib_points, n, &built) && calib_save(CALIB_FILE, &built, n)) {
+			calib = built;
+			tlm_send_calib(TLM_CALIB_SAVED, n, built.in_min_q8, built.out_q8[0]);
+		} else {
+			tlm_send_calib(TLM_CALIB_FAILED, n, 0, 0);
+		}
+	}
+	telemetry_kick();
+}
+
+/*
+	The plan reuses the arena built in main, only the window is recomputed
+	Only the analysis side: the DMA block lengths are block_N, given to a
+	buffer before it is armed, and fft_cfg.sample_rate must already be set
+ */
+void set_frame_size(int N) {
+	fft_plan_init(&fft_plan, N);
+	pitch_window_init(window, N, WINDOW_HANN);
+	//Old fingerprints were taken over a different length
+	change.refresh = (int)((uint64_t)LAZY_REFRESH_MS * fft_cfg.sample_rate / (1000 * N));
+	change_detect_reset(&change);
+	fft_cfg.N = N;
+	fft_cfg.coef = fft_plan.coef;
+}
+
+//One DMA block of N conversions in CPU cycles
+uint32_t block_cycles(int N) {
+	return (uint32_t)((uint64_t)CCLK_HZ * N / fft_cfg.sample_rate);
+}
+
+//Starts the TX interrupt chain if the UART had gone quiet
+void telemetry_kick(void) {
+	__disable_irq();
+	tx_isr();
+	__enable_irq();
+}
+
+void report_tick(void) {
+	sched_post(EVT_REPORT);
 }
 
 
@@ -102,7 +453,7 @@ void configure_ADC(void) {
 		AD0[6] --> N/A --> P0[26] !!!NOT BROKEN ON MBED!!!
 		AD0[7] --> N/A --> P0[26] !!!NOT BROKEN ON MBED!!!
 	 */
-	LPC_ADC->ADCR = (1UL << 21) | (1UL << 8) | (1UL << 0);
+	if (!adc_timer_init(SAMPLE_RATE, 0)) error("SAMPLE_RATE is too fast for the ADC");
 	
 	/*
 		Selecting a Pin
@@ -113,49 +464,65 @@ void configure_ADC(void) {
 	LPC_PINCON->PINSEL1 &= ~(3UL << 14);	//Clears Bits 
 	LPC_PINCON->PINSEL1 |= (1UL << 14);		//Sets Bits
 	
-	//ADC Configuration for DMA Controller
-    
-    conf.channelNum    ( MODDMA::Channel_0 )
-    conf.srcMemAddr    ( 0 )
-    conf.dstMemAddr    ( (uint16_t)adcInputBuffer )
-    conf.transferSize  ( SAMPLE_BUFFER_LENGTH )
-    conf.transferType  ( MODDMA::p2m )
-    conf.transferWidth ( MODDMA::word )
-    conf.srcConn       ( MODDMA::ADC )
-	conf.dstConn       ( 0 )
-    conf.dmaLLI        ( 0 )
-    conf.attach_tc     ( &TC0_callback )
-    conf.attach_err    ( &ERR0_callback )
-	
-	// !!! Must pass pointer to the following 2 functions !!!
-	dma.Setup(&conf);
-	dma.Enable(&conf);
-	
+	//ADC Configuration for DMA Controller, buffer 0 on channel 0 and buffer 1 on channel 1
+	for (int b = 0; b < 2; b++) {
+	    block_N[b] = requested_N;
+	    conf[b].channelNum    ( b ? MODDMA::Channel_1 : MODDMA::Channel_0 );
+	    conf[b].srcMemAddr    ( 0 );
+	    conf[b].dstMemAddr    ( (uint32_t)adcInputBuffer[b] );
+	    conf[b].transferSize  ( block_N[b] );
+	    conf[b].transferType  ( MODDMA::p2m );
+	    conf[b].transferWidth ( MODDMA::word );
+	    conf[b].srcConn       ( MODDMA::ADC );
+	    conf[b].dstConn       ( 0 );
+	    conf[b].dmaLLI        ( 0 );
+	    conf[b].attach_tc     ( b ? &TC1_callback : &TC0_callback );
+	    conf[b].attach_err    ( &ERR0_callback );
+	}
 	
+	// !!! Must pass a pointer, buffer 1 is armed when buffer 0 lands !!!
+	if (!dma.Prepare(&conf[0])) error("Conf0 could not be prepared, check configuration settings");
+	//ADC irq flag to the DMA, it stays on from here
+	LPC_ADC->ADINTEN = 0x100;
+}
+
+void TC0_callback(void) {
+    adc_block_landed(0);
+}
+
+void TC1_callback(void) {
+    adc_block_landed(1);
 }
 
 /*
-	TC0 Callback is made when the DMA transfer is done. 
+	TC Callback is made when the DMA transfer into buffer b is done. 
 	Certain Events have to be done before any other control flow is possible
-	Disable Burst mode and Turn off IRQ Flag
 	Shut Down the DMA Channel
+	Arm the other buffer straight away, within a conversion period
 	Set Internal Flags
 	Clear DMA IRQ Flags
 */
-void TC0_callback(void) {
+void adc_block_landed(int b) {
     
     MODDMA_Config *config = dma.getConfig();
-    
-    // Disable burst mode and switch off the IRQ flag.
-    LPC_ADC->ADCR &= ~(1UL << 16);
-    LPC_ADC->ADINTEN = 0;    
+    block_landed = cycle_count();
+    health_adc_landed(block_landed);
     
     // Finish the DMA cycle by shutting down the channel.
-    dma.haltAndWaitChannelComplete( (MODDMA::CHANNELS)config->channelNum());
     dma.Disable( (MODDMA::CHANNELS)config->channelNum() );
     
-    // Tell main() while(1) loop to print the results.
-    dmaTransferComplete = true;            
+    // Swap to the other buffer, the ADC keeps going into it.
+    dma.Prepare(&conf[b ^ 1]);
+    uint32_t now = cycle_count();
+    health_adc_rearmed(now);
+    health_adc_armed(now, block_cycles(block_N[b ^ 1]));
+    
+    // Tell the scheduler buffer b is ready. Posts merge, so a block
+    // the handler never took is lost here: count it.
+    if (block_ready) health.adc_dropped++;
+    ReadyBuffer = b;
+    block_ready = true;
+    sched_post(EVT_ADC_BLOCK);
     
     // Clear DMA IRQ flags.
     if (dma.irqType() == MODDMA::TcIrq) dma.clearTcIrq();    
@@ -164,8 +531,8 @@ void TC0_callback(void) {
 
 // Configuration callback on Error
 void ERR0_callback(void) {
-    // Switch off burst conversions.
-    LPC_ADC->ADCR |= ~(1UL << 16);
+    // Switch off conversions.
+    adc_timer_stop();
     LPC_ADC->ADINTEN = 0;
     error("Epic Failure; there was a DMA ERR!");
 }
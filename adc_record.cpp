@@ -0,0 +1,203 @@
+/*
+ * ADC Recorder
+ * Objective: Stream raw ADC samples to the LocalFileSystem as a binary capture
+ *
+ * Replaces fprintf'ing every sample as text (refined1.cpp, MUHAHAHAHA.cpp).
+ * The ADC samples AD0.0 (p15), triggered by Timer 1 at RECORD_RATE or in burst
+ * mode, and the GPDMA ping-pongs between two
+ * buffers, the same way dac_dma.cpp does for the DAC, so no conversions are lost
+ * while a block is being packed. The two buffers sit in the AHB0 SRAM bank
+ * (sram.h), off the bus the packing and the file system use.
+ * Full blocks are written to /local/CAP001.THC in 2KB fwrites from idle time.
+ * Replay the file on the PC with capture_replay.
+ *
+ * The DMA Channels:
+ *     Channel 0 : ADC Buffer 0
+ *     Channel 1 : ADC Buffer 1
+ */
+
+#include "mbed.h"
+#include "MODDMA.h"
+#include "adc_defs.h"
+#include "adc_timer.h"
+#include "capture.h"
+#include "scheduler.h"
+#include "sram.h"
+
+#define SAMPLE_BUFFER_LENGTH 512
+#define RECORD_SECONDS 10
+#define RECORD_FILE "/local/CAP001.THC"
+
+/*
+ * RECORD_RATE conversions a second from Timer 1, exact since it divides 12MHz
+ * Set it to 0 for the old burst mode at RECORD_CLKDIV:
+ * CLKDIV 7 -> 24MHz/8 = 3MHz ADC clock -> 3MHz/65 = 46.1kHz
+ * Every sample is 2 bytes in the file, so that is ~96KB/s the file system has to keep up with
+ * Either way the header gets the rate from adc_rate()
+ */
+#define RECORD_RATE 48000
+#define RECORD_CLKDIV 7
+
+DigitalOut led1(LED1);  //Recording
+DigitalOut led2(LED2);  //Finished
+DigitalOut led4(LED4);  //Samples were dropped
+
+Serial pc(USBTX, USBRX);
+LocalFileSystem local("local");
+
+MODDMA dma;
+MODDMA_Config *conf0, *conf1;
+
+Timeout stop_timer;
+
+uint32_t adcInputBuffer[2][SAMPLE_BUFFER_LENGTH] SRAM_IN(AHB0);
+SRAM_LIST(AHB0, adcInputBuffer);
+volatile int ReadyBuffer = 0;   //Buffer the DMA just finished
+
+void TC0_callback(void);
+void TC1_callback(void);
+void ERR_callback(void);
+
+void adc_block_handler(void);
+void stop_handler(void);
+void stop_tick(void);
+void adc_stop(void);
+
+int main() {
+    pc.baud(115200);
+    sram_report(stdout);
+    if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
+
+    sched_init();
+    sched_attach(EVT_ADC_BLOCK, &adc_block_handler);
+    sched_attach(EVT_CAPTURE_WRITE, &capture_write_handler);
+    sched_attach(EVT_CONTROL, &stop_handler);
+
+#if RECORD_RATE
+    if (!adc_timer_init(RECORD_RATE, 0)) error("RECORD_RATE is too fast for the ADC");
+#else
+    // We use the ADC irq to trigger DMA and the manual says
+    // that in this case the NVIC for ADC must be disabled.
+    NVIC_DisableIRQ(ADC_IRQn);
+
+    // Power up the ADC and set PCLK
+    LPC_SC->PCONP    |=  (1UL << 12);
+    LPC_SC->PCLKSEL0 &= ~(3UL << 24); // PCLK = CCLK/4 96M/4 = 24MHz
+
+    LPC_ADC->ADCR = ADCR_PDN | ADCR_CLKDIV(RECORD_CLKDIV) | ADCR_SEL(1 << 0);
+#endif
+
+    LPC_PINCON->PINSEL1 &= ~(3UL << 14);  /* P0.23, Mbed p15. */
+    LPC_PINCON->PINSEL1 |=  (1UL << 14);
+
+    if (!capture_start(RECORD_FILE, adc_rate(), 1, LPC_ADC->ADCR)) {
+        error("Could not create " RECORD_FILE);
+    }
+
+    // Prepare the GPDMA system for buffer0.
+    conf0 = new MODDMA_Config;
+    conf0
+     ->channelNum    ( MODDMA::Channel_0 )
+     ->srcMemAddr    ( 0 )
+     ->dstMemAddr    ( (uint32_t) adcInputBuffer[0] )
+     ->transferSize  ( SAMPLE_BUFFER_LENGTH )
+     ->transferType  ( MODDMA::p2m )
+     ->transferWidth ( MODDMA::word )
+     ->srcConn       ( MODDMA::ADC )
+     ->attach_tc     ( &TC0_callback )
+     ->attach_err    ( &ERR_callback )
+    ; // config end
+
+    // Prepare the GPDMA system for buffer1.
+    conf1 = new MODDMA_Config;
+    conf1
+     ->channelNum    ( MODDMA::Channel_1 )
+     ->srcMemAddr    ( 0 )
+     ->dstMemAddr    ( (uint32_t) adcInputBuffer[1] )
+     ->transferSize  ( SAMPLE_BUFFER_LENGTH )
+     ->transferType  ( MODDMA::p2m )
+     ->transferWidth ( MODDMA::word )
+     ->srcConn       ( MODDMA::ADC )
+     ->attach_tc     ( &TC1_callback )
+     ->attach_err    ( &ERR_callback )
+    ; // config end
+
+    if (!dma.Prepare(conf0)) {
+        error("Conf0 could not be prepared, check configuration settings");
+    }
+
+    // Enable ADC irq flag (to DMA) and start conversions.
+    LPC_ADC->ADINTEN = 0x100;
+#if RECORD_RATE
+    adc_timer_start();
+#else
+    LPC_ADC->ADCR |= ADCR_BURST;
+#endif
+
+    led1 = 1;
+    stop_timer.attach(&stop_tick, RECORD_SECONDS);
+
+    sched_run();
+}
+
+void adc_block_handler(void) {
+    capture_push(adcInputBuffer[ReadyBuffer], SAMPLE_BUFFER_LENGTH);
+    if (capture_samples_dropped()) led4 = 1;
+}
+
+void stop_handler(void) {
+    adc_stop();
+    dma.Disable(MODDMA::Channel_0);
+    dma.Disable(MODDMA::Channel_1);
+
+    capture_stop();
+    led1 = 0;
+    led2 = 1;
+    pc.printf("Recorded %u samples, dropped %u\n", capture_samples_written(), capture_samples_dropped());
+}
+
+void stop_tick(void) {
+    sched_post(EVT_CONTROL);
+}
+
+void TC0_callback(void) {
+    //Get Configuration Pointer and Shut Down DMA Channel
+    MODDMA_Config *config = dma.getConfig();
+    dma.Disable( (MODDMA::CHANNELS)config->channelNum());
+
+    //Swaps to Buffer 1, then hands Buffer 0 to the recorder
+    dma.Prepare(conf1);
+    ReadyBuffer = 0;
+    sched_post(EVT_ADC_BLOCK);
+
+    //Resets IRQ Flags
+    if (dma.irqType() == MODDMA::TcIrq) dma.clearTcIrq();
+}
+
+void TC1_callback(void) {
+    //Get Configuration Pointer and Shut Down DMA Channel
+    MODDMA_Config *config = dma.getConfig();
+    dma.Disable( (MODDMA::CHANNELS)config->channelNum());
+
+    //Swaps to Buffer 0, then hands Buffer 1 to the recorder
+    dma.Prepare(conf0);
+    ReadyBuffer = 1;
+    sched_post(EVT_ADC_BLOCK);
+
+    //Resets IRQ Flags
+    if (dma.irqType() == MODDMA::TcIrq) dma.clearTcIrq();
+}
+
+void ERR_callback(void) {
+    adc_stop();
+    error("ADC DMA Failed");
+}
+
+void adc_stop(void) {
+#if RECORD_RATE
+    adc_timer_stop();
+#else
+    LPC_ADC->ADCR &= ~ADCR_BURST;
+#endif
+    LPC_ADC->ADINTEN = 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Timer Triggered ADC
+ * See adc_timer.h
+ */
+
+#include "mbed.h"
+#include "adc_defs.h"
+#include "adc_timer.h"
+
+//CLKDIV 1 -> 24MHz/2 = 12MHz ADC clock, just under the 13MHz limit
+#define ADC_TIMER_CLKDIV 1
+
+uint32_t adc_timer_init(uint32_t rate, int channel) {
+    //65 ADC clocks per conversion have to fit between two triggers
+    if (rate == 0 || rate > ADC_PCLK_HZ / (ADC_TIMER_CLKDIV + 1) / ADC_CLKS_PER_SAMPLE) return 0;
+
+    // We use the ADC irq to trigger DMA and the manual says
+    // that in this case the NVIC for ADC must be disabled.
+    NVIC_DisableIRQ(ADC_IRQn);
+
+    // Power up the ADC and Timer 1, both on PCLK = CCLK/4 96M/4 = 24MHz
+    LPC_SC->PCONP    |=  (1UL << 12) | (1UL << 2);
+    LPC_SC->PCLKSEL0 &= ~((3UL << 24) | (3UL << 4));
+
+    // Timer 1 held in reset while it is set up
+    LPC_TIM1->TCR  = 2;
+    LPC_TIM1->CTCR = 0;                 // Timer mode, counts PCLK
+    LPC_TIM1->PR   = 0;
+    LPC_TIM1->MR0  = adc_timer_match(rate);
+    LPC_TIM1->MCR  = (1UL << 1);        // Reset on MR0, no interrupt
+    LPC_TIM1->EMR  = (3UL << 4);        // EMC0 = 11, toggle MAT1.0 on match
+
+    // Burst off, conversions start on the rising edge of MAT1.0
+    LPC_ADC->ADCR = ADCR_PDN | ADCR_CLKDIV(ADC_TIMER_CLKDIV) | ADCR_SEL(1UL << channel)
+                  | ADCR_START(ADC_START_MAT10);
+
+    return adc_rate();
+}
+
+void adc_timer_start(void) {
+    LPC_TIM1->TCR = 1;
+}
+
+void adc_timer_stop(void) {
+    LPC_TIM1->TCR = 0;
+}
+
+uint32_t adc_rate(void) {
+    return adc_sample_rate(LPC_ADC->ADCR, LPC_TIM1->MR0);
+}
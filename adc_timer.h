@@ -0,0 +1,33 @@
+/*
+ * Timer Triggered ADC
+ * Objective: Sample at a rate we choose instead of whatever the clock tree gives burst mode
+ *
+ * Timer 1 counts PCLK and toggles MAT1.0 on every MR0 match. The ADC START field is
+ * set to start one conversion on each rising edge of MAT1.0, and the DMA keeps
+ * collecting results through the ADC request exactly as it does in burst mode.
+ * MAT1.0 does not have to be pinned out for the ADC to see it.
+ *
+ * Only one channel can be converted this way, START ignores all but the lowest SEL bit.
+ */
+
+#ifndef ADC_TIMER_H
+#define ADC_TIMER_H
+
+#include <stdint.h>
+
+/*
+ * Powers up the ADC and Timer 1 and sets them up for rate conversions a second on channel
+ * Nothing is converted until adc_timer_start()
+ * Returns the true rate, the same thing adc_rate() reports,
+ * or 0 if the rate is beyond what a 12MHz ADC clock can convert
+ */
+uint32_t adc_timer_init(uint32_t rate, int channel);
+
+//Starts and stops Timer 1, and with it the conversions
+void adc_timer_start(void);
+void adc_timer_stop(void);
+
+//Rate the ADC is really running at, timer triggered or burst, from the live registers
+uint32_t adc_rate(void);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * ADC Unpack
+ * See adc_unpack.h
+ *
+ * The complex layout is written a word at a time: on a little endian core the low
+ * half of (w & 0xFFF0) ^ 0x8000 is the Q15 sample and the high half, the imaginary
+ * part, is already 0. Flipping bit 15 is the same as subtracting 0x8000 in 16 bits.
+ */
+
+#include "adc_unpack.h"
+
+#if defined(__SSE2__) && !defined(TARGET_LPC1768)
+#include <emmintrin.h>
+#define ADC_UNPACK_SSE2
+#endif
+
+int adc_unpack_complex(const uint32_t *words, short *x, int count, int channel, AdcUnpackStats *stats) {
+    uint32_t mask = adc_check_mask(channel), expect = adc_check_expect(channel);
+    uint32_t *out = (uint32_t *)x;
+    int16_t last = 0;
+    int bad = 0;
+    int i = 0;
+
+#ifdef ADC_UNPACK_SSE2
+    const __m128i vmask = _mm_set1_epi32((int)mask), vexpect = _mm_set1_epi32((int)expect);
+    const __m128i vcode = _mm_set1_epi32(0xFFF0), vflip = _mm_set1_epi32(0x8000);
+    for (; i + 4 <= count; i += 4) {
+        __m128i w = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i ok = _mm_cmpeq_epi32(_mm_and_si128(w, vmask), vexpect);
+        if (_mm_movemask_epi8(ok) == 0xFFFF) {
+            last = adc_q15(words[i + 3]);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(_mm_and_si128(w, vcode), vflip));
+        } else {
+            for (int k = i; k < i + 4; k++) {
+                out[k] = (uint16_t)adc_check_word(words[k], mask, expect, &last, &bad, stats);
+            }
+        }
+    }
+#else
+    for (; i + 4 <= count; i += 4) {
+        uint32_t w0 = words[i], w1 = words[i + 1], w2 = words[i + 2], w3 = words[i + 3];
+        if ((((w0 ^ expect) | (w1 ^ expect) | (w2 ^ expect) | (w3 ^ expect)) & mask) == 0) {
+            out[i]     = (w0 & 0xFFF0) ^ 0x8000;
+            out[i + 1] = (w1 & 0xFFF0) ^ 0x8000;
+            out[i + 2] = (w2 & 0xFFF0) ^ 0x8000;
+            out[i + 3] = (w3 & 0xFFF0) ^ 0x8000;
+            last = adc_q15(w3);
+        } else {
+            out[i]     = (uint16_t)adc_check_word(w0, mask, expect, &last, &bad, stats);
+            out[i + 1] = (uint16_t)adc_check_word(w1, mask, expect, &last, &bad, stats);
+            out[i + 2] = (uint16_t)adc_check_word(w2, mask, expect, &last, &bad, stats);
+            out[i + 3] = (uint16_t)adc_check_word(w3, mask, expect, &last, &bad, stats);
+        }
+    }
+#endif
+    for (; i < count; i++) out[i] = (uint16_t)adc_check_word(words[i], mask, expect, &last, &bad, stats);
+
+    if (stats) stats->words += count;
+    return bad;
+}
+
+int adc_unpack_real(const uint32_t *words, int16_t *out, int count, int channel, AdcUnpackStats *stats) {
+    uint32_t mask = adc_check_mask(channel), expect = adc_check_expect(channel);
+    int16_t last = 0;
+    int bad = 0;
+    int i = 0;
+
+#ifdef ADC_UNPACK_SSE2
+    //Both loads happen before the store, which only covers words already read
+    const __m128i vmask = _mm_set1_epi32((int)mask), vexpect = _mm_set1_epi32((int)expect);
+    const __m128i vcode = _mm_set1_epi32(0xFFF0), vmid = _mm_set1_epi32(0x8000);
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(words + i + 4));
+        __m128i ok = _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(a, vmask), vexpect),
+                                   _mm_cmpeq_epi32(_mm_and_si128(b, vmask), vexpect));
+        if (_mm_movemask_epi8(ok) == 0xFFFF) {
+            last = adc_q15(words[i + 7]);
+            a = _mm_sub_epi32(_mm_and_si128(a, vcode), vmid);
+            b = _mm_sub_epi32(_mm_and_si128(b, vcode), vmid);
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+        } else {
+            int16_t v[8];
+            for (int k = 0; k < 8; k++) v[k] = adc_check_word(words[i + k], mask, expect, &last, &bad, stats);
+            for (int k = 0; k < 8; k++) out[i + k] = v[k];
+        }
+    }
+#else
+    for (; i + 4 <= count; i += 4) {
+        uint32_t w0 = words[i], w1 = words[i + 1], w2 = words[i + 2], w3 = words[i + 3];
+        if ((((w0 ^ expect) | (w1 ^ expect) | (w2 ^ expect) | (w3 ^ expect)) & mask) == 0) {
+            out[i]     = adc_q15(w0);
+            out[i + 1] = adc_q15(w1);
+            out[i + 2] = adc_q15(w2);
+            out[i + 3] = last = adc_q15(w3);
+        } else {
+            out[i]     = adc_check_word(w0, mask, expect, &last, &bad, stats);
+            out[i + 1] = adc_check_word(w1, mask, expect, &last, &bad, stats);
+            out[i + 2] = adc_check_word(w2, mask, expect, &last, &bad, stats);
+            out[i + 3] = adc_check_word(w3, mask, expect, &last, &bad, stats);
+        }
+    }
+#endif
+    for (; i < count; i++) out[i] = adc_check_word(words[i], mask, expect, &last, &bad, stats);
+
+    if (stats) stats->words += count;
+    return bad;
+}
@@ -0,0 +1,84 @@
+/*
+ * ADC Unpack
+ * Objective: Turn a DMA block of ADC result words into samples in one checked pass
+ *
+ * The conversion is ((code - 2048) << 4), which for a result word is just
+ * (w & 0xFFF0) - 0x8000: a mask and a subtract, no shifts.
+ *
+ * Two output layouts:
+ *   adc_unpack_complex()  x[] = x0r, x0i, x1r, x1i... with the imaginary parts 0,
+ *                         what fftR4 takes. One sample is 4 bytes, the same as a word.
+ *   adc_unpack_real()     packed int16_t Q15 samples, e.g. for frontend_process_q15()
+ * frontend_process() does the same check word by word inside its own loop, with
+ * adc_check_word(), so a block for the front end is only read once.
+ * Both may run in place over the words (out == (void *)words), the output never
+ * overtakes the input. For the complex layout out must be 4 byte aligned.
+ *
+ * Every word is checked along the way: DONE must be set, OVERRUN clear and the
+ * channel the expected one. A bad word is replaced by the last good sample (0 at
+ * the start of a block) so the FFT never sees a spike, and counted in stats.
+ *
+ * The M3 build is unrolled 4 words at a time and checks the 4 together, the host
+ * build uses SSE2 8 words at a time. Only a group holding a bad word goes word by word.
+ */
+
+#ifndef ADC_UNPACK_H
+#define ADC_UNPACK_H
+
+#include <stdint.h>
+
+#include "adc_defs.h"
+
+#define ADC_ANY_CHANNEL (-1)   //Skip the channel check
+
+//Running totals, never reset by the kernels
+struct AdcUnpackStats {
+    uint32_t words;
+    uint32_t not_done;      //DONE clear: the DMA never wrote the word
+    uint32_t overruns;      //A conversion was lost before this one was read
+    uint32_t wrong_channel;
+};
+
+//One result word to Q15 around mid scale
+static inline int16_t adc_q15(uint32_t w) {
+    return (int16_t)((int32_t)(w & 0xFFF0) - 0x8000);
+}
+
+//A word is good when (w & adc_check_mask(channel)) == adc_check_expect(channel)
+static inline uint32_t adc_check_mask(int channel) {
+    return (1UL << 31) | (1UL << 30) | (channel >= 0 ? (7UL << 24) : 0);
+}
+
+static inline uint32_t adc_check_expect(int channel) {
+    return (1UL << 31) | (channel >= 0 ? ((uint32_t)channel & 0x7) << 24 : 0);
+}
+
+/*
+ * One word checked: its sample, which becomes *last, or if it is bad *last again,
+ * with *bad and stats (may be 0) counting it
+ */
+static inline int16_t adc_check_word(uint32_t w, uint32_t mask, uint32_t expect, int16_t *last,
+                                     int *bad, AdcUnpackStats *stats) {
+    if ((w & mask) == expect) {
+        *last = adc_q15(w);
+        return *last;
+    }
+    (*bad)++;
+    if (stats) {
+        if (!ADC_DONE(w)) stats->not_done++;
+        else if (ADC_OVERRUN(w)) stats->overruns++;
+        else stats->wrong_channel++;
+    }
+    return *last;
+}
+
+/*
+ * count words to count complex samples in x (2 * count shorts)
+ * stats may be 0. Returns the number of bad words.
+ */
+int adc_unpack_complex(const uint32_t *words, short *x, int count, int channel, AdcUnpackStats *stats);
+
+//count words to count Q15 samples
+int adc_unpack_real(const uint32_t *words, int16_t *out, int count, int channel, AdcUnpackStats *stats);
+
+#endif
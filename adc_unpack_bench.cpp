@@ -0,0 +1,195 @@
+/*
+ * ADC Unpack Benchmark
+ * Objective: Check the unpack kernels against the plain per sample loop and time them
+ *
+ * Builds for the mbed and for the PC from the same source, like dds_bench.
+ * On the PC the cycles are the host clock scaled to 96MHz (and the SSE2 path),
+ * only the mbed figures say anything about the M3.
+ *
+ * Host build:
+ *   g++ -O2 -o adc_unpack_bench adc_unpack_bench.cpp adc_unpack.cpp frontend.cpp
+ *
+ * Every kernel is run on a clean block and on one with bad words dropped in
+ * (overrun, wrong channel, never written), in place and into a separate buffer,
+ * and compared with what the reference loop below says it should give.
+ *
+ * The front end is timed both ways too: frontend_process() checking the words in
+ * its own loop, against adc_unpack_real() then frontend_process_q15(), which reads
+ * the block a second time. The two must give the same samples and counts.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "adc_defs.h"
+#include "adc_unpack.h"
+#include "cycle_counter.h"
+#include "frontend.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+Serial pc(USBTX, USBRX);
+#define report pc.printf
+#else
+#define report printf
+#endif
+
+#define BENCH_BLOCK 1024    //One MN_FINE frame
+#define BENCH_RUNS 16
+
+static uint32_t words[BENCH_BLOCK];
+static uint32_t work[BENCH_BLOCK];                  //Copy of words the kernels may overwrite
+static int16_t expect[BENCH_BLOCK];
+static short out[2 * BENCH_BLOCK] __attribute__((aligned(4)));
+static int16_t fused[BENCH_BLOCK];
+
+//Triangle sweep over the whole code range, channel 0
+static void fill(void) {
+    for (int i = 0; i < BENCH_BLOCK; i++) {
+        int code = (i * 37) % 8192;
+        if (code >= 4096) code = 8191 - code;
+        words[i] = ADC_WORD(0, code);
+    }
+}
+
+//What every program used to do, plus the bad word rules from adc_unpack.h
+static int reference(int channel) {
+    int16_t last = 0;
+    int bad = 0;
+    for (int i = 0; i < BENCH_BLOCK; i++) {
+        uint32_t w = words[i];
+        bool ok = ADC_DONE(w) && !ADC_OVERRUN(w) && (channel < 0 || (int)ADC_CHANNEL(w) == channel);
+        if (ok) last = (int16_t)(((int)ADC_RESULT(w) - 2048) << 4);
+        else bad++;
+        expect[i] = last;
+    }
+    return bad;
+}
+
+static bool check_real(const int16_t *y) {
+    return memcmp(y, expect, sizeof(expect)) == 0;
+}
+
+static bool check_complex(const short *y) {
+    for (int i = 0; i < BENCH_BLOCK; i++) if (y[2 * i] != expect[i] || y[2 * i + 1] != 0) return false;
+    return true;
+}
+
+//Runs both kernels both ways, returns the number of mismatches
+static int verify(const char *name, int channel) {
+    int bad = reference(channel);
+    int failures = 0;
+    AdcUnpackStats stats;
+
+    memset(&stats, 0, sizeof(stats));
+    int n = adc_unpack_real(words, (int16_t *)out, BENCH_BLOCK, channel, &stats);
+    if (n != bad || !check_real((int16_t *)out)) failures++;
+
+    memcpy(work, words, sizeof(work));
+    n = adc_unpack_real(work, (int16_t *)work, BENCH_BLOCK, channel, 0);
+    if (n != bad || !check_real((int16_t *)work)) failures++;
+
+    n = adc_unpack_complex(words, out, BENCH_BLOCK, channel, 0);
+    if (n != bad || !check_complex(out)) failures++;
+
+    memcpy(work, words, sizeof(work));
+    n = adc_unpack_complex(work, (short *)work, BENCH_BLOCK, channel, 0);
+    if (n != bad || !check_complex((short *)work)) failures++;
+
+    //Front end, fused against two passes, over two blocks so the second is past the priming
+    Frontend a, b;
+    AdcUnpackStats fused_stats;
+    memset(&fused_stats, 0, sizeof(fused_stats));
+    frontend_init(&a, 10, FRONTEND_MAX_GAIN);
+    frontend_init(&b, 10, FRONTEND_MAX_GAIN);
+    for (int pass = 0; pass < 2; pass++) {
+        n = frontend_process(&a, words, fused, BENCH_BLOCK, channel, &fused_stats);
+        adc_unpack_real(words, (int16_t *)out, BENCH_BLOCK, channel, 0);
+        frontend_process_q15(&b, (int16_t *)out, (int16_t *)out, BENCH_BLOCK);
+        if (n != bad || memcmp(fused, out, sizeof(fused)) != 0 || a.level != b.level || a.crossings != b.crossings) failures++;
+    }
+    if (fused_stats.overruns != 2 * stats.overruns || fused_stats.not_done != 2 * stats.not_done
+        || fused_stats.wrong_channel != 2 * stats.wrong_channel) failures++;
+
+    report("%-14s %4d bad (%u not done, %u overrun, %u channel)  %s\n", name, bad,
+        stats.not_done, stats.overruns, stats.wrong_channel, failures ? "MISMATCH" : "ok");
+    return failures;
+}
+
+//Best of BENCH_RUNS
+static uint32_t time_reference(void) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        uint32_t start = cycle_count();
+        int16_t *y = (int16_t *)out;
+        for (int i = 0; i < BENCH_BLOCK; i++) {
+            if (ADC_CHANNEL(words[i]) == 0) y[i] = (int16_t)(((int)ADC_RESULT(words[i]) - 2048) << 4);
+        }
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+static uint32_t time_kernel(bool complex) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        uint32_t start = cycle_count();
+        if (complex) adc_unpack_complex(words, out, BENCH_BLOCK, 0, 0);
+        else adc_unpack_real(words, (int16_t *)out, BENCH_BLOCK, 0, 0);
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+//Best of BENCH_RUNS, the front end in its own loop or after adc_unpack_real()
+static uint32_t time_frontend(bool one_pass) {
+    Frontend f;
+    frontend_init(&f, 10, FRONTEND_MAX_GAIN);
+    uint32_t best = 0xFFFFFFFF;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        uint32_t start = cycle_count();
+        if (one_pass) {
+            frontend_process(&f, words, fused, BENCH_BLOCK, 0, 0);
+        } else {
+            adc_unpack_real(words, fused, BENCH_BLOCK, 0, 0);
+            frontend_process_q15(&f, fused, fused, BENCH_BLOCK);
+        }
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+int main() {
+    cycle_counter_init();
+    int failures = 0;
+
+    fill();
+    failures += verify("clean", 0);
+    failures += verify("any channel", ADC_ANY_CHANNEL);
+
+    //One of each kind, the first straight at the start where there is no last good sample
+    words[0] &= ~(1UL << 31);
+    words[5] |= 1UL << 30;
+    words[333] = ADC_WORD(1, 4000);
+    words[BENCH_BLOCK - 1] |= 1UL << 30;
+    failures += verify("bad words", 0);
+    failures += verify("bad, any chan", ADC_ANY_CHANNEL);
+
+    fill();
+    uint32_t ref = time_reference();
+    uint32_t real = time_kernel(false);
+    uint32_t cplx = time_kernel(true);
+    report("%d words: loop %u cycles (%.2f/word), real %u (%.2f/word), complex %u (%.2f/word)\n",
+        BENCH_BLOCK, ref, (double)ref / BENCH_BLOCK, real, (double)real / BENCH_BLOCK,
+        cplx, (double)cplx / BENCH_BLOCK);
+    uint32_t one = time_frontend(true);
+    uint32_t two = time_frontend(false);
+    report("front end: one pass %u cycles (%.2f/word), unpack then front end %u (%.2f/word)\n",
+        one, (double)one / BENCH_BLOCK, two, (double)two / BENCH_BLOCK);
+
+    report(failures ? "%d MISMATCHES\n" : "all kernels match\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Additive Resynthesis
+ * See additive.h
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "additive.h"
+#include "dds.h"
+#include "fixed_math.h"
+
+//Scaled so each preset peaks at about its amp, with the phases below
+static const int16_t preset_sine[] = { 32767 };
+static const int16_t preset_organ[] = { 12603, 8822, 6302, 6302, 0, 4411, 0, 3781 };
+static const int16_t preset_vocal[] = {
+    5120, 7168, 9216, 8192, 4096, 3072, 2560, 2048,
+    1536, 1280, 1024, 1024, 768, 640, 512, 410,
+    358, 307, 256, 205, 179, 154, 128, 102
+};
+
+/*
+ * Spectrum of the periodic Hann window d bins from its centre, over its value at d = 0
+ * sinc(d) / (1 - d^2), the finite N error is far below Q15
+ */
+static void kernel_init(int16_t *kernel) {
+    for (int i = 0; i <= ADDITIVE_KERNEL_HALF * ADDITIVE_KERNEL_RES; i++) {
+        double d = (double)i / ADDITIVE_KERNEL_RES, k;
+        if (i == 0) k = 1.0;
+        else if (i == ADDITIVE_KERNEL_RES) k = 0.5;
+        else k = sin(M_PI * d) / (M_PI * d * (1.0 - d * d));
+        kernel[i] = (int16_t)floor(k * 32767.0 + 0.5);
+    }
+}
+
+bool additive_init(Additive *a, int N, uint32_t sample_rate, const int16_t *table, int bits) {
+    if (N < 16 || N > ADDITIVE_MAX_N || sample_rate == 0) return false;
+    if (bits < DDS_MIN_BITS || bits > DDS_MAX_BITS) return false;
+    memset(a, 0, sizeof(*a));
+    if (!fft_plan_init(&a->plan, N)) return false;
+    a->N = N;
+    a->shift = 0;
+    while ((2 << a->shift) < N) a->shift++;   //N/2
+    a->sample_rate = sample_rate;
+    a->table = table;
+    a->bits = bits;
+    a->ready_pos = N / 2;
+    kernel_init(a->kernel);
+    additive_set_preset(a, ADDITIVE_SINE);
+    return true;
+}
+
+void additive_set_note(Additive *a, uint32_t freq_q8, int16_t amp) {
+    a->amp = amp;
+    a->hop_step = (uint32_t)(((uint64_t)freq_q8 << 24) * (a->N / 2) / a->sample_rate);
+    a->bin_q16 = (uint32_t)(((uint64_t)freq_q8 * a->N << 8) / a->sample_rate);
+}
+
+bool additive_set_profile(Additive *a, const int16_t *gains, int count) {
+    if (count < 1 || count > ADDITIVE_MAX_PARTIALS) return false;
+    memcpy(a->profile, gains, count * sizeof(gains[0]));
+    a->partials = count;
+    a->spread = 0x80000000UL / count;
+    return true;
+}
+
+void additive_set_preset(Additive *a, int preset) {
+    if (preset == ADDITIVE_ORGAN) additive_set_profile(a, preset_organ, sizeof(preset_organ) / sizeof(preset_organ[0]));
+    else if (preset == ADDITIVE_VOCAL) additive_set_profile(a, preset_vocal, sizeof(preset_vocal) / sizeof(preset_vocal[0]));
+    else additive_set_profile(a, preset_sine, 1);
+}
+
+/*
+ * A partial with phase p at the frame centre, amplitude A at bin kf puts
+ *   A/2 * K(k - kf) * e^(jp) * (-1)^k
+ * in bin k, and the conjugate in bin -k, which keeps the frame real.
+ * The (-1)^k moves the phase reference from sample 0 to the centre.
+ * Harmonic h is offset by pi * h^2 / partials (Schroeder phases) so the partials
+ * do not all peak at the same moment, which keeps the presets out of clipping.
+ */
+static void add_partial(Additive *a, uint32_t phase, uint32_t kf_q16, int32_t amp) {
+    int N = a->N, shift = 32 - a->bits;
+    int32_t c = dds_linear(a->table, phase + 0x40000000UL, shift);
+    int32_t s = dds_linear(a->table, phase, shift);
+    int32_t re = (amp * c) >> 16, im = (amp * s) >> 16;
+    int k0 = (int)(kf_q16 >> 16);
+
+    for (int k = k0 - ADDITIVE_KERNEL_HALF + 1; k <= k0 + ADDITIVE_KERNEL_HALF; k++) {
+        int32_t d = (k << 16) - (int32_t)kf_q16;
+        if (d < 0) d = -d;
+        int32_t K = a->kernel[(d + 128) >> 8];
+        if (k & 1) K = -K;
+        int32_t vr = (re * K) >> 15, vi = (im * K) >> 15;
+        int p = k & (N - 1), m = (-k) & (N - 1);
+        a->acc[2 * p] += vr;
+        a->acc[2 * p + 1] += vi;
+        a->acc[2 * m] += vr;
+        a->acc[2 * m + 1] -= vi;
+    }
+}
+
+static void synth_frame(Additive *a) {
+    int N = a->N, H = N / 2;
+    memset(a->acc, 0, 2 * N * sizeof(a->acc[0]));
+
+    //Harmonics whose lobe would reach Nyquist are left out instead of aliasing
+    int32_t limit = (H - ADDITIVE_KERNEL_HALF) << 16;
+    for (int h = 0; h < a->partials; h++) {
+        uint32_t kf = a->bin_q16 * (h + 1);
+        if ((int32_t)kf >= limit) break;
+        int32_t amp = (a->amp * a->profile[h]) >> 15;
+        if (amp) add_partial(a, a->phase * (h + 1) + a->spread * (uint32_t)(h * h), kf, amp);
+    }
+
+    for (int i = 0; i < 2 * N; i++) a->x.iq[i] = (short)sat_q15(a->acc[i]);
+    fft_plan_inverse(&a->plan, a->y.iq, a->x.iq);
+
+    //First half completes the last frame, second half waits for the next one
+    for (int i = 0; i < H; i++) {
+        a->ready[i] = (int16_t)sat_q15((a->tail[i] + a->y.iq[2 * i]) << a->shift);
+        a->tail[i] = a->y.iq[2 * (i + H)];
+    }
+    a->ready_pos = 0;
+    a->phase += a->hop_step;
+    a->frames++;
+}
+
+void additive_render(Additive *a, int32_t *mix, int count) {
+    int H = a->N / 2;
+    while (count > 0) {
+        if (a->ready_pos == H) synth_frame(a);
+        int n = H - a->ready_pos;
+        if (n > count) n = count;
+        const int16_t *r = a->ready + a->ready_pos;
+        for (int i = 0; i < n; i++) mix[i] = r[i];
+        a->ready_pos += n;
+        mix += n;
+        count -= n;
+    }
+}
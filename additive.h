@@ -0,0 +1,85 @@
+/*
+ * Additive Resynthesis
+ * Objective: Dozens of partials for the price of one inverse FFT per hop
+ *
+ * Each hop of N/2 samples one frame of N is built in the frequency domain and
+ * turned into samples with ifftR4 (through an FftPlan), then overlap-added with
+ * the second half of the frame before. A frame holds every partial under a Hann
+ * window, and Hann frames at half overlap add back up to a steady tone.
+ *
+ * A windowed partial at fractional bin kf only has energy in the few bins either
+ * side of kf (the Hann main lobe and the first side lobes), so each partial costs
+ * 2 * ADDITIVE_KERNEL_HALF complex multiply adds, not N/2 oscillator samples. The
+ * IFFT is the same whatever the partial count.
+ *
+ * The partials are harmonics of one note, gains from a programmable profile,
+ * their phases locked to the fundamental's. Note and level changes land at the
+ * next frame and are crossfaded by the overlap-add, so they never click.
+ *
+ * ifftR4 scales by 1/N, so a full scale partial leaves the IFFT with about
+ * 65536/N of amplitude: N = 256 keeps it above the 10 bit DAC resolution.
+ * Latency is one frame, N samples.
+ */
+
+#ifndef ADDITIVE_H
+#define ADDITIVE_H
+
+#include <stdint.h>
+
+#include "fft_plan.h"
+#include "fft_sized.h"
+
+#define ADDITIVE_MAX_N        256
+#define ADDITIVE_MAX_PARTIALS 32
+#define ADDITIVE_KERNEL_HALF  3     //Bins either side of a partial, the rest is below -42dB
+#define ADDITIVE_KERNEL_RES   256   //Kernel table steps per bin
+
+enum AdditivePreset {
+    ADDITIVE_SINE = 0,  //Fundamental only
+    ADDITIVE_ORGAN,     //8' 4' 2 2/3' 2' 1 1/3' 1' drawbars
+    ADDITIVE_VOCAL      //Open "ah", 24 partials, formants placed for notes around A3
+};
+
+struct Additive {
+    FftPlan        plan;
+    int            N;                               //Frame, the hop is N/2
+    int            shift;                           //IFFT output to Q15
+    uint32_t       sample_rate;
+    const int16_t *table;                           //dds_table_init() sine for the partial phases
+    int            bits;
+    int32_t        amp;                             //Q15 fundamental level
+    uint32_t       phase;                           //Fundamental phase at the next frame centre
+    uint32_t       hop_step;                        //Its advance per hop
+    uint32_t       bin_q16;                         //Fundamental in bins, Q16
+    int            partials;
+    int16_t        profile[ADDITIVE_MAX_PARTIALS];  //Q15 gain of harmonic h + 1
+    uint32_t       spread;                          //Phase offset step between partials
+    int16_t        kernel[ADDITIVE_KERNEL_HALF * ADDITIVE_KERNEL_RES + 1];  //Hann lobe, Q15
+    int32_t        acc[2 * ADDITIVE_MAX_N];         //Spectrum before saturation
+    ComplexQ15Buffer<ADDITIVE_MAX_N> x;             //Saturated spectrum, the IFFT input
+    ComplexQ15Buffer<ADDITIVE_MAX_N> y;             //IFFT output, the frame
+    int32_t        tail[ADDITIVE_MAX_N / 2];        //Second half of the last frame
+    int16_t        ready[ADDITIVE_MAX_N / 2];       //Finished samples
+    int            ready_pos;
+    uint32_t       frames;
+};
+
+/*
+ * N must be an fftR4 size from 16 to ADDITIVE_MAX_N
+ * table/bits as for dds_init(), shared with the mixer is fine
+ * Starts silent with the sine preset
+ */
+bool additive_init(Additive *a, int N, uint32_t sample_rate, const int16_t *table, int bits);
+
+//Note and Q15 level from the next frame on
+void additive_set_note(Additive *a, uint32_t freq_q8, int16_t amp);
+
+//Q15 gains of harmonics 1..count, returns false if count is out of range
+bool additive_set_profile(Additive *a, const int16_t *gains, int count);
+
+void additive_set_preset(Additive *a, int preset);
+
+//count Q15 samples into mix, synthesizing frames as they are needed
+void additive_render(Additive *a, int32_t *mix, int count);
+
+#endif
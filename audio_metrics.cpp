@@ -0,0 +1,124 @@
+/*
+ * Audio Metrics
+ * See audio_metrics.h
+ */
+
+#include <math.h>
+
+#include "audio_metrics.h"
+
+static double mean(const double *x, size_t count) {
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) sum += x[i];
+    return count ? sum / count : 0;
+}
+
+double metrics_frequency(const double *x, size_t count, double sample_rate) {
+    double m = mean(x, count);
+    double first = 0, last = 0;
+    int crossings = 0;
+    for (size_t i = 1; i < count; i++) {
+        double a = x[i - 1] - m, b = x[i] - m;
+        if (a < 0 && b >= 0) {
+            double t = (i - 1) + a / (a - b);
+            if (!crossings) first = t;
+            last = t;
+            crossings++;
+        }
+    }
+    if (crossings < 2) return 0;
+    return (crossings - 1) * sample_rate / (last - first);
+}
+
+//Least squares fit of x = c[0] + c[1]*cos + c[2]*sin, normal equations in 3x3
+static void fit_sine(const double *x, size_t count, double sample_rate, double freq, double c[3]) {
+    double s[3][3] = {{0}}, r[3] = {0};
+    double w = 2 * M_PI * freq / sample_rate;
+    for (size_t i = 0; i < count; i++) {
+        double v[3] = { 1, cos(w * i), sin(w * i) };
+        for (int j = 0; j < 3; j++) {
+            r[j] += v[j] * x[i];
+            for (int k = 0; k < 3; k++) s[j][k] += v[j] * v[k];
+        }
+    }
+    //Gaussian elimination, the system is symmetric positive definite
+    for (int j = 0; j < 3; j++) {
+        for (int k = j + 1; k < 3; k++) {
+            double f = s[k][j] / s[j][j];
+            for (int l = j; l < 3; l++) s[k][l] -= f * s[j][l];
+            r[k] -= f * r[j];
+        }
+    }
+    for (int j = 2; j >= 0; j--) {
+        double v = r[j];
+        for (int k = j + 1; k < 3; k++) v -= s[j][k] * c[k];
+        c[j] = v / s[j][j];
+    }
+}
+
+double metrics_thd_n(const double *x, size_t count, double sample_rate, double freq, double *fundamental_rms) {
+    double c[3];
+    double w = 2 * M_PI * freq / sample_rate;
+    fit_sine(x, count, sample_rate, freq, c);
+
+    double residual = 0;
+    for (size_t i = 0; i < count; i++) {
+        double e = x[i] - (c[0] + c[1] * cos(w * i) + c[2] * sin(w * i));
+        residual += e * e;
+    }
+    double fund = sqrt((c[1] * c[1] + c[2] * c[2]) / 2);
+    if (fundamental_rms) *fundamental_rms = fund;
+    if (fund == 0 || count == 0) return 0;
+    return sqrt(residual / count) / fund;
+}
+
+double metrics_thd_n_band(const double *x, size_t count, double sample_rate, double freq, double band, double *fundamental_rms) {
+    double c[3];
+    double w = 2 * M_PI * freq / sample_rate;
+    fit_sine(x, count, sample_rate, freq, c);
+    double fund = sqrt((c[1] * c[1] + c[2] * c[2]) / 2);
+    if (fundamental_rms) *fundamental_rms = fund;
+    if (band >= sample_rate / 2) return metrics_thd_n(x, count, sample_rate, freq, 0);
+
+    //8th order Butterworth as four RBJ low pass biquads, one per pole pair
+    double b0[4], b1[4], a1[4], a2[4], z1[4] = {0}, z2[4] = {0};
+    double wc = 2 * M_PI * band / sample_rate;
+    for (int k = 0; k < 4; k++) {
+        double q = 1 / (2 * cos((2 * k + 1) * M_PI / 16));
+        double alpha = sin(wc) / (2 * q), a0 = 1 + alpha;
+        b0[k] = (1 - cos(wc)) / 2 / a0;
+        b1[k] = (1 - cos(wc)) / a0;
+        a1[k] = -2 * cos(wc) / a0;
+        a2[k] = (1 - alpha) / a0;
+    }
+
+    //Skip the filter settling, a few hundred periods of the band edge
+    size_t settle = (size_t)(200 * sample_rate / band);
+    double residual = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        double e = x[i] - (c[0] + c[1] * cos(w * i) + c[2] * sin(w * i));
+        for (int k = 0; k < 4; k++) {
+            //Transposed direct form II, b2 = b0
+            double y = b0[k] * e + z1[k];
+            z1[k] = b1[k] * e - a1[k] * y + z2[k];
+            z2[k] = b0[k] * e - a2[k] * y;
+            e = y;
+        }
+        if (i >= settle) {
+            residual += e * e;
+            n++;
+        }
+    }
+    if (fund == 0 || n == 0) return 0;
+    return sqrt(residual / n) / fund;
+}
+
+double metrics_db(double ratio) {
+    return ratio > 1e-12 ? 20 * log10(ratio) : -240;
+}
+
+double metrics_cents(double measured, double requested) {
+    if (measured <= 0 || requested <= 0) return 0;
+    return 1200 * log2(measured / requested);
+}
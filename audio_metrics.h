@@ -0,0 +1,42 @@
+/*
+ * Audio Metrics
+ * Objective: Put numbers on how the synthesized output sounds
+ *
+ * Works on a reconstructed output in doubles, full scale +-1.
+ * Host only, never built for the mbed.
+ */
+
+#ifndef AUDIO_METRICS_H
+#define AUDIO_METRICS_H
+
+#include <stddef.h>
+
+/*
+ * Fundamental from upward crossings of the mean, interpolated between samples
+ * Averaged over the whole buffer so it resolves far below a cent on a held note
+ * Returns 0 if there are fewer than two crossings
+ */
+double metrics_frequency(const double *x, size_t count, double sample_rate);
+
+/*
+ * THD+N as a ratio: RMS of everything but DC and a sine at freq, over the RMS of that sine
+ * The sine is a least squares fit, so the buffer need not hold whole cycles.
+ * The bandwidth is whatever the buffer holds, i.e. DC to sample_rate/2.
+ * fundamental_rms may be 0
+ */
+double metrics_thd_n(const double *x, size_t count, double sample_rate, double freq, double *fundamental_rms);
+
+/*
+ * The same, but only counting what is left below band Hz (an 8th order Butterworth
+ * low pass on the residual), for noise shaped output whose error sits above the
+ * audio band. Falls back to metrics_thd_n() when band is not below sample_rate/2.
+ */
+double metrics_thd_n_band(const double *x, size_t count, double sample_rate, double freq, double band, double *fundamental_rms);
+
+//Ratio to dB, with a floor so a perfect signal does not print -inf
+double metrics_db(double ratio);
+
+//Pitch error of measured against requested
+double metrics_cents(double measured, double requested);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Batch Analyzer
+ * Objective: Tune pitch detection against every recorded session at once
+ *
+ * Host only (Linux, C++11). Runs the firmware analysis path (fftR4 port, peak
+ * refinement, PitchTracker) over every capture and every combination of the
+ * parameters given, spread over all cores with a work stealing pool.
+ *
+ * Build:
+ *   g++ -O2 -std=c++11 -pthread -o batch_analyzer batch_analyzer.cpp capture.cpp fft_r4.cpp pitch.cpp scheduler.cpp health.cpp
+ *
+ * Usage: batch_analyzer [options] CAPTURE.THC[:ref_hz] ...
+ *   -n 256,1024      FFT sizes                       (default 1024)
+ *   -w hann,rect     windows: rect, hann, hamming    (default hann)
+ *   -p 256,512       hop between frames in samples   (default N/4)
+ *   -c 0.2,0.4       tracker min confidence          (default 0.2)
+ *   -f 25:4200       search band in Hz               (default 25:4200)
+ *   -j 8             worker threads                  (default all cores)
+ *   -o dir           write one per-frame CSV per run into dir
+ *
+ * A capture given as FILE:440 is a held reference note, and its runs get
+ * accuracy figures (cents error, octave errors) as well as throughput.
+ * One summary CSV line per run goes to stdout.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "fft_r4.h"
+#include "pitch.h"
+#include "thread_pool.h"
+
+struct Capture {
+    std::string name;
+    double ref_hz;                  //0 if unknown
+    uint32_t sample_rate;
+    std::vector<uint16_t> samples;  //Channel 0 only, 12 bit codes
+};
+
+struct Params {
+    int N;
+    int window;
+    int hop;                        //0 means N/4
+    double min_confidence;
+};
+
+struct RunResult {
+    int frames;
+    int voiced;
+    double median_hz;
+    double mean_abs_cents;
+    double rms_cents;
+    int octave_errors;
+    int within_50c;
+    double seconds;                 //Wall time of the run
+    double audio_seconds;
+};
+
+static const char *window_names[] = { "rect", "hann", "hamming" };
+
+static double fmin_hz = 25.0, fmax_hz = 4200.0;
+static const char *out_dir = 0;
+
+static bool load_capture(const char *arg, Capture *c) {
+    std::string path(arg);
+    c->ref_hz = 0;
+    size_t colon = path.rfind(':');
+    if (colon != std::string::npos) {
+        c->ref_hz = atof(path.c_str() + colon + 1);
+        path = path.substr(0, colon);
+    }
+
+    CaptureReader reader;
+    if (!capture_open(&reader, path.c_str())) return false;
+    c->name = path;
+    c->sample_rate = reader.header.sample_rate;
+
+    uint16_t block[CAPTURE_BLOCK_SAMPLES];
+    int n;
+    while ((n = capture_read(&reader, block, CAPTURE_BLOCK_SAMPLES)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if ((block[i] >> 12) == 0) c->samples.push_back(block[i] & 0xFFF);
+        }
+    }
+    capture_close(&reader);
+    return true;
+}
+
+static std::string run_name(const Capture &c, const Params &p) {
+    std::string base = c.name;
+    size_t slash = base.rfind('/');
+    if (slash != std::string::npos) base = base.substr(slash + 1);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "_N%d_%s_h%d_c%.2f.csv", p.N, window_names[p.window], p.hop, p.min_confidence);
+    return base + buf;
+}
+
+static void analyze(const Capture &c, Params p, RunResult *r) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<short> window(p.N), x(2 * p.N), y(2 * p.N);
+    pitch_window_init(&window[0], p.N, p.window);
+
+    PitchFft cfg;
+    cfg.N = p.N;
+    cfg.sample_rate = c.sample_rate;
+    cfg.fmin_q8 = PITCH_Q8(fmin_hz);
+    cfg.fmax_q8 = PITCH_Q8(fmax_hz);
+    cfg.window = p.window == WINDOW_RECT ? 0 : &window[0];
+    cfg.coef = 0;
+    cfg.x = &x[0];
+    cfg.y = &y[0];
+
+    PitchTracker tracker;
+    pitch_tracker_init(&tracker, (uint16_t)(p.min_confidence * 32767), 8192, 4);
+
+    FILE *csv = 0;
+    if (out_dir) {
+        std::string path = std::string(out_dir) + "/" + run_name(c, p);
+        csv = fopen(path.c_str(), "w");
+        if (csv) fprintf(csv, "frame,time_s,raw_hz,confidence,tracked_hz\n");
+    }
+
+    std::vector<double> voiced_hz;
+    double sum_abs = 0, sum_sq = 0;
+    memset(r, 0, sizeof(*r));
+
+    for (size_t pos = 0; pos + p.N <= c.samples.size(); pos += p.hop) {
+        PitchResult raw;
+        pitch_fft(&cfg, &c.samples[pos], &raw);
+        uint32_t tracked = pitch_tracker_update(&tracker, &raw);
+        r->frames++;
+
+        if (csv) {
+            fprintf(csv, "%d,%.5f,%.3f,%.4f,%.3f\n", r->frames - 1,
+                (double)(pos + p.N) / c.sample_rate, raw.freq_q8 / 256.0,
+                raw.confidence / 32767.0, tracked / 256.0);
+        }
+
+        if (!tracked) continue;
+        double hz = tracked / 256.0;
+        r->voiced++;
+        voiced_hz.push_back(hz);
+
+        if (c.ref_hz > 0) {
+            double cents = 1200.0 * log2(hz / c.ref_hz);
+            double octaves = floor(cents / 1200.0 + 0.5);
+            if (octaves != 0 && fabs(cents - 1200.0 * octaves) < 100.0) r->octave_errors++;
+            if (fabs(cents) < 50.0) r->within_50c++;
+            sum_abs += fabs(cents);
+            sum_sq += cents * cents;
+        }
+    }
+    if (csv) fclose(csv);
+
+    if (!voiced_hz.empty()) {
+        std::nth_element(voiced_hz.begin(), voiced_hz.begin() + voiced_hz.size() / 2, voiced_hz.end());
+        r->median_hz = voiced_hz[voiced_hz.size() / 2];
+    }
+    if (r->voiced && c.ref_hz > 0) {
+        r->mean_abs_cents = sum_abs / r->voiced;
+        r->rms_cents = sqrt(sum_sq / r->voiced);
+    }
+    r->audio_seconds = (double)c.samples.size() / c.sample_rate;
+    r->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Comma separated list, e.g. "256,1024"
+static std::vector<std::string> split(const char *s) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (; *s; s++) {
+        if (*s == ',') {
+            out.push_back(cur);
+            cur.clear();
+        } else {
+            cur += *s;
+        }
+    }
+    out.push_back(cur);
+    return out;
+}
+
+static int window_type(const std::string &name) {
+    for (int i = 0; i < 3; i++) if (name == window_names[i]) return i;
+    return -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n sizes] [-w windows] [-p hops] [-c confidences] [-f min:max] [-j threads] [-o dir] CAPTURE[:ref_hz] ...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> sizes(1, 1024), windows(1, WINDOW_HANN), hops(1, 0);
+    std::vector<double> confidences(1, 0.2);
+    unsigned threads = 0;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && i + 1 < argc) {
+            std::vector<std::string> v = split(argv[i + 1]);
+            switch (argv[i][1]) {
+            case 'n':
+                sizes.clear();
+                for (size_t k = 0; k < v.size(); k++) sizes.push_back(atoi(v[k].c_str()));
+                break;
+            case 'w':
+                windows.clear();
+                for (size_t k = 0; k < v.size(); k++) windows.push_back(window_type(v[k]));
+                break;
+            case 'p':
+                hops.clear();
+                for (size_t k = 0; k < v.size(); k++) hops.push_back(atoi(v[k].c_str()));
+                break;
+            case 'c':
+                confidences.clear();
+                for (size_t k = 0; k < v.size(); k++) confidences.push_back(atof(v[k].c_str()));
+                break;
+            case 'f':
+                sscanf(argv[i + 1], "%lf:%lf", &fmin_hz, &fmax_hz);
+                break;
+            case 'j':
+                threads = atoi(argv[i + 1]);
+                break;
+            case 'o':
+                out_dir = argv[i + 1];
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+            }
+            i++;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (!fft_r4_size_ok(sizes[i]) || sizes[i] < 64) {
+            fprintf(stderr, "FFT size %d not supported, use 64, 256, 1024 or 4096\n", sizes[i]);
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < windows.size(); i++) {
+        if (windows[i] < 0) {
+            fprintf(stderr, "unknown window, use rect, hann or hamming\n");
+            return 1;
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Capture> captures(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!load_capture(files[i], &captures[i])) {
+            fprintf(stderr, "%s is not a capture file\n", files[i]);
+            return 1;
+        }
+    }
+
+    //Every capture against every parameter combination
+    struct Run { size_t capture; Params params; };
+    std::vector<Run> runs;
+    for (size_t c = 0; c < captures.size(); c++)
+        for (size_t n = 0; n < sizes.size(); n++)
+            for (size_t w = 0; w < windows.size(); w++)
+                for (size_t h = 0; h < hops.size(); h++)
+                    for (size_t k = 0; k < confidences.size(); k++) {
+                        Run run;
+                        run.capture = c;
+                        run.params.N = sizes[n];
+                        run.params.window = windows[w];
+                        run.params.hop = hops[h] > 0 ? hops[h] : sizes[n] / 4;
+                        run.params.min_confidence = confidences[k];
+                        runs.push_back(run);
+                    }
+
+    std::vector<RunResult> results(runs.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned workers;
+    {
+        ThreadPool pool(threads);
+        workers = pool.size();
+        for (size_t i = 0; i < runs.size(); i++) {
+            const Run *run = &runs[i];
+            RunResult *result = &results[i];
+            const Capture *capture = &captures[run->capture];
+            pool.submit([run, result, capture] { analyze(*capture, run->params, result); });
+        }
+        pool.wait();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("capture,N,window,hop,min_conf,frames,voiced_pct,median_hz,ref_hz,mean_abs_cents,rms_cents,octave_err_pct,within_50c_pct,frames_per_s,realtime_x\n");
+    double total_frames = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Capture &c = captures[runs[i].capture];
+        const Params &p = runs[i].params;
+        const RunResult &r = results[i];
+        double voiced = r.frames ? 100.0 * r.voiced / r.frames : 0;
+        double octave = r.voiced ? 100.0 * r.octave_errors / r.voiced : 0;
+        double within = r.voiced ? 100.0 * r.within_50c / r.voiced : 0;
+        printf("%s,%d,%s,%d,%.2f,%d,%.1f,%.3f,%.3f,%.2f,%.2f,%.2f,%.1f,%.0f,%.1f\n",
+            c.name.c_str(), p.N, window_names[p.window], p.hop, p.min_confidence,
+            r.frames, voiced, r.median_hz, c.ref_hz, r.mean_abs_cents, r.rms_cents, octave, within,
+            r.seconds > 0 ? r.frames / r.seconds : 0, r.seconds > 0 ? r.audio_seconds / r.seconds : 0);
+        total_frames += r.frames;
+    }
+    fprintf(stderr, "%zu runs, %.0f frames on %u threads in %.2f s (%.0f frames/s)\n",
+        runs.size(), total_frames, workers, wall, wall > 0 ? total_frames / wall : 0);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Calibration Table Tool
+ * Objective: Make and inspect antenna calibration tables on the PC
+ *
+ * Host only. The board records its own tables (send 'c', 'n'..., 's' to adc_fft),
+ * this builds one from points measured some other way, or looks at one copied off
+ * the mbed's drive.
+ *
+ * Build:
+ *   g++ -O2 -o calib_tool calib_tool.cpp calibration.cpp
+ *
+ * Usage:
+ *   calib_tool build POINTS.TXT CALIB.LUT   one "antenna_hz note_hz" pair per line, # comments
+ *   calib_tool dump CALIB.LUT [antenna_hz ...]
+ *
+ * build saves the table, loads it back and prints how far calib_map() lands from
+ * the straight lines between the points, at the points and halfway between them.
+ * dump prints the header and the played pitch for each antenna pitch given.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calibration.h"
+
+static CalibLut lut;
+
+static uint32_t to_q8(double hz) {
+    return (uint32_t)(hz * 256.0 + 0.5);
+}
+
+static double cents(uint32_t got_q8, double want_hz) {
+    return 1200.0 * log2(got_q8 / 256.0 / want_hz);
+}
+
+//Worst error in cents at the points and halfway between neighbours
+static double check(const CalibPoint *points, int n) {
+    double worst = 0;
+    for (int i = 0; i < n; i++) {
+        double e = fabs(cents(calib_map(&lut, points[i].in_q8), points[i].out_q8 / 256.0));
+        if (e > worst) worst = e;
+        if (i == n - 1) break;
+        uint32_t mid = (points[i].in_q8 + points[i + 1].in_q8) / 2;
+        double want = (points[i].out_q8 + points[i + 1].out_q8) / 512.0;
+        e = fabs(cents(calib_map(&lut, mid), want));
+        if (e > worst) worst = e;
+    }
+    return worst;
+}
+
+static int build(const char *in, const char *out) {
+    FILE *fp = fopen(in, "r");
+    if (!fp) {
+        fprintf(stderr, "could not open %s\n", in);
+        return 1;
+    }
+    static CalibPoint points[CALIB_MAX_POINTS];
+    int n = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        double antenna, note;
+        if (line[0] == '#' || sscanf(line, "%lf %lf", &antenna, &note) != 2) continue;
+        if (n == CALIB_MAX_POINTS) {
+            fprintf(stderr, "more than %d points, the rest are ignored\n", CALIB_MAX_POINTS);
+            break;
+        }
+        points[n].in_q8 = to_q8(antenna);
+        points[n].out_q8 = to_q8(note);
+        n++;
+    }
+    fclose(fp);
+
+    int distinct = calib_build(points, n, &lut);
+    if (!distinct) {
+        fprintf(stderr, "need at least 2 points at different antenna pitches\n");
+        return 1;
+    }
+    if (!calib_save(out, &lut, n) || !calib_load(out, &lut)) {
+        fprintf(stderr, "could not write %s\n", out);
+        return 1;
+    }
+    printf("%s: %d points, %d entries %.3fHz apart from %.3fHz, worst %.2f cents\n", out, n,
+        lut.count, (1UL << lut.shift) / 256.0, lut.in_min_q8 / 256.0, check(points, distinct));
+    return 0;
+}
+
+static int dump(const char *path, int argc, char **argv) {
+    if (!calib_load(path, &lut)) {
+        fprintf(stderr, "%s is not a calibration table\n", path);
+        return 1;
+    }
+    printf("%d entries %.3fHz apart from %.3fHz\n", lut.count, (1UL << lut.shift) / 256.0, lut.in_min_q8 / 256.0);
+    for (int i = 0; i < argc; i++) {
+        double hz = atof(argv[i]);
+        printf("%10.3f -> %10.3f\n", hz, calib_map(&lut, to_q8(hz)) / 256.0);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "build") == 0) return build(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "dump") == 0) return dump(argv[2], argc - 3, argv + 3);
+    fprintf(stderr, "usage: calib_tool build POINTS.TXT CALIB.LUT\n       calib_tool dump CALIB.LUT [antenna_hz ...]\n");
+    return 1;
+}
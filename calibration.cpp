@@ -0,0 +1,127 @@
+/*
+ * Antenna Calibration
+ * See calibration.h for the table and the file layout
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "calibration.h"
+
+uint32_t calib_note_q8(uint32_t base_q8, int semitones) {
+    //2^(k/12) in Q16
+    static const uint32_t ratio[12] = {
+        65536, 69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715
+    };
+    int octave = semitones >= 0 ? semitones / 12 : -((11 - semitones) / 12);
+    uint64_t f = (uint64_t)base_q8 * ratio[semitones - 12 * octave];
+    return (uint32_t)(octave >= 0 ? (f << octave) >> 16 : f >> (16 - octave));
+}
+
+void calib_identity(CalibLut *lut, uint32_t lo_q8, uint32_t hi_q8) {
+    CalibPoint ends[2] = { { lo_q8, lo_q8 }, { hi_q8, hi_q8 } };
+    calib_build(ends, 2, lut);
+}
+
+//Insertion sort by antenna pitch, then equal pitches merged into their mean, returns the points left
+static int sort_points(CalibPoint *p, int n) {
+    for (int i = 1; i < n; i++) {
+        CalibPoint v = p[i];
+        int j = i;
+        while (j > 0 && p[j - 1].in_q8 > v.in_q8) {
+            p[j] = p[j - 1];
+            j--;
+        }
+        p[j] = v;
+    }
+    int out = 0;
+    for (int i = 0; i < n; ) {
+        uint64_t sum = 0;
+        int j = i;
+        while (j < n && p[j].in_q8 == p[i].in_q8) sum += p[j++].out_q8;
+        p[out].in_q8 = p[i].in_q8;
+        p[out].out_q8 = (uint32_t)(sum / (j - i));
+        out++;
+        i = j;
+    }
+    return out;
+}
+
+int calib_build(CalibPoint *points, int n, CalibLut *lut) {
+    n = sort_points(points, n);
+    if (n < 2) return 0;
+
+    //Smallest power of two spacing that reaches the last point
+    uint32_t span = points[n - 1].in_q8 - points[0].in_q8;
+    int shift = 0;
+    while ((uint64_t)(CALIB_ENTRIES - 1) << shift < span) shift++;
+
+    lut->in_min_q8 = points[0].in_q8;
+    lut->shift = shift;
+    lut->count = CALIB_ENTRIES;
+    int j = 0;
+    for (int i = 0; i < CALIB_ENTRIES; i++) {
+        uint64_t x = (uint64_t)points[0].in_q8 + ((uint64_t)i << shift);
+        while (j < n - 2 && x >= points[j + 1].in_q8) j++;
+        if (x >= points[n - 1].in_q8) {
+            lut->out_q8[i] = points[n - 1].out_q8;
+            continue;
+        }
+        const CalibPoint *a = &points[j], *b = &points[j + 1];
+        int64_t rise = (int64_t)b->out_q8 - a->out_q8;
+        lut->out_q8[i] = (uint32_t)(a->out_q8 + rise * (int64_t)(x - a->in_q8) / (int64_t)(b->in_q8 - a->in_q8));
+    }
+    return n;
+}
+
+static uint32_t checksum(const uint32_t *table, int count) {
+    uint32_t sum = 0;
+    for (int i = 0; i < count; i++) sum += table[i];
+    return sum;
+}
+
+bool calib_save(const char *path, const CalibLut *lut, int points) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return false;
+
+    CalibHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CALIB_MAGIC, 4);
+    h.version     = CALIB_VERSION;
+    h.header_size = sizeof(CalibHeader);
+    h.in_min_q8   = lut->in_min_q8;
+    h.shift       = lut->shift;
+    h.count       = lut->count;
+    h.points      = points;
+    h.checksum    = checksum(lut->out_q8, lut->count);
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+        && fwrite(lut->out_q8, sizeof(uint32_t), lut->count, fp) == (size_t)lut->count;
+    //The data only reaches the LocalFileSystem on close
+    if (fclose(fp) != 0) ok = false;
+    return ok;
+}
+
+bool calib_load(const char *path, CalibLut *lut) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    //Read into a scratch table, a bad file must not leave lut half written
+    static uint32_t table[CALIB_ENTRIES];
+    CalibHeader h;
+    bool ok = fread(&h, sizeof(h), 1, fp) == 1
+        && memcmp(h.magic, CALIB_MAGIC, 4) == 0
+        && h.version == CALIB_VERSION
+        && h.header_size >= sizeof(CalibHeader)
+        && h.count >= 2 && h.count <= CALIB_ENTRIES && h.shift < 32
+        && fseek(fp, h.header_size, SEEK_SET) == 0
+        && fread(table, sizeof(uint32_t), h.count, fp) == h.count
+        && checksum(table, h.count) == h.checksum;
+    fclose(fp);
+    if (!ok) return false;
+
+    lut->in_min_q8 = h.in_min_q8;
+    lut->shift = h.shift;
+    lut->count = h.count;
+    memcpy(lut->out_q8, table, h.count * sizeof(uint32_t));
+    return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * Antenna Calibration
+ * Objective: Map the antenna pitch to the played pitch with one table lookup
+ *
+ * Every instrument (antenna, room, player) bends the antenna frequency differently.
+ * A calibration run records reference points, antenna frequency against the note it
+ * should play, and calib_build() resamples the piecewise linear curve through them
+ * onto a uniform grid:
+ *
+ *   out_q8[i] is the played pitch at antenna pitch in_min_q8 + (i << shift)
+ *
+ * so at runtime calib_map() is a shift, one indexed load pair and one interpolation,
+ * whatever the number of points. Inputs outside the grid give the end entries,
+ * antenna pitches past the last point play the last point's note.
+ *
+ * The table is saved as a small binary file, a fixed header and count words:
+ *
+ *   CalibHeader (24 bytes)
+ *   uint32_t out_q8[count]     Hz * 256, little endian
+ *
+ * calib_load() is two freads and a copy into a CalibLut in RAM, so boot time
+ * does not depend on how the calibration was made.
+ * LocalFileSystem only knows 8.3 names, e.g. "/local/CALIB.LUT"
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+
+#define CALIB_MAGIC   "THRL"
+#define CALIB_VERSION 1
+
+#define CALIB_ENTRIES 257       //256 segments, 1KB of table
+#define CALIB_MAX_POINTS 64     //Reference points one run can record
+
+struct CalibHeader {
+    char     magic[4];          //"THRL"
+    uint16_t version;           //CALIB_VERSION
+    uint16_t header_size;       //sizeof(CalibHeader), the table starts here
+    uint32_t in_min_q8;         //Antenna pitch of entry 0, Hz * 256
+    uint16_t shift;             //Entries are 1 << shift apart, in antenna Hz * 256
+    uint16_t count;             //Entries, at most CALIB_ENTRIES
+    uint32_t points;            //Reference points the table was built from, for information
+    uint32_t checksum;          //Sum of the entries
+};
+
+struct CalibLut {
+    uint32_t in_min_q8;
+    int      shift;
+    int      count;
+    uint32_t out_q8[CALIB_ENTRIES];
+};
+
+struct CalibPoint {
+    uint32_t in_q8;             //Antenna pitch, Hz * 256
+    uint32_t out_q8;            //Pitch to play there, Hz * 256
+};
+
+//Equal tempered note semitones above (or below) base_q8, both Hz * 256
+uint32_t calib_note_q8(uint32_t base_q8, int semitones);
+
+//Straight through between lo_q8 and hi_q8, the mapping without a calibration file
+void calib_identity(CalibLut *lut, uint32_t lo_q8, uint32_t hi_q8);
+
+/*
+ * Sorts the points by antenna pitch and resamples them onto CALIB_ENTRIES entries
+ * covering the first to the last. Points at the same antenna pitch are averaged.
+ * Returns the points left after that, 0 (lut untouched) if fewer than 2.
+ */
+int calib_build(CalibPoint *points, int n, CalibLut *lut);
+
+//Writes the table, false if the file could not be written
+bool calib_save(const char *path, const CalibLut *lut, int points);
+
+//Reads a table, false (lut untouched) if the file is missing, another CALIB_VERSION or not a good table
+bool calib_load(const char *path, CalibLut *lut);
+
+//Played pitch for an antenna pitch, both Hz * 256
+static inline uint32_t calib_map(const CalibLut *lut, uint32_t in_q8) {
+    if (in_q8 <= lut->in_min_q8) return lut->out_q8[0];
+    uint32_t x = in_q8 - lut->in_min_q8;
+    uint32_t i = x >> lut->shift;
+    if (i >= (uint32_t)lut->count - 1) return lut->out_q8[lut->count - 1];
+    int32_t frac = (int32_t)(x & ((1UL << lut->shift) - 1));
+    int32_t rise = (int32_t)(lut->out_q8[i + 1] - lut->out_q8[i]);
+    return lut->out_q8[i] + (int32_t)(((int64_t)rise * frac) >> lut->shift);
+}
+
+#endif
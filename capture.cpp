@@ -0,0 +1,137 @@
+/*
+ * Binary Capture Files
+ * See capture.h for the file layout
+ *
+ * The recorder is a ring of CAPTURE_BLOCKS blocks.
+ * capture_push() fills the block at head, capture_write_handler() drains from tail.
+ * Only the pusher moves head and only the writer moves tail, so pushing from an
+ * ISR while a write is in progress is safe.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+#include "adc_defs.h"
+#include "health.h"
+#include "scheduler.h"
+
+static FILE *out = 0;
+static uint16_t blocks[CAPTURE_BLOCKS][CAPTURE_BLOCK_SAMPLES];
+static volatile int head = 0;       //Block being filled
+static volatile int tail = 0;       //Oldest full block
+static int fill = 0;                //Samples in blocks[head]
+static uint32_t written = 0;
+static volatile uint32_t dropped = 0;
+
+bool capture_start(const char *path, uint32_t sample_rate, int channels, uint32_t adcr) {
+    out = fopen(path, "wb");
+    if (!out) return false;
+
+    CaptureHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAPTURE_MAGIC, 4);
+    h.version     = CAPTURE_VERSION;
+    h.header_size = sizeof(CaptureHeader);
+    h.sample_rate = sample_rate;
+    h.channels    = channels;
+    h.bits        = 12;
+    h.adcr        = adcr;
+    h.timestamp   = (uint32_t)time(NULL);
+    fwrite(&h, sizeof(h), 1, out);
+
+    head = tail = fill = 0;
+    written = dropped = 0;
+    return true;
+}
+
+//Hands the full block at head to the writer, false if the ring has no free block
+static bool next_block(void) {
+    int next = (head + 1) % CAPTURE_BLOCKS;
+    if (next == tail) return false;
+    head = next;
+    fill = 0;
+    sched_post(EVT_CAPTURE_WRITE);
+    return true;
+}
+
+void capture_push(const uint32_t *words, int count) {
+    if (!out) return;
+
+    for (int i = 0; i < count; i++) {
+        if (fill == CAPTURE_BLOCK_SAMPLES && !next_block()) {
+            //Writer is a whole ring behind, drop the rest of these words
+            dropped += count - i;
+            health.capture_dropped += count - i;
+            return;
+        }
+        uint32_t w = words[i];
+        blocks[head][fill++] = (uint16_t)((ADC_CHANNEL(w) << 12) | ADC_RESULT(w));
+        if (fill == CAPTURE_BLOCK_SAMPLES) next_block();
+    }
+}
+
+void capture_write_handler(void) {
+    while (tail != head) {
+        written += fwrite(blocks[tail], sizeof(uint16_t), CAPTURE_BLOCK_SAMPLES, out);
+        tail = (tail + 1) % CAPTURE_BLOCKS;
+    }
+}
+
+void capture_stop(void) {
+    if (!out) return;
+    capture_write_handler();
+    written += fwrite(blocks[head], sizeof(uint16_t), fill, out);
+    fill = 0;
+    fclose(out);
+    out = 0;
+}
+
+uint32_t capture_samples_written(void) {
+    return written;
+}
+
+uint32_t capture_samples_dropped(void) {
+    return dropped;
+}
+
+bool capture_open(CaptureReader *reader, const char *path) {
+    reader->fp = fopen(path, "rb");
+    if (!reader->fp) return false;
+
+    if (fread(&reader->header, sizeof(CaptureHeader), 1, reader->fp) != 1
+        || memcmp(reader->header.magic, CAPTURE_MAGIC, 4) != 0
+        || reader->header.header_size < sizeof(CaptureHeader)) {
+        fclose(reader->fp);
+        reader->fp = 0;
+        return false;
+    }
+
+    //Newer versions may grow the header, skip what we do not understand
+    fseek(reader->fp, reader->header.header_size, SEEK_SET);
+    reader->block_fill = 0;
+    reader->block_pos = 0;
+    return true;
+}
+
+int capture_read(CaptureReader *reader, uint16_t *samples, int count) {
+    int n = 0;
+    while (n < count) {
+        if (reader->block_pos == reader->block_fill) {
+            reader->block_fill = fread(reader->block, sizeof(uint16_t), CAPTURE_BLOCK_SAMPLES, reader->fp);
+            reader->block_pos = 0;
+            if (reader->block_fill == 0) break;
+        }
+        int take = reader->block_fill - reader->block_pos;
+        if (take > count - n) take = count - n;
+        memcpy(samples + n, reader->block + reader->block_pos, take * sizeof(uint16_t));
+        reader->block_pos += take;
+        n += take;
+    }
+    return n;
+}
+
+void capture_close(CaptureReader *reader) {
+    if (reader->fp) fclose(reader->fp);
+    reader->fp = 0;
+}
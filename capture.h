@@ -0,0 +1,86 @@
+/*
+ * Binary Capture Files
+ * Objective: Get raw ADC data off the board fast enough to record whole performances
+ *
+ * A capture file is a fixed header followed by raw 16 bit samples, little endian:
+ *
+ *   CaptureHeader (32 bytes)
+ *   uint16_t sample[...]      (channel << 12) | 12 bit ADC code, channels interleaved
+ *
+ * The recorder never touches the file from the DMA path. Samples are packed into
+ * CAPTURE_BLOCK_SAMPLES sized blocks in RAM and a block is only written with one
+ * fwrite, from the EVT_CAPTURE_WRITE handler, once it is full.
+ * If the file system falls behind the newest samples are dropped and counted;
+ * the file stays consistent, it just has a gap.
+ *
+ * The reader works the same on the board and on the PC, so the host simulator can
+ * replay any field recording through new pitch algorithms.
+ *
+ * LocalFileSystem only knows 8.3 names, e.g. "/local/CAP001.THC"
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define CAPTURE_MAGIC   "THRC"
+#define CAPTURE_VERSION 1
+
+#define CAPTURE_BLOCK_SAMPLES 1024  //2KB per fwrite
+#define CAPTURE_BLOCKS        4     //Blocks of RAM the recorder can fall behind by
+
+struct CaptureHeader {
+    char     magic[4];          //"THRC"
+    uint16_t version;           //CAPTURE_VERSION
+    uint16_t header_size;       //sizeof(CaptureHeader), samples start here
+    uint32_t sample_rate;       //Per channel, in Hz
+    uint16_t channels;          //Interleaved ADC channels
+    uint16_t bits;              //Bits per conversion, 12 on the LPC1768
+    uint32_t adcr;              //LPC_ADC->ADCR when the capture started
+    uint32_t timestamp;         //RTC seconds since 1970 when the capture started
+    uint32_t reserved[2];
+};
+
+/*
+ * Recording
+ */
+
+//Opens the file and writes the header, returns false if the file could not be created
+bool capture_start(const char *path, uint32_t sample_rate, int channels, uint32_t adcr);
+
+//Packs a block of ADC result words into the RAM blocks, posts EVT_CAPTURE_WRITE when one fills
+void capture_push(const uint32_t *words, int count);
+
+//EVT_CAPTURE_WRITE handler, writes out every full block
+void capture_write_handler(void);
+
+//Writes whatever is left, including a partial block, and closes the file
+void capture_stop(void);
+
+//Samples recorded and dropped since capture_start()
+uint32_t capture_samples_written(void);
+uint32_t capture_samples_dropped(void);
+
+/*
+ * Playback
+ */
+
+struct CaptureReader {
+    FILE         *fp;
+    CaptureHeader header;
+    uint16_t      block[CAPTURE_BLOCK_SAMPLES];
+    int           block_fill;   //Samples in block[]
+    int           block_pos;    //Next sample to hand out
+};
+
+//Opens a capture and checks its header, returns false if it is not a capture file
+bool capture_open(CaptureReader *reader, const char *path);
+
+//Reads up to count samples, returns how many were read (0 at the end of the file)
+int capture_read(CaptureReader *reader, uint16_t *samples, int count);
+
+void capture_close(CaptureReader *reader);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Capture Replay
+ * Objective: Rerun a field recording through the analysis code on the PC and time it
+ *
+ * Host only. Build with the host simulator, e.g.
+ *   g++ -O2 -o capture_replay capture_replay.cpp capture.cpp host_sim.cpp scheduler.cpp pitch.cpp fft_r4.cpp profile.cpp health.cpp
+ *
+ * Usage: capture_replay CAP001.THC [block_length]
+ *
+ * The capture is fed through the simulated ADC/DMA, one DMA block at a time, and every
+ * block goes through the same event handler path the firmware uses.
+ * Prints one line per block (time, estimate, cycles taken) and a summary at the end,
+ * with the cycle profile (profile.h) of the stages the firmware profiles too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adc_defs.h"
+#include "capture.h"
+#include "cycle_counter.h"
+#include "host_sim.h"
+#include "pitch.h"
+#include "profile.h"
+#include "scheduler.h"
+
+#define DEFAULT_BLOCK_LENGTH 1000
+#define MAX_BLOCK_LENGTH     16384
+
+static CaptureSource source;
+static uint32_t adcInputBuffer[MAX_BLOCK_LENGTH];
+static uint16_t samples[MAX_BLOCK_LENGTH];
+static int block_length = DEFAULT_BLOCK_LENGTH;
+static uint32_t sample_rate;
+
+static uint32_t blocks = 0;
+static uint64_t total_cycles = 0;
+static uint32_t max_cycles = 0;
+static uint32_t block_landed;
+
+void TC0_callback(void) {
+    block_landed = cycle_count();
+    sched_post(EVT_ADC_BLOCK);
+}
+
+void adc_block_handler(void) {
+    PROFILE_ADD(PROF_CAPTURE_WAIT, cycle_count() - block_landed);
+
+    //Channel 0 only, the same thing the firmware looks at
+    PROFILE_START(t_unpack);
+    int n = 0;
+    for (int i = 0; i < block_length; i++) {
+        if (ADC_CHANNEL(adcInputBuffer[i]) == 0) samples[n++] = ADC_RESULT(adcInputBuffer[i]);
+    }
+    PROFILE_STOP(PROF_UNPACK, t_unpack);
+
+    uint32_t start = cycle_count();
+    uint32_t freq = pitch_peak_interval(samples, n, sample_rate);
+    uint32_t took = cycle_count() - start;
+    PROFILE_ADD(PROF_PITCH, took);
+
+    total_cycles += took;
+    if (took > max_cycles) max_cycles = took;
+
+    printf("%8.4f s  %9.2f Hz  %7u cycles\n",
+        (double)sim_cycles() / CCLK_HZ, freq / 256.0, took);
+    blocks++;
+
+    //Re-arm for the next block, like the TC callback would on the board
+    sim_adc_start(adcInputBuffer, block_length, &TC0_callback);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s CAPTURE.THC [block_length]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2) block_length = atoi(argv[2]);
+    if (block_length <= 0 || block_length > MAX_BLOCK_LENGTH) {
+        fprintf(stderr, "block_length must be 1..%d\n", MAX_BLOCK_LENGTH);
+        return 1;
+    }
+
+    if (!source.open(argv[1])) {
+        fprintf(stderr, "%s is not a capture file\n", argv[1]);
+        return 1;
+    }
+    const CaptureHeader &h = source.header();
+    sample_rate = h.sample_rate;
+    printf("# %s: %u Hz, %u channel(s), %u bits, ADCR 0x%08x, recorded %u\n",
+        argv[1], h.sample_rate, h.channels, h.bits, h.adcr, h.timestamp);
+
+    //The DMA sees every channel's conversions, so it runs channels times faster
+    sim_reset();
+    sim_adc_attach(&source, h.sample_rate * (h.channels ? h.channels : 1));
+
+    sched_init();
+    sched_set_sleep_hook(&sim_sleep);
+    sched_attach(EVT_ADC_BLOCK, &adc_block_handler);
+
+    sim_adc_start(adcInputBuffer, block_length, &TC0_callback);
+    while (!sim_finished()) sched_step();
+
+    double seconds = (double)sim_cycles() / CCLK_HZ;
+    printf("# %u blocks, %.2f s of signal\n", blocks, seconds);
+    if (blocks) {
+        printf("# analysis: mean %llu cycles/block, max %u cycles/block, %.3f%% of real time (host clock scaled to 96MHz)\n",
+            (unsigned long long)(total_cycles / blocks), max_cycles,
+            seconds > 0 ? 100.0 * total_cycles / CCLK_HZ / seconds : 0.0);
+    }
+    profile_dump(stdout);
+    return 0;
+}
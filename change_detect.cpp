@@ -0,0 +1,60 @@
+/*
+ * Change Detector
+ * See change_detect.h
+ */
+
+#include "change_detect.h"
+
+void change_detect_init(ChangeDetect *d, uint16_t level_tol, uint16_t spacing_tol, uint32_t level_floor,
+                        int refresh, int settle) {
+    d->level = 0;
+    d->spacing_q8 = 0;
+    d->level_tol = level_tol;
+    d->spacing_tol = spacing_tol;
+    d->level_floor = level_floor;
+    d->refresh = refresh;
+    d->settle = settle < 1 ? 1 : settle;    //The changed block itself is always analysed
+    d->skipped_run = 0;
+    d->settling = 0;
+    d->stale = true;
+    d->blocks = 0;
+    d->skipped = 0;
+}
+
+void change_detect_reset(ChangeDetect *d) {
+    d->stale = true;
+}
+
+//True if v is further than slack plus tol (Q15) of ref from ref
+static inline bool moved(uint32_t v, uint32_t ref, uint16_t tol, uint32_t slack) {
+    uint32_t diff = v > ref ? v - ref : ref - v;
+    return diff > slack + (uint32_t)(((uint64_t)ref * tol) >> 15);
+}
+
+bool change_detect_block(ChangeDetect *d, uint32_t level, uint32_t spacing_q8) {
+    d->blocks++;
+    bool changed = d->stale
+        || moved(level, d->level, d->level_tol, d->level_floor)
+        || moved(spacing_q8, d->spacing_q8, d->spacing_tol, 64);
+    if (changed) d->settling = d->settle;
+    if (d->settling == 0 && d->skipped_run < d->refresh) {
+        d->skipped_run++;
+        d->skipped++;
+        return false;
+    }
+    if (d->settling) d->settling--;
+    d->level = level;
+    d->spacing_q8 = spacing_q8;
+    d->skipped_run = 0;
+    d->stale = false;
+    return true;
+}
+
+uint32_t change_skip_permille(ChangeDetect *d, bool reset) {
+    uint32_t permille = d->blocks ? (uint32_t)((uint64_t)d->skipped * 1000 / d->blocks) : 0;
+    if (reset) {
+        d->blocks = 0;
+        d->skipped = 0;
+    }
+    return permille;
+}
@@ -0,0 +1,56 @@
+/*
+ * Change Detector
+ * Objective: Skip the FFT while the player holds a steady note
+ *
+ * Every block is fingerprinted by the front end for free: its RMS level and the
+ * mean spacing of its zero crossings (frontend.h). The fingerprint of the last
+ * block that was analysed is kept, and a new block only needs analysing when
+ *   - its level moved by more than level_tol (relative, Q15) of the kept one
+ *   - its crossing spacing moved by more than spacing_tol (relative, Q15) plus
+ *     a quarter sample, or it gained or lost its crossings
+ *   - refresh blocks in a row have been skipped
+ *   - change_detect_reset() was called, e.g. after a frame size change
+ * Otherwise the caller reuses the previous pitch. After a change every block is
+ * analysed for settle blocks, so frames that overlap several blocks have wholly
+ * left the old note before skipping starts again (1 when a frame is one block,
+ * and never less: the changed block itself is always analysed).
+ *
+ * Comparing against the last analysed block rather than the previous one means
+ * a slow glide still triggers once it has drifted far enough. A rich tone with
+ * extra crossings per period can move its harmonics without moving the spacing
+ * much; refresh bounds how long that goes unnoticed.
+ */
+
+#ifndef CHANGE_DETECT_H
+#define CHANGE_DETECT_H
+
+#include <stdint.h>
+
+struct ChangeDetect {
+    uint32_t level;         //Fingerprint of the last analysed block
+    uint32_t spacing_q8;
+    uint16_t level_tol;     //Q15
+    uint16_t spacing_tol;   //Q15
+    uint32_t level_floor;   //Level moves under this (Q15 RMS) never count, the noise floor
+    int      refresh;       //Most blocks skipped in a row
+    int      settle;        //Blocks analysed after a change
+    int      skipped_run;
+    int      settling;
+    bool     stale;         //Next block is analysed whatever it looks like
+    uint32_t blocks;        //Since the last change_skip_permille(..., true)
+    uint32_t skipped;
+};
+
+void change_detect_init(ChangeDetect *d, uint16_t level_tol, uint16_t spacing_tol, uint32_t level_floor,
+                        int refresh, int settle);
+
+//Forces the next block to be analysed
+void change_detect_reset(ChangeDetect *d);
+
+//True if the block needs a full analysis, its fingerprint is then kept as the new reference
+bool change_detect_block(ChangeDetect *d, uint32_t level, uint32_t spacing_q8);
+
+//Skipped blocks in 1/10 of a percent, reset starts a new window
+uint32_t change_skip_permille(ChangeDetect *d, bool reset);
+
+#endif
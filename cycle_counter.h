@@ -0,0 +1,56 @@
+/*
+ * Cycle Counter
+ * Objective: Cheap timestamps in CPU clock cycles for load and latency measurements
+ *
+ * On the mbed this is the Cortex-M3 DWT cycle counter (CYCCNT), which ticks once per CCLK
+ * and wraps every ~44 seconds at 96MHz. Always subtract two readings as uint32_t so the
+ * wrap takes care of itself.
+ *
+ * On the host there is no DWT, so the monotonic clock is scaled to 96MHz "cycles".
+ * This keeps every report in the same units whether it came off the board or the PC.
+ */
+
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <stdint.h>
+
+#define CCLK_HZ 96000000UL      //Core clock of the LPC1768 on the mbed
+
+#ifdef TARGET_LPC1768
+
+/*
+ * The DWT registers are not in every version of core_cm3.h, so they are poked directly
+ * DEMCR bit 24 (TRCENA) powers the trace block, DWT_CTRL bit 0 (CYCCNTENA) starts the counter
+ */
+#define DEMCR_REG      (*(volatile uint32_t *)0xE000EDFC)
+#define DWT_CTRL_REG   (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT_REG (*(volatile uint32_t *)0xE0001004)
+
+static inline void cycle_counter_init(void) {
+    DEMCR_REG     |= (1UL << 24);
+    DWT_CYCCNT_REG = 0;
+    DWT_CTRL_REG  |= (1UL << 0);
+}
+
+static inline uint32_t cycle_count(void) {
+    return DWT_CYCCNT_REG;
+}
+
+#else
+
+#include <time.h>
+
+static inline void cycle_counter_init(void) {
+}
+
+static inline uint32_t cycle_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return (uint32_t)(ns * (CCLK_HZ / 1000000UL) / 1000ULL);
+}
+
+#endif
+
+#endif
@@ -35,26 +35,110 @@ For instance to do the lowest key on the Piano(27Hz) we have to cycle the wavefo
         
         Need to set up DMA as in the ADC section.....
         
+    Update: the DAC now runs at a fixed SYNTH_RATE and the pitch comes from the DDS in
+    the block synthesis engine (synth.h). The two ping-pong buffers are no longer static
+    copies of the wave table: each time one finishes playing, EVT_DAC_REFILL renders the
+    next SYNTH_BLOCK samples into it while the other one plays.
+    
+    With OUTPUT_ADDITIVE set the blocks come from the IFFT additive resynthesis
+    (additive.h) instead of a DDS voice: the same sweep, played as an organ.
+    
+    Send 'p' to print the cycle profile (profile.h) after the next report, 'l' to
+    write it to /local/PROFILE.TXT instead. Either way the counters start over.
+    
+    The sweep no longer retunes the voice itself. It publishes pitch, gain and
+    waveform to a parameter block (params.h), and the renderer takes a consistent
+    set from it at the start of every block and glides there over GLIDE_MS.
+    Send 'w' to switch between the sine and the organ waveform.
+    
+    Each report also prints the health counters (health.h): late re-arms (a TC
+    interrupt ran after the other buffer should have started, the DAC held a
+    sample), repeated buffers and the worst interrupt latency.
+    
+    The ping-pong buffers sit in the AHB1 SRAM bank (sram.h), so the DMA streaming
+    out of them never waits on the renderer working in local SRAM. The placement is
+    printed once at boot.
+    
+    The output stage oversamples DAC_OVERSAMPLE times with TPDF dither and second
+    order noise shaping (noise_shape.h), so quiet notes keep more than the DAC's
+    10 bits in the audio band. The DAC updates at SYNTH_RATE * DAC_OVERSAMPLE and
+    each buffer is SYNTH_BLOCK * DAC_OVERSAMPLE words.
+        
 */
 
-#define OUTPUT_BUFFER_LENGTH 360 
 #include "mbed.h"
 #include "MODDMA.h"
+#include "additive.h"
+#include "cycle_counter.h"
+#include "dds.h"
+#include "health.h"
+#include "params.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "sram.h"
+#include "synth.h"
+#include "wave_table.h"
+
+#define SYNTH_RATE 48000    //Fixed sample rate, the DAC updates DAC_OVERSAMPLE times as often
+#define SYNTH_BLOCK 256     //Samples per buffer, 5.3ms at 48kHz, output latency is 2 blocks
+#define TABLE_BITS 8        //256 entry sine, as clean as the 10 bit DAC with linear interpolation
+#define OUTPUT_ADDITIVE 0   //1 plays ADDITIVE_PRESET through one ifftR4 per ADDITIVE_FRAME/2 samples
+#define ADDITIVE_FRAME 256
+#define ADDITIVE_PRESET ADDITIVE_ORGAN
+#define GLIDE_MS 20         //Pitch slide time constant, smooths the 1ms sweep steps
+#define DAC_OVERSAMPLE 4    //DACCNTVAL = 24MHz/192kHz = 125, 1 for the plain 10 bit output
+#define NOISE_SHAPE_ORDER 2
+#define DAC_DITHER 1
+
+//With the BIAS bit set in DACR the DAC settles in 2.5us, 400kHz at most
+#if SYNTH_RATE * DAC_OVERSAMPLE > 400000
+#error "SYNTH_RATE * DAC_OVERSAMPLE is over the DAC's 400kHz"
+#endif
 
 AnalogOut output(p18);       
 
-DigitalOut led1(LED1);
+DigitalOut led1(LED1);      //Lit once rendering has missed a deadline
+
+Serial pc(USBTX, USBRX);
+LocalFileSystem local("local");   //For the profile dump
 
 MODDMA dac_dma; //Creating DMA Object for DAC Output
 MODDMA_Config *conf0, *conf1;
 
+Ticker sweep_ticker;    //Posts EVT_CONTROL every ms
+Ticker report_ticker;   //Posts EVT_REPORT once a second
+
+volatile char profile_request = 0;  //'p' or 'l' from the serial port, taken by the next report
+volatile bool waveform_toggle = false;  //'w' from the serial port, taken by the next sweep step
+
 void TC0_callback(void);
 void ERR0_callback(void);
 void TC1_callback(void);
 void ERR1_callback(void);
 
-int wave_table[2][OUTPUT_BUFFER_LENGTH];
+void rx_isr(void);
+void refill_handler(void);
+void sweep_handler(void);
+void report_handler(void);
+void sweep_tick(void);
+void report_tick(void);
+void additive_source(int32_t *mix, int count);
+
+int16_t sine_table[DDS_TABLE_LENGTH(TABLE_BITS)];
+int16_t organ_table[DDS_TABLE_LENGTH(TABLE_BITS)];
+const int16_t organ_gains[] = { 32767, 16384, 10923, 8192, 4096 };  //Harmonics 1..5
+Synth synth;
+SynthBuffers dac_buffers SRAM_IN(AHB1);    //Read by the DMA while the other one renders
+SRAM_LIST(AHB1, dac_buffers);
+int voice;
+ParamsBlock params;     //Written only by sweep_handler, read by the renderer
+ControlParams control;  //The writer's working copy
+#if OUTPUT_ADDITIVE
+Additive additive;   //6.5KB, only built in when used
+#endif
+
 int NoteVal = 152;
+int NoteStep = 1;
 /* 
  * Determining the value for DACCNTVAL
  * PCLK is set to Oscillate at 24Mhz, can be reduced at intervals but not necessary since our lowest note works np
@@ -62,6 +146,7 @@ int NoteVal = 152;
  * DACCNTVAL = 24Mhz/(f * WaveTableSize)
  * These Count values are going to be stored in the NoteBuffer[] Array as defined below
  * See Piano Key Frequencies.pdf in GitHub Repo for a full list
+ * NoteVal is still swept in these units, note_freq() turns it into the frequency it used to play
  */
 
 uint16_t NoteBuffer[] = 
@@ -78,48 +163,55 @@ uint16_t NoteBuffer[] =
     213        //A4
 };
 
+//Frequency in Hz * 256 that DACCNTVAL = count played through the 360 entry wave_table
+uint32_t note_freq(int count) {
+    return (uint32_t)((uint64_t)DAC_PCLK_HZ * 256 / ((uint64_t)count * WAVE_TABLE_LENGTH));
+}
 
 int main() {
-/*
- * Generation of a Sine Wave of 360 Points
- */
-    for (int i =   0; i <=  90; i++) wave_table[0][i] =  (512 * sin(3.14159/180.0 * i)) + 512;                
-    for (int i =  91; i <= 180; i++) wave_table[0][i] =  wave_table[0][180 - i];
-    for (int i = 181; i <= 270; i++) wave_table[0][i] =  512 - (wave_table[0][i - 180] - 512);
-    for (int i = 271; i <  360; i++) wave_table[0][i] =  512 - (wave_table[0][360 - i] - 512);
-    
-    
-/*
- * First Thing to do is modify wave table to work with DAC Hardware. 
- * Since I am double buffering with DMA then I need to duplicate the wavetable. 
- * As specified in LPC17xx user manual(p583), the DACR Register controls the Voltage Output. In our wavetable we only have naive voltage values.
- * Bit 16 of the DACR is the Power Bit, because we are operating well below the update speed we can set this to 1 for Power Mode
- * Bits 15:6 of the DACR is the VALUE field which contains the voltage output.
- * Bits 5:0 of the DACR are reserved, and should not contain any value
- * 
- * Because of the above situation we have to condition our values to accomodate the hardware
- * 
- * wave_table[i] = (1 << 16) | (wavetable[i] << 6) & 0xFFC0
- * 
- * (1<<16) sets the DAC in Power Mode which Gives a settling time of 2.5us and max current of 350uA and a max update rate of 400kHz
- * (wavetable[i] << 6) & 0xFFCO shifts the array data into the VALUE field 
- * 
- */
-    for(int i = 0; i < OUTPUT_BUFFER_LENGTH; i++){
-        wave_table[0][i] = (1 << 16) | (wave_table[0][i] << 6) & 0xFFC0;
-        wave_table[1][i] = wave_table[0][i];
-    }
+    pc.baud(115200);
+    cycle_counter_init();   //Render times, profile and health all count cycles
+    pc.attach(&rx_isr, Serial::RxIrq);
+    sram_report(stdout);
+    if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
+
+    sched_init();
+    sched_attach(EVT_DAC_REFILL, &refill_handler);
+    sched_attach(EVT_CONTROL, &sweep_handler);
+    sched_attach(EVT_REPORT, &report_handler);
 
+    dds_table_init(sine_table, TABLE_BITS);
+    dds_table_partials(organ_table, TABLE_BITS, organ_gains, sizeof(organ_gains) / sizeof(organ_gains[0]));
+    synth_init(&synth, &dac_buffers, sine_table, TABLE_BITS, SYNTH_BLOCK, SYNTH_RATE);
+    synth_set_waveform(&synth, 1, organ_table);
+    if (!synth_set_output(&synth, DAC_OVERSAMPLE, NOISE_SHAPE_ORDER, DAC_DITHER)) error("bad DAC_OVERSAMPLE or NOISE_SHAPE_ORDER");
 
+    control.freq_q8 = note_freq(NoteVal);
+    control.gain = 32767;
+    control.waveform = 0;
+    control.glide_ms = GLIDE_MS;
+    params_init(&params, &control);
+#if OUTPUT_ADDITIVE
+    if (!additive_init(&additive, ADDITIVE_FRAME, SYNTH_RATE, sine_table, TABLE_BITS)) error("bad ADDITIVE_FRAME");
+    additive_set_preset(&additive, ADDITIVE_PRESET);
+    additive_set_note(&additive, note_freq(NoteVal), 32767);
+    synth.source = &additive_source;
+    synth_attach_params(&synth, &params, -1);
+#else
+    voice = mixer_add_voice(&synth.mixer, note_freq(NoteVal), SYNTH_RATE, 32767);
+    synth_attach_params(&synth, &params, voice);
+#endif
 
+    //Both buffers hold real samples before the first DMA request
+    synth_prime(&synth);
 
     // Prepare the GPDMA system for buffer0.
     conf0 = new MODDMA_Config;
     conf0
      ->channelNum    ( MODDMA::Channel_0 )
-     ->srcMemAddr    ( (uint32_t) &wave_table[0] )
+     ->srcMemAddr    ( (uint32_t) synth.buffer[0] )
      ->dstMemAddr    ( MODDMA::DAC )
-     ->transferSize  ( OUTPUT_BUFFER_LENGTH )
+     ->transferSize  ( synth.words )
      ->transferType  ( MODDMA::m2p )
      ->dstConn       ( MODDMA::DAC )
      ->attach_tc     ( &TC0_callback )
@@ -131,9 +223,9 @@ int main() {
     conf1 = new MODDMA_Config;
     conf1
      ->channelNum    ( MODDMA::Channel_1 )
-     ->srcMemAddr    ( (uint32_t) &wave_table[1])
+     ->srcMemAddr    ( (uint32_t) synth.buffer[1] )
      ->dstMemAddr    ( MODDMA::DAC )
-     ->transferSize  ( OUTPUT_BUFFER_LENGTH )
+     ->transferSize  ( synth.words )
      ->transferType  ( MODDMA::m2p )
      ->dstConn       ( MODDMA::DAC )
      ->attach_tc     ( &TC1_callback )
@@ -145,32 +237,94 @@ int main() {
         if(!dac_dma.Prepare(conf0)){
             error("Conf0 could not be prepared, check configuration settings");
         }
-           LPC_DAC->DACCNTVAL = NoteVal;
+           LPC_DAC->DACCNTVAL = DAC_PCLK_HZ / (SYNTH_RATE * DAC_OVERSAMPLE);
 
                 
         //Begin DMA Transfers and Counter
         LPC_DAC->DACCTRL |= (3UL << 2);
-        
 
-    while(1) {
-		if(NoteVal < 1200){
-			wait_ms(1);
-			NoteVal++;
-			 LPC_DAC->DACCNTVAL = NoteVal;
-		}
-        if(NoteVal >= 1200){
-            for(int i = 1200;i>152;i--){
-                 wait_ms(1);
-                NoteVal--;
-                 LPC_DAC->DACCNTVAL = NoteVal;
-            }
-           
+    sweep_ticker.attach_us(&sweep_tick, 1000);
+    report_ticker.attach(&report_tick, 1.0);
+
+    //Everything from here on is driven by events, the core sleeps in between
+    sched_run();
+}
+
+void refill_handler(void) {
+    synth_refill(&synth);
+}
+
+//Same sweep as before, NoteVal 152 up to 1200 and back one step a ms, now published for the renderer
+void sweep_handler(void) {
+    NoteVal += NoteStep;
+    if (NoteVal >= 1200) NoteStep = -1;
+    if (NoteVal <= 152) NoteStep = 1;
+    control.freq_q8 = note_freq(NoteVal);
+    if (waveform_toggle) {
+        waveform_toggle = false;
+        control.waveform ^= 1;
+    }
+    params_publish(&params, &control);
+}
+
+#if OUTPUT_ADDITIVE
+//Follows the glide, waveform 0 is the configured preset and 1 the organ
+void additive_source(int32_t *mix, int count) {
+    static int preset = ADDITIVE_PRESET;
+    int want = synth.control.waveform ? ADDITIVE_ORGAN : ADDITIVE_PRESET;
+    if (want != preset) {
+        preset = want;
+        additive_set_preset(&additive, preset);
+    }
+    additive_set_note(&additive, synth.freq_q8, 32767);
+    additive_render(&additive, mix, count);
+}
+#endif
+
+void report_handler(void) {
+    SynthStats st;
+    synth_stats(&synth, &st, true);
+    uint32_t idle = sched_idle_permille(true);
+    if (st.underruns) led1 = 1;
+    pc.printf("block %d (%uus latency): %u rendered, %u underruns, render max %u of %u cycles, CPU idle %u.%u%%\n",
+        SYNTH_BLOCK, synth_latency_us(&synth), st.blocks, st.underruns, st.max_render_cycles, st.period_cycles,
+        idle / 10, idle % 10);
+    pc.printf("params: %u reads, %u fell back to the last set\n", synth.reader.reads, synth.reader.fallbacks);
+    health_dump(stdout);
+    health_reset_peaks();
+
+    char request = profile_request;
+    profile_request = 0;
+    if (request == 'p') {
+        profile_dump(stdout);
+    } else if (request == 'l') {
+        FILE *fp = fopen("/local/PROFILE.TXT", "w");
+        if (fp) {
+            profile_dump(fp);
+            fclose(fp);
         }
-       
-       }
+    }
+    if (request) profile_reset();
+}
+
+void rx_isr(void) {
+    while (pc.readable()) {
+        int c = pc.getc();
+        if (c == 'p' || c == 'l') profile_request = (char)c;
+        if (c == 'w') waveform_toggle = true;
+    }
+}
+
+void sweep_tick(void) {
+    sched_post(EVT_CONTROL);
+}
+
+void report_tick(void) {
+    sched_post(EVT_REPORT);
 }
 
 void TC0_callback(void){
+    health_dac_tc(cycle_count(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
 
     //Get Configuration Pointer and Shut Down DMA Channel
     MODDMA_Config *config = dac_dma.getConfig();
@@ -178,17 +332,25 @@ void TC0_callback(void){
     
     //Swaps to Buffer 1
     dac_dma.Prepare(conf1);
+
+    //Buffer 0 is free, render the next block into it
+    synth_buffer_done(&synth, 0);
     
     //Resets IRQ Flags
     if (dac_dma.irqType() == MODDMA::TcIrq) dac_dma.clearTcIrq(); 
 }
 void TC1_callback(void){
+    health_dac_tc(cycle_count(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
+
     //Get Configuration Pointer and Shut Down DMA Channel
     MODDMA_Config *config = dac_dma.getConfig();
     dac_dma.Disable( (MODDMA::CHANNELS)config->channelNum());
     
-    //Swaps to Buffer 1
+    //Swaps to Buffer 0
     dac_dma.Prepare(conf0);
+
+    //Buffer 1 is free, render the next block into it
+    synth_buffer_done(&synth, 1);
     
     //Resets IRQ Flags
     if (dac_dma.irqType() == MODDMA::TcIrq) dac_dma.clearTcIrq();
@@ -0,0 +1,359 @@
+/*
+ * DAC Renderer
+ * Objective: Judge the output chain by numbers instead of by ear
+ *
+ * Host only. Runs the dac_dma.cpp output path (360 entry wave_table, DACR
+ * encoding, DACCNTVAL timing, ping-pong between two DMA buffers) on the
+ * simulated DAC, logs every DACR word as it reaches AOUT, rebuilds the
+ * zero order hold output and resamples it into a WAV file.
+ *
+ * With -s it runs the block synthesis engine instead (synth.h): the DAC updates
+ * at a fixed rate, the note comes from the DDS, and each finished buffer is
+ * refilled from EVT_DAC_REFILL through the scheduler, as on the mbed.
+ * -x makes every refill take that many simulated cycles, to find where
+ * rendering starts to miss the deadline, -j makes every DMA interrupt up to that
+ * many cycles late (host_sim.h stress mode). -a feeds the engine from the IFFT
+ * additive resynthesis (additive.h) instead of a DDS voice. -u, -q and -p turn on
+ * the oversampled, noise shaped output stage (noise_shape.h), -v plays the note
+ * quieter so the stage has something to do.
+ *
+ * Build:
+ *   g++ -O2 -o dac_render dac_render.cpp host_sim.cpp capture.cpp scheduler.cpp wave_table.cpp wav.cpp audio_metrics.cpp synth.cpp mixer.cpp noise_shape.cpp dds.cpp additive.cpp fft_plan.cpp fft_r4.cpp profile.cpp params.cpp health.cpp
+ *
+ * Usage: dac_render [options]
+ *   -f 440        requested note in Hz                        (default 440)
+ *   -c 152        DACCNTVAL, overrides the one worked out from -f
+ *   -t 1          seconds to render                           (default 1)
+ *   -r 48000      WAV sample rate                             (default 48000)
+ *   -l 0          DMA interrupt latency in CCLK cycles        (default 0)
+ *   -o out.wav    output file                                 (default dac_render.wav)
+ *   -s 256        synth engine with this block size
+ *   -d 48000      synth engine DAC update rate                (default 48000)
+ *   -x 0          synth engine render cost in CCLK cycles per block
+ *   -j 0          random extra DMA interrupt latency, up to this many CCLK cycles
+ *   -a organ      additive resynthesis: sine, organ or vocal    (implies -s 256)
+ *   -n 256        additive frame size                         (default 256)
+ *   -u 1          synth engine DAC words per sample: 1, 2, 4 or 8 (default 1)
+ *   -q 0          noise shaping order, 0 to 2                 (default 0)
+ *   -p 0          1 for TPDF dither                           (default 0)
+ *   -v 0          note level in dBFS                          (default 0)
+ *
+ * Reports:
+ *   pitch        measured output against the requested note, and how much of the
+ *                error is DACCNTVAL rounding alone (not measured with -q or -p, the
+ *                added noise makes crossings of its own, nor with -a organ or vocal,
+ *                whose harmonics do)
+ *   THD+N        everything but the fundamental, DC to half the WAV rate, fitted at
+ *                the measured pitch, or the requested one when it is not measured
+ *   buffer swaps held updates (no word ready when the counter timed out), the
+ *                longest hold, and the biggest step into a new buffer next to the
+ *                biggest step inside one
+ *   synth        blocks rendered and underruns, with -s
+ *   health       late re-arms, repeated buffers and the worst interrupt (health.h), with -s
+ *   output       THD+N below 20kHz on the DAC output at its own update rate, and
+ *                the output stage's cycles per DAC word (host clock), with -s
+ *   additive     frames and the longest render, with -a (for sine, THD+N is the
+ *                resynthesis error; for the others it includes the harmonics)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "additive.h"
+#include "audio_metrics.h"
+#include "cycle_counter.h"
+#include "host_sim.h"
+#include "noise_shape.h"
+#include "profile.h"
+#include "dds.h"
+#include "health.h"
+#include "pitch.h"
+#include "scheduler.h"
+#include "synth.h"
+#include "wav.h"
+#include "wave_table.h"
+
+#define SYNTH_TABLE_BITS 8
+#define AUDIO_BAND 20000
+
+static int wave_table[2][WAVE_TABLE_LENGTH];
+
+static void TC0_callback(void);
+static void TC1_callback(void);
+
+//Same handoff as dac_dma.cpp, each buffer prepares the other when it completes
+static void TC0_callback(void) {
+    sim_dac_start((const uint32_t *)wave_table[1], WAVE_TABLE_LENGTH, &TC1_callback);
+}
+
+static void TC1_callback(void) {
+    sim_dac_start((const uint32_t *)wave_table[0], WAVE_TABLE_LENGTH, &TC0_callback);
+}
+
+static int16_t sine_table[DDS_TABLE_LENGTH(SYNTH_TABLE_BITS)];
+static Synth synth;
+static SynthBuffers synth_buffers;
+static uint32_t render_cost = 0;
+static Additive additive;
+
+static void additive_source(int32_t *mix, int count) {
+    additive_render(&additive, mix, count);
+}
+
+static void synth_TC0(void);
+static void synth_TC1(void);
+
+//dac_dma.cpp with the synth engine: start the other buffer, then hand this one back
+static void synth_TC0(void) {
+    health_dac_tc((uint32_t)sim_cycles(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
+    sim_dac_start(synth.buffer[1], synth.words, &synth_TC1);
+    synth_buffer_done(&synth, 0);
+}
+
+static void synth_TC1(void) {
+    health_dac_tc((uint32_t)sim_cycles(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
+    sim_dac_start(synth.buffer[0], synth.words, &synth_TC0);
+    synth_buffer_done(&synth, 1);
+}
+
+//The render cost passes before the buffer counts as refilled
+static void refill_handler(void) {
+    if (render_cost) sim_spend(render_cost);
+    synth_refill(&synth);
+}
+
+/*
+ * Resamples the zero order hold into rate samples per second
+ * Each output sample is the average of the DAC level over its interval,
+ * a box filter that keeps most of the update rate images out of the WAV.
+ */
+static std::vector<double> reconstruct(const std::vector<DacUpdate> &updates, size_t start, uint64_t end, uint32_t rate) {
+    std::vector<double> out;
+    double step = (double)CCLK_HZ / rate;
+    double t0 = (double)updates[start].cycle;
+    size_t u = start;
+
+    for (size_t k = 0; t0 + (k + 1) * step <= end; k++) {
+        double a = t0 + k * step, b = a + step;
+        double area = 0;
+        while (u + 1 < updates.size() && updates[u + 1].cycle <= a) u++;
+        double t = a;
+        size_t v = u;
+        while (t < b) {
+            double next = v + 1 < updates.size() ? (double)updates[v + 1].cycle : b;
+            if (next > b) next = b;
+            area += (updates[v].value - 512) / 512.0 * (next - t);
+            t = next;
+            v++;
+        }
+        out.push_back(area / step);
+    }
+    return out;
+}
+
+//Output stage alone over the last block rendered, cycles per DAC word
+static double output_cycles(const Synth *s) {
+    static uint32_t words[SYNTH_MAX_WORDS];
+    NoiseShaper ns = s->shaper;
+    const int runs = 2000;
+    uint32_t start = cycle_count();
+    for (int r = 0; r < runs; r++) noise_shape_render(&ns, s->mixer.mix, words, s->block);
+    return (double)(uint32_t)(cycle_count() - start) / ((double)runs * s->words);
+}
+
+int main(int argc, char **argv) {
+    double note = 440;
+    uint32_t count = 0;
+    double seconds = 1;
+    uint32_t rate = 48000;
+    uint32_t latency = 0;
+    const char *path = "dac_render.wav";
+    int block = 0;
+    uint32_t synth_rate = 48000;
+    int preset = -1;
+    int frame = 256;
+    uint32_t jitter = 0;
+    int oversample = 1, order = 0, dither = 0;
+    double level_db = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        switch (argv[i][1]) {
+        case 'f': note = atof(argv[i + 1]); break;
+        case 'c': count = atoi(argv[i + 1]); break;
+        case 't': seconds = atof(argv[i + 1]); break;
+        case 'r': rate = atoi(argv[i + 1]); break;
+        case 'l': latency = atoi(argv[i + 1]); break;
+        case 'o': path = argv[i + 1]; break;
+        case 's': block = atoi(argv[i + 1]); break;
+        case 'd': synth_rate = atoi(argv[i + 1]); break;
+        case 'x': render_cost = atoi(argv[i + 1]); break;
+        case 'j': jitter = atoi(argv[i + 1]); break;
+        case 'a':
+            preset = !strcmp(argv[i + 1], "organ") ? ADDITIVE_ORGAN : !strcmp(argv[i + 1], "vocal") ? ADDITIVE_VOCAL : ADDITIVE_SINE;
+            break;
+        case 'n': frame = atoi(argv[i + 1]); break;
+        case 'u': oversample = atoi(argv[i + 1]); break;
+        case 'q': order = atoi(argv[i + 1]); break;
+        case 'p': dither = atoi(argv[i + 1]); break;
+        case 'v': level_db = atof(argv[i + 1]); break;
+        default:
+            fprintf(stderr, "usage: %s [-f hz] [-c daccntval] [-t seconds] [-r wav_rate] [-l latency_cycles] [-o file.wav] [-s block] [-d synth_rate] [-x cycles] [-j cycles] [-a preset] [-n frame] [-u oversample] [-q order] [-p dither] [-v dbfs]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (preset >= 0 && !block) block = 256;
+    if (oversample < 1) oversample = 1;
+    if (!count) count = block ? (synth_rate ? DAC_PCLK_HZ / (synth_rate * oversample) : 0) : dac_count_for(PITCH_Q8(note), WAVE_TABLE_LENGTH);
+    int16_t level = (int16_t)(32767 * pow(10, level_db / 20));
+    if (!count || note <= 0 || rate == 0) {
+        fprintf(stderr, "bad note, count or rate\n");
+        return 1;
+    }
+
+    wave_table_init(wave_table[0]);
+    wave_table_encode(wave_table[0], WAVE_TABLE_LENGTH);
+    for (int i = 0; i < WAVE_TABLE_LENGTH; i++) wave_table[1][i] = wave_table[0][i];
+
+    std::vector<DacUpdate> updates;
+    sim_reset();
+    sim_dac_record(&updates);
+    sim_dac_set_irq_latency(latency);
+    sim_set_irq_jitter(jitter, 1);
+    uint64_t end = (uint64_t)(seconds * CCLK_HZ);
+
+    //What the output should be, DACCNTVAL rounding for the table, phase step rounding for the DDS
+    double ideal = (double)DAC_PCLK_HZ / ((double)count * WAVE_TABLE_LENGTH);
+
+    if (block) {
+        //Samples a second, the DAC runs oversample times faster
+        uint32_t dac_rate = DAC_PCLK_HZ / (count * oversample);
+        dds_table_init(sine_table, SYNTH_TABLE_BITS);
+        if (!synth_init(&synth, &synth_buffers, sine_table, SYNTH_TABLE_BITS, block, dac_rate)) {
+            fprintf(stderr, "block must be 4 to %d\n", SYNTH_MAX_BLOCK);
+            return 1;
+        }
+        if (!synth_set_output(&synth, oversample, order, dither != 0)) {
+            fprintf(stderr, "oversample must be 1, 2, 4 or 8 with block * oversample up to %d, order 0 to 2\n", SYNTH_MAX_WORDS);
+            return 1;
+        }
+        if (preset >= 0) {
+            if (!additive_init(&additive, frame, dac_rate, sine_table, SYNTH_TABLE_BITS)) {
+                fprintf(stderr, "frame must be 16, 64 or 256\n");
+                return 1;
+            }
+            additive_set_preset(&additive, preset);
+            additive_set_note(&additive, PITCH_Q8(note), level);
+            synth.source = &additive_source;
+            ideal = additive.bin_q16 * ((double)dac_rate / frame) / 65536.0;
+        } else {
+            mixer_add_voice(&synth.mixer, PITCH_Q8(note), dac_rate, level);
+            ideal = synth.mixer.step[0] * (double)dac_rate / 4294967296.0;
+        }
+        synth_prime(&synth);
+
+        sched_init();
+        sched_attach(EVT_DAC_REFILL, &refill_handler);
+        sched_set_sleep_hook(&sim_sleep);
+        sim_dac_start(synth.buffer[0], synth.words, &synth_TC0);
+        sim_dac_set_count(count);
+        while (sim_cycles() < end && !sim_finished()) sched_step();
+    } else {
+        sim_dac_start((const uint32_t *)wave_table[0], WAVE_TABLE_LENGTH, &TC0_callback);
+        sim_dac_set_count(count);
+        while (sim_cycles() < end && sim_advance()) {}
+    }
+
+    //The first timeout only primes the double buffer, start from the first real word
+    size_t start = 0;
+    while (start < updates.size() && (updates[start].flags & DAC_UPDATE_HOLD)) start++;
+    //The first additive frame fades in under its window, measure the steady tone after it
+    if (preset >= 0) start += frame;
+    if (start >= updates.size()) {
+        fprintf(stderr, "the DAC never updated\n");
+        return 1;
+    }
+
+    //Buffer swap statistics
+    int swaps = 0, held = 0, run = 0, longest = 0;
+    int swap_step = 0, inner_step = 0;
+    for (size_t i = start + 1; i < updates.size(); i++) {
+        const DacUpdate &u = updates[i];
+        int step = abs((int)u.value - (int)updates[i - 1].value);
+        if (u.flags & DAC_UPDATE_HOLD) {
+            held++;
+            if (++run > longest) longest = run;
+            continue;
+        }
+        run = 0;
+        if (u.flags & DAC_UPDATE_FIRST) {
+            swaps++;
+            if (step > swap_step) swap_step = step;
+        } else if (step > inner_step) {
+            inner_step = step;
+        }
+    }
+
+    std::vector<double> out = reconstruct(updates, start, end, rate);
+    if (out.size() < 2) {
+        fprintf(stderr, "render too short\n");
+        return 1;
+    }
+
+    std::vector<int16_t> pcm(out.size());
+    for (size_t i = 0; i < out.size(); i++) {
+        double v = floor(out[i] * 32767 + 0.5);
+        pcm[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+    if (!wav_write(path, rate, &pcm[0], pcm.size())) {
+        fprintf(stderr, "could not write %s\n", path);
+        return 1;
+    }
+
+    //Dither, noise shaping and strong harmonics add crossings of their own, the THD+N fit takes the frequency asked for then
+    bool noisy = block && (dither || order);
+    bool rich = preset > ADDITIVE_SINE;
+    bool unmeasured = noisy || rich;
+    double measured = unmeasured ? 0 : metrics_frequency(&out[0], out.size(), rate);
+    double fund;
+    double thdn = metrics_thd_n(&out[0], out.size(), rate, unmeasured ? ideal : measured, &fund);
+    double update_us = count * 1e6 / DAC_PCLK_HZ;
+
+    printf("%s: %zu samples at %u Hz, %zu DAC updates\n", path, out.size(), rate, updates.size() - start);
+    printf("DACCNTVAL %u, update every %.3f us, %.1f kHz\n", count, update_us, DAC_PCLK_HZ / (count * 1000.0));
+    printf("pitch     requested %.3f Hz, %s gives %.3f Hz (%+.2f cents), ",
+        note, block ? "phase step" : "DACCNTVAL", ideal, metrics_cents(ideal, note));
+    if (noisy) printf("not measured with dither or noise shaping\n");
+    else if (rich) printf("not measured, the harmonics cross zero too\n");
+    else printf("measured %.3f Hz (%+.2f cents)\n", measured, metrics_cents(measured, note));
+    printf("THD+N     %.2f dB (%.4f%%), fundamental %.4f FS rms\n", metrics_db(thdn), thdn * 100, fund);
+    printf("swaps     %d, held updates %d, longest hold %d (%.3f us)\n", swaps, held, longest, longest * update_us);
+    printf("steps     largest into a new buffer %d LSB, largest inside a buffer %d LSB\n", swap_step, inner_step);
+    if (block) {
+        SynthStats st;
+        synth_stats(&synth, &st, false);
+        printf("synth     block %d, latency %u us, %u blocks rendered, %u underruns, deadline %u cycles, cost %u cycles\n",
+            block, synth_latency_us(&synth), st.blocks, st.underruns, st.period_cycles, render_cost);
+        health_dump(stdout);
+
+        //At the update rate the box filter is the zero order hold itself, nothing aliases.
+        //Dither adds crossings of its own, so fit the frequency asked for, not the one measured
+        std::vector<double> held = reconstruct(updates, start, end, DAC_PCLK_HZ / count);
+        double band_thdn = metrics_thd_n_band(&held[0], held.size(), DAC_PCLK_HZ / count, ideal, AUDIO_BAND, 0);
+        printf("output    x%d at %.1f kHz, order %d, %s: THD+N below %d Hz %.2f dB, %.1f cycles per DAC word (host clock)\n",
+            oversample, DAC_PCLK_HZ / (count * 1000.0), order, dither ? "TPDF dither" : "no dither",
+            AUDIO_BAND, metrics_db(band_thdn), output_cycles(&synth));
+    }
+    if (preset >= 0) {
+        SynthStats st;
+        synth_stats(&synth, &st, false);
+        printf("additive  frame %d, %d partials, %u frames, longest block render %u cycles (host clock)\n",
+            frame, additive.partials, additive.frames, st.max_render_cycles);
+    }
+    if (block) profile_dump(stdout);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Interpolating DDS
+ * See dds.h
+ */
+
+#include <math.h>
+
+#include "dds.h"
+
+void dds_table_init(int16_t *table, int bits) {
+    int n = 1 << bits;
+    //Entry i of the cycle lives at table[i + 1]
+    for (int i = -1; i < n + 2; i++) {
+        double v = floor(32767.0 * sin(2.0 * M_PI * i / n) + 0.5);
+        table[i + 1] = (int16_t)v;
+    }
+}
+
+void dds_table_partials(int16_t *table, int bits, const int16_t *gains, int count) {
+    int n = 1 << bits;
+    double peak = 0;
+    for (int i = 0; i < n; i++) {
+        double v = 0;
+        for (int h = 0; h < count; h++) v += gains[h] * sin(2.0 * M_PI * (h + 1) * i / n);
+        if (fabs(v) > peak) peak = fabs(v);
+    }
+    double scale = peak > 0 ? 32767.0 / peak : 0;
+    for (int i = -1; i < n + 2; i++) {
+        double v = 0;
+        for (int h = 0; h < count; h++) v += gains[h] * sin(2.0 * M_PI * (h + 1) * i / n);
+        table[i + 1] = (int16_t)floor(v * scale + 0.5);
+    }
+}
+
+bool dds_init(Dds *d, const int16_t *table, int bits, int interp) {
+    if (bits < DDS_MIN_BITS || bits > DDS_MAX_BITS) return false;
+    d->table = table;
+    d->bits = bits;
+    d->interp = interp;
+    d->phase = 0;
+    d->step = 0;
+    return true;
+}
+
+void dds_set_freq(Dds *d, uint32_t freq_q8, uint32_t sample_rate) {
+    //2^32 * f / rate with f in Q8
+    d->step = (uint32_t)(((uint64_t)freq_q8 << 24) / sample_rate);
+}
+
+static inline void store(uint32_t *out, int32_t v) {
+    *out = dds_dacr(v);
+}
+
+static inline void store(int16_t *out, int32_t v) {
+    *out = (int16_t)dds_saturate(v);
+}
+
+//Four samples a pass, the kernel is picked at compile time so each loop stays branch free
+#define DDS_RENDER_LOOP(kernel)                                         \
+    do {                                                                \
+        int i = 0;                                                      \
+        for (; i + 4 <= count; i += 4) {                                \
+            store(&out[i],     kernel(t, phase, shift)); phase += step; \
+            store(&out[i + 1], kernel(t, phase, shift)); phase += step; \
+            store(&out[i + 2], kernel(t, phase, shift)); phase += step; \
+            store(&out[i + 3], kernel(t, phase, shift)); phase += step; \
+        }                                                               \
+        for (; i < count; i++) {                                        \
+            store(&out[i], kernel(t, phase, shift)); phase += step;     \
+        }                                                               \
+    } while (0)
+
+template <class Out>
+static void render(Dds *d, Out *out, int count) {
+    const int16_t *t = d->table;
+    uint32_t phase = d->phase, step = d->step;
+    int shift = 32 - d->bits;
+
+    switch (d->interp) {
+    case DDS_LINEAR:
+        DDS_RENDER_LOOP(dds_linear);
+        break;
+    case DDS_CUBIC:
+        DDS_RENDER_LOOP(dds_cubic);
+        break;
+    default:
+        DDS_RENDER_LOOP(dds_truncate);
+        break;
+    }
+    d->phase = phase;
+}
+
+void dds_render(Dds *d, uint32_t *dacr, int count) {
+    render(d, dacr, count);
+}
+
+void dds_render_q15(Dds *d, int16_t *out, int count) {
+    render(d, out, count);
+}
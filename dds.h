@@ -0,0 +1,115 @@
+/*
+ * Interpolating DDS
+ * Objective: Change pitch at a fixed DAC rate without truncation spurs
+ *
+ * A 32 bit phase accumulator steps through a power of 2 table of Q15 samples.
+ * The top bits of the phase pick the entry, the next 15 bits are the fraction
+ * used to interpolate between entries:
+ *   DDS_TRUNCATE  nearest lower entry, what stepping through wave_table does
+ *   DDS_LINEAR    straight line between two entries
+ *   DDS_CUBIC     Catmull-Rom through four entries
+ *
+ * Frequencies are Hz * 256 (Q8) like everywhere else.
+ *
+ * Each render call fills a whole DMA buffer with DACR words (or Q15 samples for
+ * analysis), four samples per loop pass, all in 32 bit integer arithmetic.
+ * See dds_bench for cycles per sample and purity against table size.
+ */
+
+#ifndef DDS_H
+#define DDS_H
+
+#include <stdint.h>
+
+#include "wave_table.h"
+
+#define DDS_MIN_BITS 4
+#define DDS_MAX_BITS 16
+
+/*
+ * Table length for 2^bits entries. One guard entry before and two after the
+ * cycle let every tap read straight through without masking the index.
+ */
+#define DDS_TABLE_LENGTH(bits) ((1 << (bits)) + 3)
+
+enum DdsInterp {
+    DDS_TRUNCATE = 0,
+    DDS_LINEAR,
+    DDS_CUBIC
+};
+
+struct Dds {
+    const int16_t *table;   //DDS_TABLE_LENGTH(bits) entries from dds_table_init()
+    int            bits;    //log2 of the number of entries in one cycle
+    int            interp;  //DdsInterp
+    uint32_t       phase;
+    uint32_t       step;    //Phase increment per sample, see dds_set_freq()
+};
+
+/*
+ * One cycle of sine at full scale Q15, plus the guard entries
+ * Cubic interpolation stays inside 32 bits only for smooth tables like this one;
+ * anything sharper than a quarter of the table length per step could overflow it
+ */
+void dds_table_init(int16_t *table, int bits);
+
+//Same layout, the sum of harmonics 1..count at Q15 gains, scaled so the peak is full scale
+void dds_table_partials(int16_t *table, int bits, const int16_t *gains, int count);
+
+//Returns false if bits is out of range
+bool dds_init(Dds *d, const int16_t *table, int bits, int interp);
+
+//Phase step for freq_q8 at sample_rate samples a second
+void dds_set_freq(Dds *d, uint32_t freq_q8, uint32_t sample_rate);
+
+//Renders count DACR words, VALUE is the top 10 bits of the Q15 sample
+void dds_render(Dds *d, uint32_t *dacr, int count);
+
+//Same samples as Q15, for measuring
+void dds_render_q15(Dds *d, int16_t *out, int count);
+
+//Shared with the mixer, the M3 turns the compares into conditional moves
+static inline int32_t dds_saturate(int32_t v) {
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return v;
+}
+
+//Q15 to a DACR word, the offset turns signed Q15 into the unsigned DAC range
+static inline uint32_t dds_dacr(int32_t v) {
+    return DACR_BIAS | ((uint32_t)(dds_saturate(v) + 32768) & 0xFFC0);
+}
+
+/*
+ * One sample per kernel, phase advanced by the caller
+ * t points at the guard entry, so t[i + 1] is cycle entry i
+ */
+static inline int32_t dds_truncate(const int16_t *t, uint32_t phase, int shift) {
+    return t[(phase >> shift) + 1];
+}
+
+static inline int32_t dds_linear(const int16_t *t, uint32_t phase, int shift) {
+    const int16_t *p = t + (phase >> shift) + 1;
+    int32_t x = (phase >> (shift - 15)) & 0x7FFF;
+    int32_t a = p[0], b = p[1];
+    return a + (((b - a) * x) >> 15);
+}
+
+/*
+ * Catmull-Rom in Horner form, p0..p3 are entries i-1..i+2
+ * y = p1 + x/2 * ((p2 - p0) + x * ((2p0 - 5p1 + 4p2 - p3) + x * (3(p1 - p2) + p3 - p0)))
+ */
+static inline int32_t dds_cubic(const int16_t *t, uint32_t phase, int shift) {
+    const int16_t *p = t + (phase >> shift);
+    int32_t x = (phase >> (shift - 15)) & 0x7FFF;
+    int32_t p0 = p[0], p1 = p[1], p2 = p[2], p3 = p[3];
+    int32_t c3 = 3 * (p1 - p2) + p3 - p0;
+    int32_t c2 = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+    int32_t c1 = p2 - p0;
+    int32_t v = (c3 * x) >> 15;
+    v = ((v + c2) * x) >> 15;
+    v = ((v + c1) * x) >> 16;
+    return p1 + v;
+}
+
+#endif
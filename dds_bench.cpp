@@ -0,0 +1,116 @@
+/*
+ * DDS Benchmark
+ * Objective: Pick the smallest table and cheapest interpolation that still sounds clean
+ *
+ * Builds for the mbed and for the PC from the same source:
+ *   mbed: cycles per sample off the DWT counter, printed on the USB serial port
+ *   PC:   the same figures from the host clock scaled to 96MHz, plus purity
+ *         (THD+N of the Q15 output and of the 10 bit DAC values)
+ *
+ * Host build:
+ *   g++ -O2 -o dds_bench dds_bench.cpp dds.cpp audio_metrics.cpp
+ *
+ * The budget column is the share of one output sample period at BENCH_RATE
+ * that rendering takes, the rest is left for analysis and everything else.
+ */
+
+#include <stdio.h>
+
+#include "cycle_counter.h"
+#include "dds.h"
+#include "wave_table.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+Serial pc(USBTX, USBRX);
+#define report pc.printf
+#else
+#include <math.h>
+#include <vector>
+#include "audio_metrics.h"
+#define report printf
+#endif
+
+#define BENCH_RATE 48000            //Fixed DAC update rate the DDS renders for
+#define BENCH_BLOCK 256             //Samples per render call, one DMA buffer
+#define BENCH_BLOCKS 64
+#define A4_FREQ_Q8 112640           //440Hz
+#define ODD_FREQ_Q8 316032          //1234.5Hz, never lines up with the table
+
+static const int table_bits[] = { 6, 8, 10, 12 };
+static const char *interp_names[] = { "truncate", "linear", "cubic" };
+
+static int16_t table[DDS_TABLE_LENGTH(12)];
+static uint32_t dacr[BENCH_BLOCK];
+
+//Best of BENCH_BLOCKS calls, so an interrupt landing in one does not count
+static uint32_t cycles_per_block(Dds *d) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int b = 0; b < BENCH_BLOCKS; b++) {
+        uint32_t start = cycle_count();
+        dds_render(d, dacr, BENCH_BLOCK);
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+#ifndef TARGET_LPC1768
+//THD+N in dB of one second at freq_q8, as Q15 and as the 10 bit VALUE the DAC sees
+static void purity(Dds *d, uint32_t freq_q8, double *q15_db, double *dac_db) {
+    std::vector<int16_t> q15(BENCH_RATE);
+    std::vector<uint32_t> words(BENCH_RATE);
+    std::vector<double> x(BENCH_RATE);
+
+    d->phase = 0;
+    dds_set_freq(d, freq_q8, BENCH_RATE);
+    dds_render_q15(d, &q15[0], BENCH_RATE);
+    d->phase = 0;
+    dds_render(d, &words[0], BENCH_RATE);
+
+    double f = freq_q8 / 256.0;
+    for (int i = 0; i < BENCH_RATE; i++) x[i] = q15[i] / 32768.0;
+    *q15_db = metrics_db(metrics_thd_n(&x[0], BENCH_RATE, BENCH_RATE, f, 0));
+    for (int i = 0; i < BENCH_RATE; i++) x[i] = ((int)DACR_VALUE(words[i]) - 512) / 512.0;
+    *dac_db = metrics_db(metrics_thd_n(&x[0], BENCH_RATE, BENCH_RATE, f, 0));
+}
+#endif
+
+int main() {
+    cycle_counter_init();
+    uint32_t budget = CCLK_HZ / BENCH_RATE;
+
+    report("DDS at %d Hz, %d samples per call, budget %u cycles per sample\n", BENCH_RATE, BENCH_BLOCK, budget);
+#ifdef TARGET_LPC1768
+    report("bits table_bytes interp     cycles/sample budget\n");
+#else
+    report("bits table_bytes interp     cycles/sample budget  THD+N_440_q15 THD+N_440_dac THD+N_1234_q15 THD+N_1234_dac\n");
+#endif
+
+    for (unsigned b = 0; b < sizeof(table_bits) / sizeof(table_bits[0]); b++) {
+        int bits = table_bits[b];
+        dds_table_init(table, bits);
+        for (int interp = DDS_TRUNCATE; interp <= DDS_CUBIC; interp++) {
+            Dds d;
+            dds_init(&d, table, bits, interp);
+            dds_set_freq(&d, A4_FREQ_Q8, BENCH_RATE);
+            uint32_t cycles = cycles_per_block(&d);
+            uint32_t per_sample_x10 = cycles * 10 / BENCH_BLOCK;
+            uint32_t share_x10 = cycles * 1000 / BENCH_BLOCK / budget;
+
+            report("%4d %11d %-10s %9u.%u %4u.%u%%", bits, (int)(DDS_TABLE_LENGTH(bits) * sizeof(int16_t)),
+                interp_names[interp], per_sample_x10 / 10, per_sample_x10 % 10, share_x10 / 10, share_x10 % 10);
+#ifndef TARGET_LPC1768
+            double a_q15, a_dac, o_q15, o_dac;
+            purity(&d, A4_FREQ_Q8, &a_q15, &a_dac);
+            purity(&d, ODD_FREQ_Q8, &o_q15, &o_dac);
+            report(" %13.1f %13.1f %14.1f %14.1f", a_q15, a_dac, o_q15, o_dac);
+#endif
+            report("\n");
+        }
+    }
+
+    //The table the output path uses now, 360 ints of DACR words in each ping-pong buffer
+    report("wave_table today: %d bytes per buffer\n", (int)(WAVE_TABLE_LENGTH * sizeof(int)));
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * FFT Benchmark
+ * Objective: Check Fft<N> (fft_sized.h) against direct fftR4c calls and time the two
+ *
+ * Builds for the mbed and for the PC from the same source, like dds_bench.
+ * Both sides are the same transform, FFTCM3.s on the mbed and the fft_r4.cpp port
+ * on the PC (cycles are the host clock scaled to 96MHz), so the ratio is the
+ * wrapper's overhead and should be 1.00x.
+ *
+ * Host build (every size needs the full plan arena):
+ *   g++ -O2 -DFFT_PLAN_MAX_N=4096 -o fft_bench fft_bench.cpp fft_r4.cpp fft_plan.cpp
+ *
+ * For each size, forward and inverse are run on a noisy two tone frame and must
+ * match fftR4c bit for bit. Cycles a call are the best of BENCH_RUNS timings, each
+ * of BENCH_POINTS / N calls so that even N = 4 takes far longer than a clock tick.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cycle_counter.h"
+#include "fft_sized.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+Serial pc(USBTX, USBRX);
+#define report pc.printf
+#else
+#define report printf
+#endif
+
+#if FFT_PLAN_MAX_N < 4096
+#error "fft_bench runs every size up to 4096, build it (and fft_plan.cpp) with -DFFT_PLAN_MAX_N=4096"
+#endif
+
+#define BENCH_RUNS 16
+#define BENCH_POINTS 65536  //Points transformed per timing, one 4 point FFT is below the host clock's resolution
+
+//Two tones and an LCG's worth of noise, near full scale like a levelled ADC frame
+template <int N>
+static void fill(ComplexQ15Buffer<N> &x) {
+    uint32_t seed = 12345;
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1664525 + 1013904223;
+        int noise = (int)(seed >> 22) - 512;
+        x.re(i) = (short)(16000 * sin(2 * M_PI * 3 * i / N) + 8000 * sin(2 * M_PI * 0.37 * i) + noise);
+        x.im(i) = (short)noise;
+    }
+}
+
+//Best of BENCH_RUNS cycles per call of fn, timed over calls calls at a time, after one to warm up
+template <class F>
+static double best_of(F fn, int calls) {
+    fn();
+    uint32_t best = 0xFFFFFFFF;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        uint32_t start = cycle_count();
+        for (int i = 0; i < calls; i++) fn();
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return (double)best / calls;
+}
+
+//generic / sized, 0 when sized did not register at all
+static double ratio(double generic, double sized) {
+    return sized > 0 ? generic / sized : 0;
+}
+
+template <int N>
+static int bench(void) {
+    static ComplexQ15Buffer<N> x, y, expect;
+    Fft<N> fft;
+    FftPlan plan;
+    fft_plan_init(&plan, N);
+    int failures = 0;
+    fill(x);
+
+    const int calls = BENCH_POINTS / N > 0 ? BENCH_POINTS / N : 1;
+    double generic[2], sized[2];
+    for (int inverse = 0; inverse < 2; inverse++) {
+        auto run_generic = [&] {
+            if (inverse) ifftR4c(expect.iq, x.iq, N, plan.coef);
+            else fftR4c(expect.iq, x.iq, N, plan.coef);
+        };
+        auto run_sized = [&] {
+            if (inverse) fft.inverse(y, x);
+            else fft.forward(y, x);
+        };
+        run_generic();
+        memset(y.iq, 0, sizeof(y.iq));
+        run_sized();
+        if (memcmp(y.iq, expect.iq, sizeof(y.iq)) != 0) failures++;
+        generic[inverse] = best_of(run_generic, calls);
+        sized[inverse] = best_of(run_sized, calls);
+    }
+
+    report("%5d %9.1f %9.1f %6.2fx %9.1f %9.1f %6.2fx  %s\n", N,
+        generic[0], sized[0], ratio(generic[0], sized[0]),
+        generic[1], sized[1], ratio(generic[1], sized[1]), failures ? "MISMATCH" : "ok");
+    return failures;
+}
+
+int main() {
+    cycle_counter_init();
+    report("    N   fftR4c    Fft<N>  ratio  ifftR4c    Fft<N>  ratio\n");
+    int failures = 0;
+    failures += bench<4>();
+    failures += bench<16>();
+    failures += bench<64>();
+    failures += bench<256>();
+    failures += bench<1024>();
+    failures += bench<4096>();
+    report(failures ? "%d MISMATCHES\n" : "all sizes match\n", failures);
+    return failures ? 1 : 0;
+}
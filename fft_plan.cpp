@@ -0,0 +1,24 @@
+/*
+ * FFT Plans
+ * See fft_plan.h
+ */
+
+#include "fft_plan.h"
+
+static short arena[FFT_R4_COEF_LENGTH(FFT_PLAN_MAX_N)] __attribute__((aligned(4)));
+static int arena_N = 4;    //Largest size the arena holds, N = 4 needs no twiddles
+
+bool fft_plan_init(FftPlan *p, int N) {
+    if (!fft_r4_size_ok(N) || N > FFT_PLAN_MAX_N) return false;
+    if (N > arena_N) {
+        fft_r4_coef_init(arena, N);
+        arena_N = N;
+    }
+    p->N = N;
+    p->coef = arena;
+    return true;
+}
+
+int fft_plan_arena_bytes(void) {
+    return FFT_R4_COEF_LENGTH(arena_N) * (int)sizeof(short);
+}
@@ -0,0 +1,47 @@
+/*
+ * FFT Plans
+ * Objective: Pick the FFT size at run time without keeping a flash table per size
+ *
+ * Every plan points into one RAM arena of fftR4 coefficients. The table for N is
+ * the start of the table for any larger N, so the arena is built once, up to the
+ * largest size asked for, and every smaller plan reuses it. Reads from RAM also
+ * skip the flash wait states the built in table costs.
+ *
+ * FFT_PLAN_MAX_N sets the arena size, 2 * (N - 4) shorts:
+ *   256 -> 1008 bytes, 1024 -> 4080 bytes, 4096 -> 16368 bytes
+ */
+
+#ifndef FFT_PLAN_H
+#define FFT_PLAN_H
+
+#include "fft_r4.h"
+
+#ifndef FFT_PLAN_MAX_N
+#define FFT_PLAN_MAX_N 1024
+#endif
+
+struct FftPlan {
+    int          N;
+    const short *coef;  //Shared arena, never 0 once the plan is made
+};
+
+/*
+ * Makes a plan for N, building the arena up to N if no earlier plan needed that much
+ * Call from main or event context, not while an FFT is running
+ * Returns false if N is not an fftR4 size or is above FFT_PLAN_MAX_N
+ */
+bool fft_plan_init(FftPlan *p, int N);
+
+//fftR4/ifftR4 with the plan's size and table, same buffer rules
+static inline void fft_plan_forward(const FftPlan *p, short *y, short *x) {
+    fftR4c(y, x, p->N, p->coef);
+}
+
+static inline void fft_plan_inverse(const FftPlan *p, short *y, short *x) {
+    ifftR4c(y, x, p->N, p->coef);
+}
+
+//Bytes of the arena built so far
+int fft_plan_arena_bytes(void);
+
+#endif
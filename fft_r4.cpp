@@ -0,0 +1,150 @@
+/*
+ * Radix 4 FFT, host port of FFTCM3.s
+ *
+ * Follows the assembly register for register so the output is bit exact:
+ *   - first stage loads in bit reversed order with BFFT4 shift 0 (no twiddles)
+ *   - later stages multiply by the conjugate twiddles (MULCC1) and use BFFT4 shift 15
+ *   - every stage divides by 4, results are truncated to 16 bits on store
+ *
+ * coef_table is generated instead of typed in, by fft_r4_coef_init() in the
+ * same layout as the assembly. fftR4c/ifftR4c run the same code on the caller's table.
+ *
+ * Not built for the mbed, FFTCM3.s provides the real thing there.
+ */
+
+#ifndef TARGET_LPC1768
+
+#include <math.h>
+#include <stdint.h>
+
+#include "fft_r4.h"
+
+static short coef_table[FFT_R4_COEF_LENGTH(4096)];
+
+static void coef_init(void) {
+    fft_r4_coef_init(coef_table, 4096);
+}
+
+//Built before main() so threads of the batch tools never race to fill it
+static struct CoefInit {
+    CoefInit() { coef_init(); }
+} coef_init_at_startup;
+
+//Reverses the low bits bits of k, what RBIT on the scaled counter does in the assembly
+static inline int bit_reverse(int k, int bits) {
+    int r = 0;
+    for (int i = 0; i < bits; i++) {
+        r = (r << 1) | (k & 1);
+        k >>= 1;
+    }
+    return r;
+}
+
+/*
+ * BFFT4 macro, s = 0 for the first stage, 15 for twiddled stages
+ * Note the odd register allocation: y3 lives in x3's registers with re/im swapped
+ */
+static inline void bfft4(int32_t *x0r, int32_t *x0i, int32_t *x1r, int32_t *x1i,
+                         int32_t *x2r, int32_t *x2i, int32_t *x3r, int32_t *x3i, int s) {
+    *x2r = *x2r + *x3r;                 // (x2,x3) = (x2+x3, x2-x3)
+    *x2i = *x2i + *x3i;
+    *x3r = *x2r - (*x3r << 1);
+    *x3i = *x2i - (*x3i << 1);
+
+    *x0r = *x0r >> 2;                   // (x0,x1) = (x0+(x1>>s), x0-(x1>>s))/4
+    *x0i = *x0i >> 2;
+    *x0r = *x0r + (*x1r >> (2 + s));
+    *x0i = *x0i + (*x1i >> (2 + s));
+    *x1r = *x0r - (*x1r >> (1 + s));
+    *x1i = *x0i - (*x1i >> (1 + s));
+
+    *x0r = *x0r + (*x2r >> (2 + s));    // (x0,x2) = (x0+(x2>>s)/4, x0-(x2>>s)/4)
+    *x0i = *x0i + (*x2i >> (2 + s));
+    *x2r = *x0r - (*x2r >> (1 + s));
+    *x2i = *x0i - (*x2i >> (1 + s));
+
+    *x1r = *x1r + (*x3i >> (2 + s));    // (x1,y3)=(x1-i*(x3>>s)/4, x1+i*(x3>>s)/4)
+    *x1i = *x1i - (*x3r >> (2 + s));
+    int32_t y3r = *x1r - (*x3i >> (1 + s));
+    int32_t y3i = *x1i + (*x3r >> (1 + s));
+    *x3r = y3r;
+    *x3i = y3i;
+}
+
+static inline void store(short *y, int index, int32_t re, int32_t im) {
+    y[2 * index]     = (short)re;
+    y[2 * index + 1] = (short)im;
+}
+
+//a = x * conj(c)
+static inline void mulcc(int32_t *ar, int32_t *ai, int32_t xr, int32_t xi, const short *c) {
+    *ai = xi * c[0] - xr * c[1];
+    *ar = xr * c[0] + xi * c[1];
+}
+
+static void fft_r4(short *y, const short *x, int N, bool inverse, const short *coef) {
+    int bits = 0;
+    while ((4 << bits) < N) bits++;
+
+    //First stage, ifftR4 reads x(N-n) instead of x(n)
+    for (int k = 0; k < N / 4; k++) {
+        int t = bit_reverse(k, bits);
+        int i0 = t, i2 = t + N / 4, i1 = t + N / 2, i3 = t + 3 * N / 4;
+        if (inverse) {
+            i0 = (N - i0) & (N - 1);
+            i2 = (N - i2) & (N - 1);
+            i1 = (N - i1) & (N - 1);
+            i3 = (N - i3) & (N - 1);
+        }
+        int32_t x0r = x[2 * i0], x0i = x[2 * i0 + 1];
+        int32_t x1r = x[2 * i1], x1i = x[2 * i1 + 1];
+        int32_t x2r = x[2 * i2], x2i = x[2 * i2 + 1];
+        int32_t x3r = x[2 * i3], x3i = x[2 * i3 + 1];
+        bfft4(&x0r, &x0i, &x1r, &x1i, &x2r, &x2i, &x3r, &x3i, 0);
+        store(y, 4 * k,     x0r, x0i);
+        store(y, 4 * k + 1, x1r, x1i);
+        store(y, 4 * k + 2, x2r, x2i);
+        store(y, 4 * k + 3, x3r, x3i);
+    }
+
+    //Remaining stages in place on y, Bl blocks of 4*R points
+    const short *c = coef;
+    for (int Bl = N >> 4, R = 4; Bl; Bl >>= 2, R <<= 2) {
+        for (int b = 0; b < Bl; b++) {
+            for (int j = 0; j < R; j++) {
+                int p0 = b * 4 * R + j;
+                int p1 = p0 + R, p2 = p0 + 2 * R, p3 = p0 + 3 * R;
+                const short *w = c + 6 * j;
+                int32_t x0r = y[2 * p0], x0i = y[2 * p0 + 1];
+                int32_t x1r, x1i, x2r, x2i, x3r, x3i;
+                mulcc(&x3r, &x3i, y[2 * p3], y[2 * p3 + 1], w);      //E(3t)
+                mulcc(&x2r, &x2i, y[2 * p2], y[2 * p2 + 1], w + 2);  //E(t)
+                mulcc(&x1r, &x1i, y[2 * p1], y[2 * p1 + 1], w + 4);  //E(2t)
+                bfft4(&x0r, &x0i, &x1r, &x1i, &x2r, &x2i, &x3r, &x3i, 15);
+                store(y, p0, x0r, x0i);
+                store(y, p1, x1r, x1i);
+                store(y, p2, x2r, x2i);
+                store(y, p3, x3r, x3i);
+            }
+        }
+        c += 6 * R;
+    }
+}
+
+extern "C" void fftR4(short *y, short *x, int N) {
+    fft_r4(y, x, N, false, coef_table);
+}
+
+extern "C" void ifftR4(short *y, short *x, int N) {
+    fft_r4(y, x, N, true, coef_table);
+}
+
+extern "C" void fftR4c(short *y, short *x, int N, const short *coef) {
+    fft_r4(y, x, N, false, coef);
+}
+
+extern "C" void ifftR4c(short *y, short *x, int N, const short *coef) {
+    fft_r4(y, x, N, true, coef);
+}
+
+#endif
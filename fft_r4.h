@@ -0,0 +1,61 @@
+/*
+ * Radix 4 FFT
+ * Objective: One declaration of fftR4/ifftR4 for the mbed and the PC
+ *
+ * On the mbed these come from FFTCM3.s (Ivan Mellen's Cortex-M3 assembly).
+ * On the host fft_r4.cpp provides a line by line C port of the same algorithm,
+ * including the per-stage scaling and truncation, so results match the board.
+ *
+ * From the FFTCM3.s header:
+ *   - supported sizes: N=4,16,64,256,1024,4096
+ *   - 16 bit complex arithmetic, 1Q15 coefficients
+ *   - x and y are x0r,x0i,x1r,x1i,... (2*N shorts), 4 byte aligned
+ *   - input data remains unmodified
+ *   - auto scale after each stage, y = DFT(x)/N, ifftR4 output is x/N
+ *
+ * fftR4/ifftR4 read the coefficient table built into the code (flash on the mbed).
+ * fftR4c/ifftR4c take the table as an argument instead, so it can live in RAM,
+ * see fft_plan.h. Layout for M = 16, 64, ... up to N: M/4 triplets of
+ * E(3t), E(t), E(2t) with t = 2*PI*k/M and E(t) = cos(t) + i*sin(t) in 1Q15.
+ * The table for N is the start of the table for 4N.
+ */
+
+#ifndef FFT_R4_H
+#define FFT_R4_H
+
+#include <math.h>
+
+extern "C" void fftR4(short *y, short *x, int N);
+extern "C" void ifftR4(short *y, short *x, int N);
+extern "C" void fftR4c(short *y, short *x, int N, const short *coef);
+extern "C" void ifftR4c(short *y, short *x, int N, const short *coef);
+
+//Shorts of coefficient table an N point transform reads, N - 4 complex values
+#define FFT_R4_COEF_LENGTH(N) (2 * ((N) - 4))
+
+//True for the sizes the assembly (and the port) support
+static inline bool fft_r4_size_ok(int N) {
+    return N == 4 || N == 16 || N == 64 || N == 256 || N == 1024 || N == 4096;
+}
+
+//Rounds to 1Q15 the way the FFTCM3.s table was made
+static inline short fft_r4_q15(double v) {
+    double r = floor(v * 32768.0 + 0.5);
+    if (r > 32767) r = 32767;
+    if (r < -32768) r = -32768;
+    return (short)r;
+}
+
+//Fills FFT_R4_COEF_LENGTH(N) shorts, the same values as the built in table
+static inline void fft_r4_coef_init(short *coef, int N) {
+    for (int M = 16; M <= N; M *= 4) {
+        for (int k = 0; k < M / 4; k++) {
+            double t = 2.0 * M_PI * k / M;
+            *coef++ = fft_r4_q15(cos(3 * t)); *coef++ = fft_r4_q15(sin(3 * t));
+            *coef++ = fft_r4_q15(cos(t));     *coef++ = fft_r4_q15(sin(t));
+            *coef++ = fft_r4_q15(cos(2 * t)); *coef++ = fft_r4_q15(sin(2 * t));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Fixed Size FFT
+ * Objective: Make a wrong fftR4 size or buffer a compile error
+ *
+ * fftR4 takes raw short pointers and an int N, and FFTCM3.s quietly assumes N is
+ * 4, 16, 64, 256, 1024 or 4096 and that x and y are 2*N shorts, 4 byte aligned.
+ * Here N is a template argument instead:
+ *
+ *   ComplexQ15Buffer<N>   2*N shorts, re/im interleaved, 4 byte aligned
+ *   Fft<N>                forward/inverse from one such buffer into another,
+ *                         twiddles from an FftPlan for N (fft_plan.h)
+ *
+ * A size fftR4 cannot do, one above FFT_PLAN_MAX_N, or a buffer of another size
+ * does not compile. x is left as it is and must not be y, as with fftR4.
+ *
+ * Fft<N> only adds the type checking: forward() and inverse() call fftR4c and
+ * ifftR4c, the FFTCM3.s assembly on the mbed and the fft_r4.cpp port on the host,
+ * exactly as a direct call would. There are no per size kernels: on the board
+ * the hand scheduled FFTCM3.s runs every size. fft_bench checks the wrapper
+ * against direct calls and times the two.
+ *
+ * Fft<N> makes its plan in the constructor, so make one from main or event
+ * context, not while another FFT is running (fft_plan_init()).
+ */
+
+#ifndef FFT_SIZED_H
+#define FFT_SIZED_H
+
+#include <stdint.h>
+
+#include "fft_plan.h"
+
+//fft_r4_size_ok() for static_assert
+constexpr bool fft_sized_ok(int N) {
+    return N == 4 || N == 16 || N == 64 || N == 256 || N == 1024 || N == 4096;
+}
+
+template <int N>
+struct ComplexQ15Buffer {
+    static_assert(fft_sized_ok(N), "fftR4 only does N = 4, 16, 64, 256, 1024 or 4096");
+
+    short iq[2 * N] __attribute__((aligned(4)));    //x0r, x0i, x1r, x1i, ...
+
+    short *data() { return iq; }
+    const short *data() const { return iq; }
+    short &re(int k) { return iq[2 * k]; }
+    short &im(int k) { return iq[2 * k + 1]; }
+    short re(int k) const { return iq[2 * k]; }
+    short im(int k) const { return iq[2 * k + 1]; }
+};
+
+template <int N>
+class Fft {
+    static_assert(fft_sized_ok(N), "fftR4 only does N = 4, 16, 64, 256, 1024 or 4096");
+    static_assert(N <= FFT_PLAN_MAX_N, "N is above FFT_PLAN_MAX_N, the plan arena cannot hold its twiddles");
+
+public:
+    typedef ComplexQ15Buffer<N> Buffer;
+
+    Fft() {
+        fft_plan_init(&plan, N);
+    }
+
+    //y = DFT(x) / N
+    void forward(Buffer &y, const Buffer &x) const {
+        fftR4c(y.iq, const_cast<short *>(x.iq), N, plan.coef);
+    }
+
+    //y = IDFT(x) / N
+    void inverse(Buffer &y, const Buffer &x) const {
+        ifftR4c(y.iq, const_cast<short *>(x.iq), N, plan.coef);
+    }
+
+private:
+    FftPlan plan;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Fixed Point Helpers
+ * Objective: The few integer math routines more than one module needs
+ */
+
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+
+#include <stdint.h>
+
+//Integer square root, rounds down
+static inline uint32_t isqrt32(uint32_t v) {
+    uint32_t r = 0, bit = 1UL << 30;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+//Leading zeros, v must not be 0. One CLZ instruction on the M3
+static inline int clz32(uint32_t v) {
+#if defined(__CC_ARM)
+    return __clz(v);
+#else
+    return __builtin_clz(v);
+#endif
+}
+
+/*
+ * log2(v) in Q8, 0 for v = 0
+ * The fraction is the mantissa taken as linear, at most 0.086 (0.26dB of power) low
+ */
+static inline int32_t log2_q8(uint32_t v) {
+    if (v == 0) return 0;
+    int e = 31 - clz32(v);
+    uint32_t frac = e >= 8 ? v >> (e - 8) : v << (8 - e);
+    return (e << 8) | (frac & 0xFF);
+}
+
+//Clamp to the Q15 range
+static inline int32_t sat_q15(int32_t v) {
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return v;
+}
+
+#endif
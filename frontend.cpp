@@ -0,0 +1,100 @@
+/*
+ * Analysis Front End
+ * See frontend.h
+ */
+
+#include "adc_unpack.h"
+#include "fixed_math.h"
+#include "frontend.h"
+
+void frontend_init(Frontend *f, int dc_shift, int32_t max_gain) {
+    f->dc_shift = dc_shift;
+    f->dc_acc = 0;
+    f->primed = false;
+    f->gain = f->gain_now = FRONTEND_GAIN_ONE;
+    f->rms = 0;
+    f->level = 0;
+    f->crossings = 0;
+    f->spacing_q8 = 0;
+    f->zc_side = 0;
+    f->target = 8192;
+    f->gate = 33;
+    f->attack = 16384;
+    f->release = 2048;
+    f->max_gain = max_gain > FRONTEND_MAX_GAIN ? FRONTEND_MAX_GAIN : max_gain;
+}
+
+/*
+ * The loop for both entry points, Words picks where the samples come from so
+ * each build has no test per sample. The first block seeds the DC estimate
+ * with its mean, which takes one extra pass, once.
+ */
+template <bool Words>
+static int process(Frontend *f, const int16_t *in, const uint32_t *words, int16_t *out, int count,
+                   int channel, AdcUnpackStats *stats) {
+    if (count <= 0) return 0;
+    int shift = f->dc_shift;
+    uint32_t mask = adc_check_mask(channel), expect = adc_check_expect(channel);
+    int16_t last = 0;
+    int bad = 0;
+
+    if (!f->primed) {
+        int32_t sum = 0;
+        int16_t held = 0;
+        int ignored = 0;
+        for (int i = 0; i < count; i++) sum += Words ? adc_check_word(words[i], mask, expect, &held, &ignored, 0) : in[i];
+        f->dc_acc = (sum / count) << shift;
+        f->primed = true;
+    }
+
+    int32_t dc_acc = f->dc_acc;
+    int32_t gain = f->gain_now;
+    int32_t gain_step = (f->gain - f->gain_now) / count;
+    uint64_t power = 0;
+    int side = f->zc_side;
+    uint32_t crossings = 0;
+    int first = 0, last_crossing = 0;
+
+    for (int i = 0; i < count; i++) {
+        int32_t x = Words ? adc_check_word(words[i], mask, expect, &last, &bad, stats) : in[i];
+        dc_acc += x - (dc_acc >> shift);
+        int32_t y = sat_q15(x - (dc_acc >> shift));
+        power += (uint32_t)(y * y);
+        if ((y > FRONTEND_ZC_HYSTERESIS && side <= 0) || (y < -FRONTEND_ZC_HYSTERESIS && side >= 0)) {
+            if (side) {
+                if (!crossings) first = i;
+                last_crossing = i;
+                crossings++;
+            }
+            side = y > 0 ? 1 : -1;
+        }
+        out[i] = (int16_t)sat_q15((y * gain) >> 10);
+        gain += gain_step;
+    }
+    if (Words && stats) stats->words += count;
+    f->dc_acc = dc_acc;
+    f->gain_now = f->gain;
+    f->zc_side = side;
+    f->crossings = crossings;
+    f->spacing_q8 = crossings > 1 ? (uint32_t)((last_crossing - first) << 8) / (crossings - 1) : 0;
+
+    //Level of this block, then the gain the next one ramps to
+    f->level = isqrt32((uint32_t)(power / count));
+    uint32_t weight = f->level > f->rms ? f->attack : f->release;
+    f->rms = (uint32_t)((int32_t)f->rms + ((((int32_t)f->level - (int32_t)f->rms) * (int32_t)weight) >> 15));
+    if (f->rms > f->gate) {
+        uint32_t g = ((uint32_t)f->target << 10) / f->rms;
+        if (g > (uint32_t)f->max_gain) g = f->max_gain;
+        if (g < 16) g = 16;
+        f->gain = g;
+    }
+    return bad;
+}
+
+void frontend_process_q15(Frontend *f, const int16_t *in, int16_t *out, int count) {
+    process<false>(f, in, 0, out, count, ADC_ANY_CHANNEL, 0);
+}
+
+int frontend_process(Frontend *f, const uint32_t *words, int16_t *out, int count, int channel, AdcUnpackStats *stats) {
+    return process<true>(f, 0, words, out, count, channel, stats);
+}
@@ -0,0 +1,72 @@
+/*
+ * Analysis Front End
+ * Objective: Hand the detectors a zero mean, constant level Q15 signal whatever the antenna does
+ *
+ * Takes the ADC result words straight from the DMA:
+ *   checked word -> Q15 around mid scale -> one pole DC blocker -> AGC gain -> Q15 out
+ * in one pass, so the block is read once. The word check is adc_unpack_real()'s
+ * (adc_unpack.h): a bad word is replaced by the last good sample and counted.
+ * frontend_process_q15() takes samples that are already Q15 instead.
+ *
+ * DC blocker: the bias is tracked with dc += (x - dc) / 2^dc_shift and subtracted,
+ * a high pass with its corner at about rate / (2*pi*2^dc_shift),
+ * e.g. dc_shift 10 at 48kHz is 7.5Hz, well under the lowest note.
+ *
+ * AGC: the RMS of each block (after the DC blocker, before the gain) is smoothed
+ * with separate attack and release weights, and the gain for the next block is
+ * target / RMS. The gain ramps over the block instead of stepping. Below the gate
+ * the gain is held, so silence is not pumped up into noise.
+ *
+ * The same loop counts zero crossings of the DC blocked signal, with
+ * FRONTEND_ZC_HYSTERESIS either side of zero so noise does not chatter, and
+ * notes where the first and last fall. Their mean spacing is half a period to
+ * well under a percent for a steady tone. With level that is a cheap fingerprint
+ * of the block, see change_detect.h.
+ */
+
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include <stdint.h>
+
+#include "adc_unpack.h"
+
+#define FRONTEND_GAIN_ONE 1024  //Gains are Q10
+#define FRONTEND_MAX_GAIN 32767 //~32x, keeps sample * gain inside 32 bits
+#define FRONTEND_ZC_HYSTERESIS 64   //Q15, -54dBFS
+
+struct Frontend {
+    int      dc_shift;
+    int32_t  dc_acc;        //DC estimate in Q15 << dc_shift
+    bool     primed;        //The first block seeds the DC estimate with its mean
+    int32_t  gain;          //Q10, where the ramp ends up at the end of the next block
+    int32_t  gain_now;      //Q10, where the ramp starts
+    uint32_t rms;           //Smoothed input RMS, Q15
+    uint32_t level;         //RMS of the last block, Q15, before the gain, a usable volume
+    uint32_t crossings;     //Zero crossings in the last block
+    uint32_t spacing_q8;    //Their mean spacing in samples, Q8, 0 with fewer than 2
+    int      zc_side;       //-1 below, 1 above the hysteresis band, 0 not yet out of it
+    uint16_t target;        //Q15 RMS the AGC aims for
+    uint16_t gate;          //Q15 RMS under which the gain is held
+    uint16_t attack;        //Q15 weight when the level rises
+    uint16_t release;       //Q15 weight when it falls
+    int32_t  max_gain;      //Q10
+};
+
+/*
+ * Defaults: target RMS 1/4 full scale, gate at -60dBFS, fast attack, slow release,
+ * gain limited to max_gain (Q10, at most FRONTEND_MAX_GAIN)
+ */
+void frontend_init(Frontend *f, int dc_shift, int32_t max_gain);
+
+//count Q15 samples, e.g. from adc_unpack_real(), in may be out
+void frontend_process_q15(Frontend *f, const int16_t *in, int16_t *out, int count);
+
+/*
+ * count ADC result words checked for channel (or ADC_ANY_CHANNEL) and processed in
+ * the same loop, stats may be 0. Gives what adc_unpack_real() then
+ * frontend_process_q15() would. Returns the number of bad words.
+ */
+int frontend_process(Frontend *f, const uint32_t *words, int16_t *out, int count, int channel, AdcUnpackStats *stats);
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * Health Counters
+ * See health.h
+ */
+
+#include <string.h>
+
+#include "health.h"
+
+Health health;
+
+void health_reset_peaks(void) {
+    health.adc_latency_max = 0;
+    health.adc_gap_max = 0;
+    health.dac_latency_max = 0;
+}
+
+void health_reset(void) {
+    memset(&health, 0, sizeof(health));
+}
+
+void health_dump(FILE *f) {
+    if (health.adc_blocks) {
+        fprintf(f, "adc: %u blocks, %u dropped, %u words: %u overrun, %u not done, %u wrong channel; worst ISR %u cycles late, DMA off %u cycles\n",
+            health.adc_blocks, health.adc_dropped, health.adc.words, health.adc.overruns, health.adc.not_done,
+            health.adc.wrong_channel, health.adc_latency_max, health.adc_gap_max);
+    }
+    if (health.capture_dropped) fprintf(f, "capture: %u samples dropped\n", health.capture_dropped);
+    if (health.dac_blocks) {
+        fprintf(f, "dac: %u blocks, %u late re-arms, %u repeated buffers, worst ISR %u cycles late\n",
+            health.dac_blocks, health.dac_late_rearms, health.dac_repeats, health.dac_latency_max);
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Health Counters
+ * Objective: Know when the DMA paths slip, instead of guessing from the sound
+ *
+ * Always on, one global set since power up. Every update is a few loads, adds
+ * and compares, cheap enough for the ISRs that make them:
+ *
+ *   ADC   the unpack check counts overrun, unfinished and wrong channel words
+ *         (frontend_process() adds straight into health.adc). health_adc_armed()
+ *         notes when the block just armed should land, health_adc_landed() in the
+ *         TC ISR how late it did, and health_adc_rearmed() how long the DMA stayed
+ *         off after it: conversions in that gap are lost. A block that lands
+ *         before the one before it was taken for analysis counts as dropped.
+ *   DAC   health_dac_tc() in each ping-pong TC ISR keeps the time the hardware
+ *         should have finished the block: one block period after the last, slipped
+ *         by the updates the DAC held. An ISR later than the slack (one DAC update,
+ *         what the double buffered DACR holds) armed the other buffer too late and
+ *         the DAC held a sample. An ISR earlier than expected means the estimate
+ *         had drifted late, it restarts from there. Buffers replayed without a
+ *         refill come from the synth.
+ *   Capture  samples the file writer fell behind on.
+ *
+ * Latencies are in cycle_count() cycles. The ADC ones include up to one conversion
+ * period of phase, the timer keeps converting whether the DMA is armed or not.
+ * The peaks are cleared by health_reset_peaks(), the counts never are.
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "adc_unpack.h"
+
+struct Health {
+    AdcUnpackStats adc;             //Word checks
+    uint32_t adc_blocks;            //TC ISRs
+    uint32_t adc_latency_max;       //Worst block due to TC ISR running
+    uint32_t adc_gap_max;           //Worst TC ISR to DMA armed again
+    uint32_t adc_dropped;           //Blocks never analysed, the next one landed first
+    uint32_t capture_dropped;       //Samples
+    uint32_t dac_blocks;            //TC ISRs
+    uint32_t dac_late_rearms;       //TC ISRs past the slack
+    uint32_t dac_repeats;           //Buffers played again without a refill
+    uint32_t dac_latency_max;       //Worst TC ISR past the block finishing
+    //ISR bookkeeping
+    uint32_t adc_due;
+    uint32_t adc_landed;
+    uint32_t dac_due;               //When the playing block should finish
+    bool     dac_started;
+};
+
+extern Health health;
+
+//When the block just armed should land, block_cycles after now
+static inline void health_adc_armed(uint32_t now, uint32_t block_cycles) {
+    health.adc_due = now + block_cycles;
+}
+
+//From the ADC TC ISR
+static inline void health_adc_landed(uint32_t now) {
+    health.adc_blocks++;
+    health.adc_landed = now;
+    int32_t late = (int32_t)(now - health.adc_due);
+    if (late > (int32_t)health.adc_latency_max) health.adc_latency_max = late;
+}
+
+//Once the DMA is running again after a block landed, call health_adc_armed() too
+static inline void health_adc_rearmed(uint32_t now) {
+    uint32_t gap = now - health.adc_landed;
+    if (gap > health.adc_gap_max) health.adc_gap_max = gap;
+}
+
+//From each DAC TC ISR, period is one block and slack one DAC update, in cycles
+static inline void health_dac_tc(uint32_t now, uint32_t period, uint32_t slack) {
+    health.dac_blocks++;
+    int32_t late = (int32_t)(now - health.dac_due);
+    if (!health.dac_started || late < 0) {
+        health.dac_due = now;
+        late = 0;
+    }
+    health.dac_started = true;
+    if (late > (int32_t)health.dac_latency_max) health.dac_latency_max = late;
+    if (late > (int32_t)slack) {
+        //The next block starts at the first DAC update after the re-arm
+        health.dac_late_rearms++;
+        health.dac_due += (late - 1) / slack * slack;
+    }
+    health.dac_due += period;
+}
+
+//Clears the worst case latencies and gap, starting a new window
+void health_reset_peaks(void);
+
+//Clears everything, for host tools that run one configuration after another
+void health_reset(void);
+
+//Counts and peaks as text, only the paths that have run
+void health_dump(FILE *f);
+
+#endif
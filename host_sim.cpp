@@ -0,0 +1,302 @@
+/*
+ * Host Simulator
+ * See host_sim.h
+ */
+
+#include "host_sim.h"
+#include "adc_defs.h"
+#include "cycle_counter.h"
+#include "wave_table.h"
+
+static uint64_t now = 0;
+static bool finished = false;
+
+//ADC + DMA channel
+static SampleSource *adc_source = 0;
+static uint32_t adc_rate = 0;
+static uint64_t adc_conversions = 0;    //Conversions since sim_reset(), sets the ADC timebase
+static uint32_t *adc_dst = 0;
+static int adc_length = 0;
+static void (*adc_tc)(void) = 0;
+static void (*adc_tc_pending)(void) = 0;
+static uint64_t adc_tc_due = 0;
+static uint64_t adc_lost = 0;
+static bool adc_overrun_next = false;  //Conversions were lost, the next word read flags it
+
+//Stress mode
+static uint32_t irq_jitter = 0;
+static uint32_t jitter_state = 1;
+
+//DAC + DMA channel
+static uint32_t dac_period = 0;         //CCLK cycles per counter timeout, 0 while stopped
+static uint64_t dac_next = 0;           //Cycle of the next timeout
+static const uint32_t *dac_src = 0;
+static int dac_length = 0;
+static int dac_pos = 0;
+static void (*dac_tc)(void) = 0;
+static uint32_t dac_latency = 0;
+static void (*dac_tc_pending)(void) = 0;
+static uint64_t dac_tc_due = 0;
+static bool dac_buffered = false;       //DBLBUF_ENA: a word is waiting for the next timeout
+static uint32_t dac_buffer = 0;
+static bool dac_buffer_first = false;
+static uint16_t dac_value = 0;
+static std::vector<DacUpdate> *dac_log = 0;
+
+CaptureSource::CaptureSource() : fill(0), pos(0) {
+    reader.fp = 0;
+}
+
+CaptureSource::~CaptureSource() {
+    capture_close(&reader);
+}
+
+bool CaptureSource::open(const char *path) {
+    fill = pos = 0;
+    return capture_open(&reader, path);
+}
+
+bool CaptureSource::next(uint16_t *sample) {
+    if (pos == fill) {
+        fill = capture_read(&reader, buffer, CAPTURE_BLOCK_SAMPLES);
+        pos = 0;
+        if (fill == 0) return false;
+    }
+    *sample = buffer[pos++];
+    return true;
+}
+
+uint64_t sim_cycles(void) {
+    return now;
+}
+
+void sim_reset(void) {
+    now = 0;
+    finished = false;
+    adc_source = 0;
+    adc_rate = 0;
+    adc_conversions = 0;
+    adc_dst = 0;
+    adc_length = 0;
+    adc_tc = adc_tc_pending = 0;
+    adc_tc_due = 0;
+    adc_lost = 0;
+    adc_overrun_next = false;
+    irq_jitter = 0;
+    dac_period = 0;
+    dac_next = 0;
+    dac_src = 0;
+    dac_length = dac_pos = 0;
+    dac_tc = dac_tc_pending = 0;
+    dac_latency = 0;
+    dac_tc_due = 0;
+    dac_buffered = dac_buffer_first = false;
+    dac_buffer = 0;
+    dac_value = 0;
+    dac_log = 0;
+}
+
+void sim_adc_attach(SampleSource *source, uint32_t sample_rate) {
+    adc_source = source;
+    adc_rate = sample_rate;
+}
+
+void sim_adc_start(uint32_t *dst, int length, void (*tc)(void)) {
+    //Everything converted since the last transfer ended went nowhere
+    if (adc_source && adc_rate) {
+        uint64_t converted = now * adc_rate / CCLK_HZ;
+        uint16_t s;
+        for (; adc_conversions < converted; adc_conversions++) {
+            if (!adc_source->next(&s)) {
+                finished = true;
+                break;
+            }
+            adc_lost++;
+            adc_overrun_next = true;
+        }
+    }
+    adc_dst = dst;
+    adc_length = length;
+    adc_tc = tc;
+}
+
+void sim_dac_set_count(uint32_t daccntval) {
+    uint32_t period = daccntval * (uint32_t)(CCLK_HZ / DAC_PCLK_HZ);
+    if (!dac_period) dac_next = now + period;
+    dac_period = period;
+}
+
+void sim_dac_start(const uint32_t *src, int length, void (*tc)(void)) {
+    dac_src = src;
+    dac_length = length;
+    dac_pos = 0;
+    dac_tc = tc;
+}
+
+void sim_dac_set_irq_latency(uint32_t cycles) {
+    dac_latency = cycles;
+}
+
+void sim_set_irq_jitter(uint32_t max_cycles, uint32_t seed) {
+    irq_jitter = max_cycles;
+    jitter_state = seed ? seed : 1;
+}
+
+uint64_t sim_adc_lost(void) {
+    return adc_lost;
+}
+
+void sim_dac_record(std::vector<DacUpdate> *log) {
+    dac_log = log;
+}
+
+//xorshift32, 0..irq_jitter
+static uint32_t jitter(void) {
+    if (!irq_jitter) return 0;
+    jitter_state ^= jitter_state << 13;
+    jitter_state ^= jitter_state >> 17;
+    jitter_state ^= jitter_state << 5;
+    return (uint32_t)((uint64_t)jitter_state * (irq_jitter + 1ULL) >> 32);
+}
+
+//Counter timeout: the buffered word reaches the pin and the DMA request fetches the next
+static void dac_timeout(void) {
+    now = dac_next;
+    dac_next += dac_period;
+
+    uint8_t flags = 0;
+    if (dac_buffered) {
+        dac_value = DACR_VALUE(dac_buffer);
+        if (dac_buffer_first) flags |= DAC_UPDATE_FIRST;
+        dac_buffered = false;
+    } else {
+        flags |= DAC_UPDATE_HOLD;
+    }
+    if (dac_log) {
+        DacUpdate u = { now, dac_value, flags };
+        dac_log->push_back(u);
+    }
+
+    if (dac_src && dac_pos < dac_length) {
+        dac_buffer_first = dac_pos == 0;
+        dac_buffer = dac_src[dac_pos++];
+        dac_buffered = true;
+        if (dac_pos == dac_length) {
+            //Channel goes idle, its interrupt is serviced dac_latency cycles later
+            dac_src = 0;
+            dac_tc_pending = dac_tc;
+            dac_tc_due = now + dac_latency + jitter();
+        }
+    }
+}
+
+static void dac_complete(void) {
+    void (*tc)(void) = dac_tc_pending;
+    now = dac_tc_due;
+    dac_tc_pending = 0;
+    if (tc) tc();
+}
+
+//Fills the armed transfer and fires its terminal count callback
+static bool adc_complete(void) {
+    uint32_t *dst = adc_dst;
+    int length = adc_length;
+    adc_dst = 0;
+
+    for (int i = 0; i < length; i++) {
+        uint16_t s;
+        if (!adc_source->next(&s)) {
+            //A transfer that never completes never interrupts
+            finished = true;
+            return false;
+        }
+        dst[i] = ADC_WORD(s >> 12, s);
+    }
+    if (adc_overrun_next) dst[0] |= 1UL << 30;
+    adc_overrun_next = false;
+    adc_conversions += length;
+    now = adc_conversions * CCLK_HZ / adc_rate;
+
+    //With jitter the interrupt runs later, ordered against the DAC events like any other
+    uint32_t late = jitter();
+    if (late) {
+        adc_tc_pending = adc_tc;
+        adc_tc_due = now + late;
+        return true;
+    }
+    if (adc_tc) adc_tc();
+    return true;
+}
+
+static void adc_irq(void) {
+    void (*tc)(void) = adc_tc_pending;
+    now = adc_tc_due;
+    adc_tc_pending = 0;
+    if (tc) tc();
+}
+
+enum { EVENT_NONE, EVENT_DAC_TC, EVENT_DAC_TIMEOUT, EVENT_ADC_TC, EVENT_ADC_IRQ };
+
+//Whichever of the DMA interrupts and DAC timeouts is due first
+static int next_event(uint64_t *due) {
+    bool adc_armed = adc_dst && adc_source && adc_rate;
+    uint64_t adc_due = adc_armed ? (adc_conversions + adc_length) * CCLK_HZ / adc_rate : 0;
+
+    //A late ADC interrupt goes first when it is due before everything else
+    if (adc_tc_pending && (!adc_armed || adc_tc_due <= adc_due)
+        && (!dac_tc_pending || adc_tc_due <= dac_tc_due) && (!dac_period || adc_tc_due <= dac_next)) {
+        *due = adc_tc_due;
+        return EVENT_ADC_IRQ;
+    }
+
+    if (dac_tc_pending && (!adc_armed || dac_tc_due <= adc_due) && (!dac_period || dac_tc_due <= dac_next)) {
+        *due = dac_tc_due;
+        return EVENT_DAC_TC;
+    }
+    if (dac_period && (!adc_armed || dac_next < adc_due)) {
+        *due = dac_next;
+        return EVENT_DAC_TIMEOUT;
+    }
+    if (adc_armed) {
+        *due = adc_due;
+        return EVENT_ADC_TC;
+    }
+    return EVENT_NONE;
+}
+
+bool sim_advance(void) {
+    if (finished) return false;
+
+    uint64_t due;
+    switch (next_event(&due)) {
+    case EVENT_DAC_TC:
+        dac_complete();
+        return true;
+    case EVENT_DAC_TIMEOUT:
+        dac_timeout();
+        return true;
+    case EVENT_ADC_TC:
+        return adc_complete();
+    case EVENT_ADC_IRQ:
+        adc_irq();
+        return true;
+    default:
+        finished = true;
+        return false;
+    }
+}
+
+void sim_spend(uint32_t cycles) {
+    uint64_t until = now + cycles;
+    uint64_t due;
+    while (!finished && next_event(&due) != EVENT_NONE && due <= until) sim_advance();
+    if (now < until) now = until;
+}
+
+void sim_sleep(void) {
+    sim_advance();
+}
+
+bool sim_finished(void) {
+    return finished;
+}
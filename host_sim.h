@@ -0,0 +1,121 @@
+/*
+ * Host Simulator
+ * Objective: Run the firmware's capture and analysis code on a PC
+ *
+ * This stands in for the ADC + GPDMA pair. Instead of burst conversions it pulls
+ * samples from a SampleSource (a recorded capture, a synthetic signal, ...) and
+ * packs them into ADC result words exactly like the hardware does.
+ *
+ * It also stands in for the DAC + GPDMA pair on the output side. Every DACCNTVAL
+ * timeout the double buffered DACR word reaches the pin and the DMA fetches the
+ * next one, so each DACR write can be logged with the cycle it took effect.
+ * The terminal count callback runs after an optional interrupt latency; until it
+ * prepares the next buffer the DAC holds its last value, which is the gap a slow
+ * ping-pong handoff makes on real hardware.
+ *
+ * The ADC keeps converting while no transfer is armed, like the timer triggered
+ * ADC does. Those conversions are lost and the first word of the next transfer
+ * has OVERRUN set, so a slow re-arm shows up the way it would on the board.
+ *
+ * Stress mode: sim_set_irq_jitter() makes every DMA terminal count interrupt,
+ * ADC and DAC, run a random 0..max cycles late on top of any fixed latency, and
+ * sim_spend() in a handler stands for CPU load. See sim_stress for the search
+ * for where each configuration breaks.
+ *
+ * Time is counted in simulated CCLK cycles. Nothing happens between peripheral
+ * events, so sim_advance() jumps straight to the next one and fires its callback
+ * the way the DMA interrupt would. Install sim_sleep() with sched_set_sleep_hook()
+ * and the scheduler drives the simulation whenever the firmware would be in WFI.
+ *
+ * Host only, never built for the mbed.
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "capture.h"
+
+class SampleSource {
+public:
+    virtual ~SampleSource() {}
+    //Next conversion as (channel << 12) | 12 bit code, false once the source runs dry
+    virtual bool next(uint16_t *sample) = 0;
+};
+
+//Replays a capture file recorded with capture_start()
+class CaptureSource : public SampleSource {
+public:
+    CaptureSource();
+    ~CaptureSource();
+    bool open(const char *path);
+    const CaptureHeader &header() const { return reader.header; }
+    virtual bool next(uint16_t *sample);
+private:
+    CaptureReader reader;
+    uint16_t buffer[CAPTURE_BLOCK_SAMPLES];
+    int fill, pos;
+};
+
+//One DAC update as seen on AOUT
+struct DacUpdate {
+    uint64_t cycle;     //CCLK cycle of the counter timeout that moved VALUE to the pin
+    uint16_t value;     //10 bit VALUE field
+    uint8_t  flags;     //DAC_UPDATE_*
+};
+
+#define DAC_UPDATE_HOLD  1  //No DACR word was buffered, the previous value was held
+#define DAC_UPDATE_FIRST 2  //First word of a transfer, i.e. just after a buffer swap
+
+//Simulated CCLK cycles since sim_reset()
+uint64_t sim_cycles(void);
+
+//Forgets all peripherals and restarts the clock
+void sim_reset(void);
+
+//Connects the ADC input, sample_rate is the per-conversion rate the DMA sees
+void sim_adc_attach(SampleSource *source, uint32_t sample_rate);
+
+//Arms a peripheral to memory transfer of length ADC words, tc runs when it completes
+//Equivalent of dma.Setup()/dma.Enable() followed by setting the burst bit
+void sim_adc_start(uint32_t *dst, int length, void (*tc)(void));
+
+//LPC_DAC->DACCNTVAL, takes effect at the next counter reload
+//The first call also starts the counter (CNT_ENA)
+void sim_dac_set_count(uint32_t daccntval);
+
+//Equivalent of dac_dma.Prepare() on an m2p transfer of length DACR words to the DAC
+//src must stay valid until tc runs
+void sim_dac_start(const uint32_t *src, int length, void (*tc)(void));
+
+//CCLK cycles between the last word of a transfer leaving memory and its tc running
+void sim_dac_set_irq_latency(uint32_t cycles);
+
+//Extra 0..max_cycles, uniformly random from seed, before every DMA TC interrupt runs, 0 turns it off
+void sim_set_irq_jitter(uint32_t max_cycles, uint32_t seed);
+
+//Conversions lost since sim_reset() because no ADC transfer was armed
+uint64_t sim_adc_lost(void);
+
+//Appends every DAC update to log, 0 stops recording
+void sim_dac_record(std::vector<DacUpdate> *log);
+
+//Runs the next peripheral event, false once there is nothing left to simulate
+bool sim_advance(void);
+
+/*
+ * Lets cycles of simulated time pass as if the CPU were busy, e.g. to model the cost
+ * of a handler. Peripheral events due in that time still fire, like interrupts would.
+ */
+void sim_spend(uint32_t cycles);
+
+//Scheduler sleep hook, see sched_set_sleep_hook()
+void sim_sleep(void);
+
+//True once the ADC source has run dry, or nothing is running at all
+bool sim_finished(void);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * Buffered Binary Logger
+ * See logger.h for the file layout and the overflow policies
+ *
+ * The ring is LOGGER_BLOCKS blocks, filled at head and written from tail, like
+ * capture.cpp. Unlike the capture, records come from main context and from any
+ * ISR, so taking a slot is done with interrupts masked: a handful of loads and
+ * stores. The writer only masks them to pick the blocks and to retire them, never
+ * around the fwrite. While it writes, the blocks it took are off limits, so
+ * LOGGER_DROP_OLDEST can only take a block back from a writer that is not running.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "cycle_counter.h"
+#include "logger.h"
+#include "scheduler.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+#endif
+
+static FILE *out = 0;
+static LoggerPolicy policy = LOGGER_DROP_NEWEST;
+static LogRecord blocks[LOGGER_BLOCKS][LOGGER_BLOCK_RECORDS];
+static volatile int head = 0;       //Block being filled
+static volatile int tail = 0;       //Oldest full block
+static volatile int fill = 0;       //Records in blocks[head]
+static volatile int writing = 0;    //Blocks from tail the writer is busy with
+static volatile uint32_t lost = 0;  //Dropped since the last dropped record
+static uint16_t marks[LOGGER_BLOCKS];       //Dropped records in each block
+static uint32_t marked[LOGGER_BLOCKS];      //and the records they stand for
+static uint32_t written = 0;
+static volatile uint32_t dropped = 0;
+
+#ifdef TARGET_LPC1768
+
+//Nests, so logger_write() can be called with interrupts already off
+static inline uint32_t lock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static inline void unlock(uint32_t primask) {
+    if (!primask) __enable_irq();
+}
+
+#else
+
+//The host simulator calls "ISRs" from the same thread
+static inline uint32_t lock(void) { return 0; }
+static inline void unlock(uint32_t) {}
+
+#endif
+
+bool logger_start(const char *path, const char *const *names, int events, LoggerPolicy p) {
+    if (events < 0) events = 0;
+    if (events > LOGGER_MAX_EVENTS) events = LOGGER_MAX_EVENTS;
+    out = fopen(path, "wb");
+    if (!out) return false;
+
+    LoggerHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LOGGER_MAGIC, 4);
+    h.version     = LOGGER_VERSION;
+    h.header_size = sizeof(LoggerHeader) + events * LOGGER_NAME_LENGTH;
+    h.record_size = sizeof(LogRecord);
+    h.events      = events;
+    h.clock_hz    = CCLK_HZ;
+    h.timestamp   = (uint32_t)time(NULL);
+    fwrite(&h, sizeof(h), 1, out);
+    for (int i = 0; i < events; i++) {
+        char name[LOGGER_NAME_LENGTH];
+        memset(name, 0, sizeof(name));
+        if (names && names[i]) {
+            size_t n = strlen(names[i]);
+            memcpy(name, names[i], n < LOGGER_NAME_LENGTH ? n : LOGGER_NAME_LENGTH);
+        }
+        fwrite(name, LOGGER_NAME_LENGTH, 1, out);
+    }
+
+    policy = p;
+    head = tail = fill = writing = 0;
+    marks[0] = 0;
+    marked[0] = 0;
+    lost = written = dropped = 0;
+    return true;
+}
+
+//Free slot at head, 0 when the ring is full and the policy drops. Called locked
+static LogRecord *reserve(void) {
+    if (fill < LOGGER_BLOCK_RECORDS) return &blocks[head][fill++];
+
+    int next = (head + 1) % LOGGER_BLOCKS;
+    if (next == tail) {
+        if (policy != LOGGER_DROP_OLDEST || writing) return 0;
+        //Throw away the oldest full block to make room, and the gaps it was marking
+        int t = tail;
+        lost += LOGGER_BLOCK_RECORDS - marks[t] + marked[t];
+        dropped += LOGGER_BLOCK_RECORDS - marks[t];
+        tail = (t + 1) % LOGGER_BLOCKS;
+    }
+    head = next;
+    fill = 0;
+    marks[next] = 0;
+    marked[next] = 0;
+    sched_post(EVT_LOG_FLUSH);
+    return &blocks[head][fill++];
+}
+
+//Records how many were lost since the last mark, if there is room for it. Called locked
+static void mark_dropped(uint32_t now) {
+    LogRecord *r = reserve();
+    if (!r) return;
+    r->time = now;
+    r->event = LOGGER_EVENT_DROPPED;
+    r->channel = 0;
+    r->a = 0;
+    r->b = (int32_t)lost;
+    marks[head]++;
+    marked[head] += lost;
+    lost = 0;
+}
+
+void logger_write(uint8_t event, uint8_t channel, uint16_t a, int32_t b) {
+    uint32_t now = cycle_count();
+    uint32_t primask = lock();
+    if (!out) {
+        unlock(primask);
+        return;
+    }
+
+    //Mark the gap first, the record after it goes in too if there is room
+    if (lost) mark_dropped(now);
+    LogRecord *r = reserve();
+    if (!r && policy == LOGGER_FLUSH_INLINE) {
+        unlock(primask);
+        logger_flush_handler();
+        primask = lock();
+        r = reserve();
+    }
+    if (r) {
+        r->time = now;
+        r->event = event;
+        r->channel = channel;
+        r->a = a;
+        r->b = b;
+    } else {
+        lost++;
+        dropped++;
+    }
+    unlock(primask);
+}
+
+void logger_flush_handler(void) {
+    if (!out) return;
+    for (;;) {
+        //Full blocks from tail up to head, or to the end of the ring, in one fwrite
+        uint32_t primask = lock();
+        int start = tail;
+        int end = head < tail ? LOGGER_BLOCKS : head;
+        int count = end - start;
+        writing = count;
+        unlock(primask);
+        if (count == 0) return;
+
+        written += fwrite(blocks[start], sizeof(LogRecord), count * LOGGER_BLOCK_RECORDS, out);
+
+        primask = lock();
+        tail = end % LOGGER_BLOCKS;
+        writing = 0;
+        unlock(primask);
+    }
+}
+
+void logger_stop(void) {
+    if (!out) return;
+    //Room for the last dropped record, then it goes out with the rest
+    logger_flush_handler();
+    uint32_t primask = lock();
+    if (lost) mark_dropped(cycle_count());
+    unlock(primask);
+    logger_flush_handler();
+    primask = lock();
+    FILE *fp = out;
+    out = 0;
+    int n = fill;
+    fill = 0;
+    unlock(primask);
+    written += fwrite(blocks[head], sizeof(LogRecord), n, fp);
+    fclose(fp);
+}
+
+uint32_t logger_records_written(void) {
+    return written;
+}
+
+uint32_t logger_records_dropped(void) {
+    return dropped;
+}
+
+bool logger_open(LoggerReader *reader, const char *path) {
+    reader->fp = fopen(path, "rb");
+    if (!reader->fp) return false;
+
+    LoggerHeader *h = &reader->header;
+    if (fread(h, sizeof(LoggerHeader), 1, reader->fp) != 1
+        || memcmp(h->magic, LOGGER_MAGIC, 4) != 0
+        || h->record_size < sizeof(LogRecord)
+        || h->header_size < sizeof(LoggerHeader) + h->events * LOGGER_NAME_LENGTH) {
+        fclose(reader->fp);
+        reader->fp = 0;
+        return false;
+    }
+
+    memset(reader->names, 0, sizeof(reader->names));
+    for (int i = 0; i < h->events; i++) {
+        char name[LOGGER_NAME_LENGTH];
+        if (fread(name, LOGGER_NAME_LENGTH, 1, reader->fp) != 1) break;
+        if (i < LOGGER_MAX_EVENTS) memcpy(reader->names[i], name, LOGGER_NAME_LENGTH);
+    }
+
+    //Newer versions may grow the header or the records, skip what we do not understand
+    fseek(reader->fp, h->header_size, SEEK_SET);
+    return true;
+}
+
+bool logger_read(LoggerReader *reader, LogRecord *record) {
+    if (fread(record, sizeof(LogRecord), 1, reader->fp) != 1) return false;
+    if (reader->header.record_size > sizeof(LogRecord)) {
+        fseek(reader->fp, reader->header.record_size - sizeof(LogRecord), SEEK_CUR);
+    }
+    return true;
+}
+
+const char *logger_event_name(const LoggerReader *reader, int event) {
+    if (event == LOGGER_EVENT_DROPPED) return "dropped";
+    if (event < 0 || event >= LOGGER_MAX_EVENTS || !reader->names[event][0]) return "?";
+    return reader->names[event];
+}
+
+void logger_close(LoggerReader *reader) {
+    if (reader->fp) fclose(reader->fp);
+    reader->fp = 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Buffered Binary Logger
+ * Objective: Log from anywhere, the real-time path included, without touching the file system there
+ *
+ * fprintf to /local costs milliseconds a line (semihosting halts the core for each
+ * call), so logging a buffer a line per sample took seconds and stalled everything.
+ * Here a log entry is one fixed 12 byte record, copied into a RAM ring in a few
+ * dozen cycles with interrupts masked, from main context or any ISR:
+ *
+ *   LoggerHeader (32 bytes + events * LOGGER_NAME_LENGTH names)
+ *   LogRecord[...]   u32 cycle_count(), u8 event, u8 channel, u16 a, s32 b
+ *
+ * The ring is LOGGER_BLOCKS blocks of LOGGER_BLOCK_RECORDS records (~2KB). A block
+ * that fills posts EVT_LOG_FLUSH, the lowest priority event, so the file is only
+ * written once nothing else is pending, as few large fwrites as the full blocks allow.
+ *
+ * What happens when the ring is full is the overflow policy given to logger_start():
+ *
+ *   LOGGER_DROP_NEWEST   the new record is dropped, what is queued survives
+ *   LOGGER_DROP_OLDEST   the oldest full block not being written is dropped
+ *   LOGGER_FLUSH_INLINE  the writer runs there and then; main context only, for
+ *                        debug dumps with no deadline to miss
+ *
+ * Either drop leaves a LOGGER_EVENT_DROPPED record (b = records lost) in the stream
+ * at the next record that fits, so a gap is never silent. With a drop policy
+ * logging can stay on in production: the worst it does is lose log records.
+ *
+ * Event numbers are the caller's, with names stored in the header so logger_dump
+ * can print them. LocalFileSystem only knows 8.3 names, e.g. "/local/ADCLOG.THL"
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOGGER_MAGIC   "THLG"
+#define LOGGER_VERSION 1
+
+#define LOGGER_BLOCK_RECORDS 170    //2040 bytes per block
+#ifndef LOGGER_BLOCKS
+#define LOGGER_BLOCKS 4             //~8KB of RAM
+#endif
+#define LOGGER_NAME_LENGTH 16       //Per event name in the header, NUL padded
+#define LOGGER_MAX_EVENTS 32
+#define LOGGER_EVENT_DROPPED 255    //Written by the logger, b is how many records were lost
+
+enum LoggerPolicy {
+    LOGGER_DROP_NEWEST = 0,
+    LOGGER_DROP_OLDEST,
+    LOGGER_FLUSH_INLINE
+};
+
+struct LoggerHeader {
+    char     magic[4];          //"THLG"
+    uint16_t version;           //LOGGER_VERSION
+    uint16_t header_size;       //Records start here, names included
+    uint16_t record_size;       //sizeof(LogRecord)
+    uint16_t events;            //Names that follow this header
+    uint32_t clock_hz;          //Cycles a second of LogRecord.time
+    uint32_t timestamp;         //RTC seconds since 1970 when the log started
+    uint32_t reserved[3];
+};
+
+struct LogRecord {
+    uint32_t time;              //cycle_count()
+    uint8_t  event;
+    uint8_t  channel;
+    uint16_t a;
+    int32_t  b;
+};
+
+/*
+ * Logging
+ */
+
+//Opens the file and writes the header with names[0..events-1], false if it could not be created
+bool logger_start(const char *path, const char *const *names, int events, LoggerPolicy policy);
+
+//Queues one record, never blocks unless the policy is LOGGER_FLUSH_INLINE
+void logger_write(uint8_t event, uint8_t channel, uint16_t a, int32_t b);
+
+//EVT_LOG_FLUSH handler, writes out every full block
+void logger_flush_handler(void);
+
+//Writes whatever is left, including a partial block, and closes the file
+void logger_stop(void);
+
+//Records written to the file and dropped since logger_start()
+uint32_t logger_records_written(void);
+uint32_t logger_records_dropped(void);
+
+/*
+ * Reading, on the PC
+ */
+
+struct LoggerReader {
+    FILE        *fp;
+    LoggerHeader header;
+    char         names[LOGGER_MAX_EVENTS][LOGGER_NAME_LENGTH + 1];
+};
+
+//Opens a log and reads its header and names, false if it is not a log file
+bool logger_open(LoggerReader *reader, const char *path);
+
+//Next record, false at the end of the file
+bool logger_read(LoggerReader *reader, LogRecord *record);
+
+//Name of an event, "dropped" for LOGGER_EVENT_DROPPED and "?" for an unnamed one
+const char *logger_event_name(const LoggerReader *reader, int event);
+
+void logger_close(LoggerReader *reader);
+
+#endif
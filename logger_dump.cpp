@@ -0,0 +1,59 @@
+/*
+ * Log Dump
+ * Objective: Turn a binary log from logger.h into CSV
+ *
+ * Host only. Build:
+ *   g++ -O2 -o logger_dump logger_dump.cpp logger.cpp scheduler.cpp
+ *
+ * Usage: logger_dump ADCLOG.THL [out.csv]    (stdout by default)
+ *
+ * One row per record: seconds from the first record (cycle_count() wraps every
+ * ~44s at 96MHz, the wraps are counted back in as long as no two records are
+ * further apart than that), event name, channel, a and b.
+ * Gaps the logger dropped are rows named "dropped" with b the records lost, and
+ * the totals go to stderr.
+ */
+
+#include <stdio.h>
+
+#include "logger.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s ADCLOG.THL [out.csv]\n", argv[0]);
+        return 1;
+    }
+    LoggerReader reader;
+    if (!logger_open(&reader, argv[1])) {
+        fprintf(stderr, "%s is not a log file\n", argv[1]);
+        return 1;
+    }
+    FILE *csv = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!csv) {
+        fprintf(stderr, "cannot create %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(csv, "time_s,event,channel,a,b\n");
+    LogRecord r;
+    uint32_t last = 0, records = 0, gaps = 0, lost = 0;
+    uint64_t elapsed = 0;
+    while (logger_read(&reader, &r)) {
+        if (records == 0) last = r.time;
+        elapsed += (uint32_t)(r.time - last);
+        last = r.time;
+        records++;
+        if (r.event == LOGGER_EVENT_DROPPED) {
+            gaps++;
+            lost += r.b;
+        }
+        fprintf(csv, "%.6f,%s,%u,%u,%d\n", (double)elapsed / reader.header.clock_hz,
+            logger_event_name(&reader, r.event), r.channel, r.a, r.b);
+    }
+
+    fprintf(stderr, "%u records over %.3f s, %u gaps, %u records dropped\n",
+        records, (double)elapsed / reader.header.clock_hz, gaps, lost);
+    if (csv != stdout) fclose(csv);
+    logger_close(&reader);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Logger Stress Test
+ * Objective: Show each overflow policy loses only what it says, and says so in the file
+ *
+ * Host only. Records come in bursts much faster than the writer drains them, the
+ * way a DMA block handler logging every sample would, and the writer only runs
+ * between bursts, as EVT_LOG_FLUSH would at idle. Every record carries its
+ * sequence number in b, so the file can be checked against what was logged:
+ *
+ *   sequence numbers only ever go up
+ *   records in the file + records the "dropped" rows stand for == records logged
+ *   LOGGER_DROP_NEWEST   each gap is right after the dropped row covering it
+ *   LOGGER_FLUSH_INLINE  nothing is lost
+ *
+ * Build:
+ *   g++ -O2 -o logger_stress logger_stress.cpp logger.cpp scheduler.cpp
+ *
+ * Usage: logger_stress [records]    (default 100000)
+ *
+ * Also reports the host cycles per logger_write(); the exit code is the number of failed checks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cycle_counter.h"
+#include "logger.h"
+
+#define STRESS_FILE "logger_stress.thl"
+
+static const char *const names[] = { "sample", "marker" };
+static const char *const policy_names[] = { "drop_newest", "drop_oldest", "flush_inline" };
+
+static int run(LoggerPolicy policy, uint32_t total) {
+    if (!logger_start(STRESS_FILE, names, 2, policy)) {
+        fprintf(stderr, "cannot create %s\n", STRESS_FILE);
+        return 1;
+    }
+    //Bursts of 1..3 rings' worth, the writer catching up after every other one
+    uint32_t ring = LOGGER_BLOCKS * LOGGER_BLOCK_RECORDS;
+    uint32_t seq = 0, burst = 0;
+    uint64_t cycles = 0;
+    while (seq < total) {
+        uint32_t n = ring * (1 + burst % 3) / 2;
+        uint32_t start = cycle_count();
+        for (uint32_t i = 0; i < n && seq < total; i++, seq++) logger_write(0, (uint8_t)(seq & 1), (uint16_t)seq, (int32_t)seq);
+        cycles += cycle_count() - start;
+        if (burst++ & 1) logger_flush_handler();
+    }
+    logger_stop();
+
+    LoggerReader reader;
+    if (!logger_open(&reader, STRESS_FILE)) {
+        fprintf(stderr, "cannot read %s back\n", STRESS_FILE);
+        return 1;
+    }
+    LogRecord r;
+    int32_t expect = 0, last = -1;
+    uint32_t kept = 0, stood_for = 0, gaps = 0, misplaced = 0, backwards = 0, pending = 0;
+    while (logger_read(&reader, &r)) {
+        if (r.event == LOGGER_EVENT_DROPPED) {
+            gaps++;
+            stood_for += r.b;
+            pending += r.b;
+            continue;
+        }
+        if (r.b <= last) backwards++;
+        if (r.b != expect) {
+            if (policy != LOGGER_DROP_OLDEST && (uint32_t)(r.b - expect) != pending) misplaced++;
+        }
+        pending = 0;
+        last = r.b;
+        expect = r.b + 1;
+        kept++;
+    }
+    logger_close(&reader);
+    remove(STRESS_FILE);
+
+    int failed = 0;
+    if (backwards) failed++;
+    if (kept + stood_for != total) failed++;
+    if (misplaced) failed++;
+    if (policy == LOGGER_FLUSH_INLINE && kept != total) failed++;
+    if (logger_records_dropped() != total - kept) failed++;
+
+    printf("%-13s %8u %8u %6u %8u %8u %9u %7.1f %s\n", policy_names[policy], total, kept, gaps,
+        stood_for, backwards, misplaced, (double)cycles / total, failed ? "FAIL" : "ok");
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    uint32_t total = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    printf("ring %u blocks of %u records, %u bytes\n", LOGGER_BLOCKS, LOGGER_BLOCK_RECORDS,
+        (unsigned)(LOGGER_BLOCKS * LOGGER_BLOCK_RECORDS * sizeof(LogRecord)));
+    printf("policy          logged     kept   gaps  dropped backwards misplaced  cycles\n");
+    int failed = 0;
+    failed += run(LOGGER_DROP_NEWEST, total);
+    failed += run(LOGGER_DROP_OLDEST, total);
+    failed += run(LOGGER_FLUSH_INLINE, total);
+    return failed;
+}
@@ -0,0 +1,135 @@
+/*
+ * MIDI Output
+ * See midi_out.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixed_math.h"
+#include "midi_out.h"
+
+#define MIDI_NOTE_ON 0x90
+#define MIDI_CONTROL 0xB0
+#define MIDI_BEND    0xE0
+
+void midi_init(MidiOut *m, int channel, int bend_range, int controller, uint32_t min_interval) {
+    memset(m, 0, sizeof(*m));
+    m->channel = (uint8_t)(channel & 15);
+    m->controller = (uint8_t)(controller & 127);
+    m->bend_range = bend_range > 0 ? bend_range : 2;
+    //One cent either way at 2 semitones, well under what anyone hears
+    m->bend_deadband = 8192 / (100 * m->bend_range);
+    m->min_interval = min_interval;
+    m->want_note = m->note = -1;
+    m->want_bend = m->bend = 8192;
+}
+
+int32_t midi_note_q8(uint32_t freq_q8) {
+    //2^(k/12) in Q16, one more for the top of the octave
+    static const uint32_t ratio[13] = {
+        65536, 69433, 73562, 77936, 82570, 87480, 92682, 98193, 104032, 110218, 116772, 123715, 131072
+    };
+    //Ratio to A4 in Q32, then octaves off it and the semitone within the octave in Q16
+    uint64_t x = ((uint64_t)freq_q8 << 32) / (440 * 256);
+    if (x >> 16 == 0) return 0;
+    int top = x >> 32 ? 63 - clz32((uint32_t)(x >> 32)) : 31 - clz32((uint32_t)x);
+    int e = top - 32;
+    if (e > 10) return 127 << 8;
+    uint32_t r = (uint32_t)(x >> (e + 16));
+    int k = 0;
+    while (k < 11 && r >= ratio[k + 1]) k++;
+    //Linear between the semitones, bowed by the log curve's 0.7 cent sag at the middle
+    uint32_t span = ratio[k + 1] - ratio[k];
+    int32_t frac = (int32_t)(((r - ratio[k]) * 256 + span / 2) / span);
+    frac += frac * (256 - frac) * 29 / 262144;
+    return (69 + 12 * e + k) * 256 + frac;
+}
+
+int midi_level_value(uint32_t level_q15, uint32_t gate_q15) {
+    if (gate_q15 == 0) gate_q15 = 1;
+    if (level_q15 <= gate_q15) return 0;
+    //60dB is 9.97 octaves, 2552 in Q8
+    int32_t v = (log2_q8(level_q15) - log2_q8(gate_q15)) * 127 / 2552;
+    return v > 127 ? 127 : v < 0 ? 0 : v;
+}
+
+void midi_update(MidiOut *m, uint32_t freq_q8, int value, uint32_t stamp) {
+    if (m->pending) m->stats.coalesced++;
+    if (freq_q8 == 0) {
+        m->want_note = -1;
+    } else {
+        int32_t s = midi_note_q8(freq_q8);
+        int n = m->want_note;
+        //Keep the note while the bend can still reach, with half a semitone to spare
+        if (n < 0 || abs(s - n * 256) > m->bend_range * 256 - 128) n = (s + 128) >> 8;
+        if (n < 0) n = 0;
+        if (n > 127) n = 127;
+        int32_t bend = 8192 + (s - n * 256) * 8192 / (m->bend_range * 256);
+        m->want_note = n;
+        m->want_bend = bend < 0 ? 0 : bend > 16383 ? 16383 : bend;
+    }
+    m->want_value = value < 0 ? 0 : value > 127 ? 127 : value;
+    m->stamp = stamp;
+    m->pending = true;
+}
+
+static void put(MidiOut *m, uint8_t status, int d1, int d2, uint32_t now) {
+    int n = 0;
+    if (status != m->status) m->msg[n++] = status;
+    else m->stats.running++;
+    m->msg[n++] = (uint8_t)(d1 & 127);
+    m->msg[n++] = (uint8_t)(d2 & 127);
+    m->status = status;
+    m->length = n;
+    m->pos = 0;
+    m->stats.messages++;
+    m->pending = false;     //Some of the update is out, a newer one no longer replaces it whole
+
+    uint32_t latency = now - m->stamp;
+    m->stats.latency_count++;
+    m->stats.latency_total += latency;
+    if (latency > m->stats.latency_max) m->stats.latency_max = latency;
+}
+
+//Puts the most urgent difference into msg, false when there is none
+static bool compose(MidiOut *m, uint32_t now) {
+    uint8_t ch = m->channel;
+    if (m->note >= 0 && m->want_note != m->note) {
+        put(m, MIDI_NOTE_ON | ch, m->note, 0, now);
+        m->note = -1;
+    } else if (m->want_note >= 0 && m->note < 0 && m->want_bend != m->bend) {
+        put(m, MIDI_BEND | ch, m->want_bend, m->want_bend >> 7, now);
+        m->bend = m->want_bend;
+        m->bend_at = now;
+    } else if (m->want_note >= 0 && m->note < 0) {
+        put(m, MIDI_NOTE_ON | ch, m->want_note, m->want_value ? m->want_value : 1, now);
+        m->note = m->want_note;
+    } else if (m->note >= 0 && abs(m->want_bend - m->bend) > m->bend_deadband
+               && now - m->bend_at >= m->min_interval) {
+        put(m, MIDI_BEND | ch, m->want_bend, m->want_bend >> 7, now);
+        m->bend = m->want_bend;
+        m->bend_at = now;
+    } else if (m->want_value != m->value && now - m->value_at >= m->min_interval) {
+        put(m, MIDI_CONTROL | ch, m->controller, m->want_value, now);
+        m->value = m->want_value;
+        m->value_at = now;
+    } else {
+        //Up to date, or a rate limit holds and the next update retries
+        m->held = (m->note >= 0 && abs(m->want_bend - m->bend) > m->bend_deadband) || m->want_value != m->value;
+        if (!m->held) m->pending = false;
+        return false;
+    }
+    return true;
+}
+
+int midi_next_byte(MidiOut *m, uint32_t now) {
+    if (!midi_busy(m) && !compose(m, now)) return -1;
+    m->stats.bytes++;
+    return m->msg[m->pos++];
+}
+
+void midi_stats(MidiOut *m, MidiStats *out, bool reset) {
+    *out = m->stats;
+    if (reset) memset(&m->stats, 0, sizeof(m->stats));
+}
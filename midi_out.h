@@ -0,0 +1,101 @@
+/*
+ * MIDI Output
+ * Objective: Play an external synth from the detected pitch and level
+ *
+ * Each analysis result sets what the receiver should be doing: a note, a 14 bit
+ * pitch bend from that note to the exact pitch, and a controller for the volume.
+ * Nothing is queued. The UART asks for one byte at a time (midi_next_byte() from
+ * its TX interrupt, the FIFO holds at most one byte), and a message is only put
+ * together when its first byte is due, from the newest state. A result that
+ * arrives while the wire is busy replaces the one before it, so at 31250 baud
+ * (320us a byte) the link runs as fast as it can and never plays stale data.
+ *
+ * In order of priority:
+ *
+ *   note off     the note changed or the voice stopped (note on, velocity 0)
+ *   pitch bend   before a note on, so the note starts in tune
+ *   note on      velocity from the volume
+ *   pitch bend   moved more than bend_deadband, at most every min_interval cycles
+ *   controller   changed, at most every min_interval cycles
+ *
+ * A note is held while the pitch stays within bend_range semitones of it less
+ * half a semitone, so a glide is one bend stream, not a run of notes.
+ * Note offs are note ons with velocity 0 so every message but the controller
+ * shares status 0x9n or 0xEn, and running status drops the repeated status bytes.
+ *
+ * Latency is from the stamp given to midi_update() to the first byte of the
+ * message carrying it going into the UART, in cycle_count() cycles.
+ */
+
+#ifndef MIDI_OUT_H
+#define MIDI_OUT_H
+
+#include <stdint.h>
+
+#define MIDI_BAUD 31250
+
+struct MidiStats {
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t running;           //Status bytes left out
+    uint32_t coalesced;         //Updates replaced before any of them went out
+    uint32_t latency_count;     //Messages timed
+    uint64_t latency_total;
+    uint32_t latency_max;
+};
+
+struct MidiOut {
+    //Settings
+    uint8_t  channel;           //0..15
+    uint8_t  controller;        //7 channel volume, 11 expression
+    int      bend_range;        //Semitones either way, as set on the receiver
+    int      bend_deadband;     //Bend steps not worth a message
+    uint32_t min_interval;      //Cycles between two bends, or two controller values
+    //Wanted, from the newest midi_update()
+    int      want_note;         //-1 when silent
+    int      want_bend;         //0..16383, 8192 centre
+    int      want_value;        //Controller 0..127
+    uint32_t stamp;
+    bool     pending;           //No message from the newest update has gone out yet
+    bool     held;              //A rate limit held back the rest, when last nothing could go out
+    //What the receiver has
+    int      note;
+    int      bend;
+    int      value;
+    uint8_t  status;            //Last status byte sent, 0 for none
+    uint32_t bend_at;           //When the last bend and controller went out
+    uint32_t value_at;
+    //The message going out
+    uint8_t  msg[3];
+    int      length;
+    int      pos;
+    MidiStats stats;
+};
+
+//controller 7 or 11 usually, min_interval in cycles (0 for as fast as the wire)
+void midi_init(MidiOut *m, int channel, int bend_range, int controller, uint32_t min_interval);
+
+//Note number in Q8 semitones, 69 << 8 is 440Hz, from Hz * 256 (not 0). Within a cent
+int32_t midi_note_q8(uint32_t freq_q8);
+
+//RMS level in Q15 to 0..127 over the 60dB above gate (log2 steps, ~0.5dB)
+int midi_level_value(uint32_t level_q15, uint32_t gate_q15);
+
+/*
+ * Newest result: pitch in Hz * 256, 0 for silence; value 0..127; stamp in cycle_count() cycles
+ * With the UART TX interrupt off, it shares the wanted state with midi_next_byte()
+ */
+void midi_update(MidiOut *m, uint32_t freq_q8, int value, uint32_t stamp);
+
+//Next byte for the UART, -1 when the receiver is up to date (or a rate limit holds)
+int midi_next_byte(MidiOut *m, uint32_t now);
+
+//True while a message is part way out
+static inline bool midi_busy(const MidiOut *m) {
+    return m->pos < m->length;
+}
+
+//Copies the statistics, reset starts a new window
+void midi_stats(MidiOut *m, MidiStats *out, bool reset);
+
+#endif
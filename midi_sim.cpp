@@ -0,0 +1,176 @@
+/*
+ * MIDI Output Simulation
+ * Objective: Show the MIDI link keeps up with the analysis, and how late and how close it plays
+ *
+ * Host only. Feeds midi_out.h what adc_fft.cpp would: one result per analysis
+ * block, from a scripted performance (a slow glide with vibrato and volume
+ * swells, a fast run of leaps, breaths of silence). The UART is modelled as on
+ * the LPC1768: a holding register and a shift register, a byte every 320us at
+ * 31250 baud, the TX interrupt asking for a byte whenever the holding register
+ * empties. A receiver decodes the bytes as they finish on the wire.
+ *
+ * Build:
+ *   g++ -O2 -o midi_sim midi_sim.cpp midi_out.cpp
+ *
+ * Usage: midi_sim [seconds]    (default 10)
+ *
+ * For each block size and rate limit it reports messages and bytes a second, how
+ * many status bytes running status saved and how many results were coalesced,
+ * detection to UART latency (mean and worst, midi_out.h), the worst detection to
+ * last byte received, and how far the receiver's pitch was from the wanted one
+ * at each block (RMS and worst cents, while both sound the same note).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cycle_counter.h"
+#include "midi_out.h"
+
+#define SIM_RATE 48000
+#define BYTE_CYCLES (CCLK_HZ / (MIDI_BAUD / 10))   //Start, 8 data, stop
+#define BEND_RANGE 2
+
+//The performance: pitch in Hz (0 silent) and volume 0..127 at time t
+static void perform(double t, double *hz, int *value) {
+    double phrase = fmod(t, 5.0);
+    if (phrase < 2.5) {
+        //Glide up two octaves with 6Hz vibrato of 30 cents, swelling
+        double semis = 24 * phrase / 2.5 + 0.3 * sin(2 * M_PI * 6 * t);
+        *hz = 110 * pow(2, semis / 12);
+        *value = (int)(64 + 60 * sin(M_PI * phrase / 2.5));
+    } else if (phrase < 4.5) {
+        //Leaps of a fifth or an octave every 125ms
+        static const int steps[] = { 0, 7, 12, 5, 17, 9, 24, 2 };
+        *hz = 220 * pow(2, steps[(int)(phrase * 8) % 8] / 12.0);
+        *value = 100;
+    } else {
+        *hz = 0;
+        *value = 0;
+    }
+}
+
+//What the receiver makes of the bytes
+struct Receiver {
+    int status, data[2], have;
+    int note, bend;
+};
+
+static void receive(Receiver *r, uint8_t b) {
+    if (b & 0x80) {
+        r->status = b;
+        r->have = 0;
+        return;
+    }
+    r->data[r->have++] = b;
+    if (r->have < 2) return;
+    r->have = 0;
+    switch (r->status & 0xF0) {
+    case 0x90:
+        if (r->data[1]) r->note = r->data[0];
+        else if (r->data[0] == r->note) r->note = -1;
+        break;
+    case 0xE0:
+        r->bend = r->data[0] | (r->data[1] << 7);
+        break;
+    }
+}
+
+struct Uart {
+    int thr;                //-1 empty
+    int tsr;                //-1 idle
+    uint64_t tsr_done;      //When the byte in the shift register is out
+};
+
+static MidiOut midi;
+static Uart uart;
+static Receiver rx;
+
+//TX interrupt: the holding register emptied, take a byte if there is one
+static void tx_isr(uint64_t now) {
+    if (uart.thr >= 0) return;
+    int b = midi_next_byte(&midi, (uint32_t)now);
+    if (b < 0) return;
+    uart.thr = b;
+    if (uart.tsr < 0) {
+        uart.tsr = uart.thr;
+        uart.thr = -1;
+        uart.tsr_done = now + BYTE_CYCLES;
+        tx_isr(now);
+    }
+}
+
+//Runs the wire up to now
+static void wire(uint64_t now, uint64_t *last_received) {
+    while (uart.tsr >= 0 && uart.tsr_done <= now) {
+        uint64_t t = uart.tsr_done;
+        receive(&rx, (uint8_t)uart.tsr);
+        *last_received = t;
+        uart.tsr = uart.thr;
+        uart.thr = -1;
+        if (uart.tsr >= 0) uart.tsr_done = t + BYTE_CYCLES;
+        tx_isr(t);
+    }
+}
+
+static void run(double seconds, int block, double interval_ms) {
+    midi_init(&midi, 0, BEND_RANGE, 7, (uint32_t)(interval_ms * CCLK_HZ / 1000));
+    uart.thr = uart.tsr = -1;
+    rx.status = rx.have = 0;
+    rx.note = -1;
+    rx.bend = 8192;
+
+    uint64_t block_cycles = (uint64_t)CCLK_HZ * block / SIM_RATE;
+    uint64_t end = (uint64_t)(seconds * CCLK_HZ);
+    uint64_t last_received = 0, last_stamp = 0, worst_received = 0;
+    double err2 = 0, worst_cents = 0;
+    int compared = 0, blocks = 0;
+
+    for (uint64_t now = block_cycles; now < end; now += block_cycles) {
+        wire(now, &last_received);
+
+        //What the receiver plays now, against what the last result asked for
+        if (blocks && rx.note >= 0 && rx.note == midi.want_note) {
+            double played = rx.note + (rx.bend - 8192) * (double)BEND_RANGE / 8192;
+            double wanted = midi.want_note + (midi.want_bend - 8192) * (double)BEND_RANGE / 8192;
+            double cents = 100 * fabs(played - wanted);
+            err2 += cents * cents;
+            if (cents > worst_cents) worst_cents = cents;
+            compared++;
+        }
+        //The previous result is fully received once the wire went quiet after it
+        if (uart.tsr < 0 && blocks && last_received > last_stamp && last_received - last_stamp > worst_received) {
+            worst_received = last_received - last_stamp;
+        }
+
+        double hz;
+        int value;
+        perform((double)now / CCLK_HZ, &hz, &value);
+        midi_update(&midi, (uint32_t)(hz * 256), value, (uint32_t)now);
+        last_stamp = now;
+        tx_isr(now);
+        blocks++;
+    }
+
+    MidiStats st;
+    midi_stats(&midi, &st, false);
+    printf("%5d %6.1f %5.1f %8.0f %7.0f %8.1f%% %8.1f%% %8.0f %8.0f %8.0f %7.2f %7.2f\n",
+        block, block * 1000.0 / SIM_RATE, interval_ms, st.messages / seconds, st.bytes / seconds,
+        100.0 * st.running / (st.messages ? st.messages : 1), 100.0 * st.coalesced / blocks,
+        st.latency_count ? st.latency_total * 1e6 / CCLK_HZ / st.latency_count : 0.0,
+        st.latency_max * 1e6 / CCLK_HZ, worst_received * 1e6 / CCLK_HZ,
+        compared ? sqrt(err2 / compared) : 0.0, worst_cents);
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    printf("link %u baud, %u us a byte, bend range %d semitones\n", MIDI_BAUD, (unsigned)(BYTE_CYCLES * 1000000ULL / CCLK_HZ), BEND_RANGE);
+    printf("block     ms limit   msgs/s bytes/s  running coalesced  mean_us   max_us  recv_us  rms_c  worst_c\n");
+    static const int blocks[] = { 256, 1024 };
+    static const double limits[] = { 0, 2, 10 };
+    for (int b = 0; b < 2; b++) {
+        for (int l = 0; l < 3; l++) run(seconds, blocks[b], limits[l]);
+    }
+    return 0;
+}
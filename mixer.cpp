@@ -0,0 +1,116 @@
+/*
+ * Polyphonic Mixer
+ * See mixer.h
+ */
+
+#include <string.h>
+
+#include "cycle_counter.h"
+#include "dds.h"
+#include "mixer.h"
+
+void mixer_init(Mixer *m, const int16_t *table, int bits) {
+    m->table = table;
+    m->bits = bits;
+    m->voices = 0;
+}
+
+int mixer_add_voice(Mixer *m, uint32_t freq_q8, uint32_t sample_rate, int16_t gain) {
+    if (m->voices == MIXER_MAX_VOICES) return -1;
+    int v = m->voices++;
+    m->phase[v] = 0;
+    mixer_set_voice(m, v, freq_q8, sample_rate, gain);
+    return v;
+}
+
+void mixer_set_voice(Mixer *m, int voice, uint32_t freq_q8, uint32_t sample_rate, int16_t gain) {
+    m->step[voice] = (uint32_t)(((uint64_t)freq_q8 << 24) / sample_rate);
+    m->gain[voice] = gain;
+}
+
+void mixer_remove_voice(Mixer *m, int voice) {
+    if (voice < 0 || voice >= m->voices) return;
+    int last = --m->voices;
+    m->phase[voice] = m->phase[last];
+    m->step[voice] = m->step[last];
+    m->gain[voice] = m->gain[last];
+}
+
+//One voice over the block, added into mix, four samples a pass
+static void add_voice(int32_t *mix, int count, const int16_t *t, int shift,
+                      uint32_t *phase_io, uint32_t step, int32_t gain) {
+    uint32_t phase = *phase_io;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        mix[i]     += (dds_linear(t, phase, shift) * gain) >> 15; phase += step;
+        mix[i + 1] += (dds_linear(t, phase, shift) * gain) >> 15; phase += step;
+        mix[i + 2] += (dds_linear(t, phase, shift) * gain) >> 15; phase += step;
+        mix[i + 3] += (dds_linear(t, phase, shift) * gain) >> 15; phase += step;
+    }
+    for (; i < count; i++) {
+        mix[i] += (dds_linear(t, phase, shift) * gain) >> 15; phase += step;
+    }
+    *phase_io = phase;
+}
+
+void mixer_render_mix(Mixer *m, int count) {
+    int32_t *mix = m->mix;
+    int shift = 32 - m->bits;
+
+    for (int i = 0; i < count; i++) mix[i] = 0;
+    for (int v = 0; v < m->voices; v++) add_voice(mix, count, m->table, shift, &m->phase[v], m->step[v], m->gain[v]);
+}
+
+void mixer_render(Mixer *m, uint32_t *dacr, int count) {
+    while (count > 0) {
+        int n = count < MIXER_MAX_BLOCK ? count : MIXER_MAX_BLOCK;
+        mixer_render_mix(m, n);
+        for (int i = 0; i < n; i++) dacr[i] = dds_dacr(m->mix[i]);
+        dacr += n;
+        count -= n;
+    }
+}
+
+//Best of a few renders, so an interrupt landing in one does not count
+static uint32_t time_render(Mixer *m, uint32_t *scratch, int block) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int k = 0; k < 8; k++) {
+        uint32_t start = cycle_count();
+        mixer_render(m, scratch, block);
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+void mixer_fit(Mixer *m, uint32_t *scratch, int block, uint32_t sample_rate, int budget_percent, MixerFit *fit) {
+    //Only the voice arrays, a whole Mixer is too big for the M3 stack
+    uint32_t phase[MIXER_MAX_VOICES], step[MIXER_MAX_VOICES];
+    int32_t gain[MIXER_MAX_VOICES];
+    memcpy(phase, m->phase, sizeof(phase));
+    memcpy(step, m->step, sizeof(step));
+    memcpy(gain, m->gain, sizeof(gain));
+    int voices = m->voices;
+
+    //Quiet voices at spread out pitches, the cost does not depend on what they play
+    m->voices = 0;
+    for (int v = 0; v < MIXER_MAX_VOICES; v++) mixer_add_voice(m, (110 + 37 * v) << 8, sample_rate, 1024);
+    m->voices = 1;
+    uint32_t one = time_render(m, scratch, block);
+    m->voices = MIXER_MAX_VOICES;
+    uint32_t all = time_render(m, scratch, block);
+
+    fit->voice_cycles = all > one ? (all - one) / (MIXER_MAX_VOICES - 1) : 1;
+    if (fit->voice_cycles == 0) fit->voice_cycles = 1;
+    fit->fixed_cycles = one > fit->voice_cycles ? one - fit->voice_cycles : 0;
+    fit->deadline_cycles = (uint32_t)((uint64_t)CCLK_HZ * block / sample_rate * budget_percent / 100);
+
+    int max = 0;
+    if (fit->deadline_cycles > fit->fixed_cycles) max = (fit->deadline_cycles - fit->fixed_cycles) / fit->voice_cycles;
+    fit->max_voices = max > MIXER_MAX_VOICES ? MIXER_MAX_VOICES : max;
+
+    memcpy(m->phase, phase, sizeof(phase));
+    memcpy(m->step, step, sizeof(step));
+    memcpy(m->gain, gain, sizeof(gain));
+    m->voices = voices;
+}
@@ -0,0 +1,68 @@
+/*
+ * Polyphonic Mixer
+ * Objective: Play more than one tone through the one DAC
+ *
+ * Up to MIXER_MAX_VOICES linear interpolating DDS voices sharing one Q15 table
+ * (see dds.h) are summed into each DMA block with a Q15 gain per voice, then
+ * saturated into DACR words. Harmonics, a detuned unison or a drone under the
+ * theremin voice are all just voices with different frequencies and gains.
+ *
+ * Voice state is kept as structure of arrays. Each voice is rendered over the
+ * whole block into a 32 bit accumulator, so the loops are straight runs with
+ * no per-sample branching on the M3, and the clear and output passes vectorize
+ * on the host. Voices in use are always 0..voices-1, removing one moves the
+ * last voice into its slot.
+ */
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+
+#define MIXER_MAX_VOICES 16
+#define MIXER_MAX_BLOCK 512     //Longer renders are split into blocks of this size
+
+struct Mixer {
+    const int16_t *table;       //dds_table_init() layout
+    int            bits;
+    int            voices;      //Voices in use
+    uint32_t       phase[MIXER_MAX_VOICES];
+    uint32_t       step[MIXER_MAX_VOICES];
+    int32_t        gain[MIXER_MAX_VOICES];  //Q15
+    int32_t        mix[MIXER_MAX_BLOCK];    //Sum of the voices, Q15 before saturation
+};
+
+void mixer_init(Mixer *m, const int16_t *table, int bits);
+
+//Returns the voice index, or -1 if all voices are in use
+int mixer_add_voice(Mixer *m, uint32_t freq_q8, uint32_t sample_rate, int16_t gain);
+
+//Retunes a voice without resetting its phase, so there is no click
+void mixer_set_voice(Mixer *m, int voice, uint32_t freq_q8, uint32_t sample_rate, int16_t gain);
+
+//The last voice takes the removed one's index. A voice not in use is ignored
+void mixer_remove_voice(Mixer *m, int voice);
+
+//Renders count DACR words of the sum of all voices
+void mixer_render(Mixer *m, uint32_t *dacr, int count);
+
+//Just the sum, left in m->mix for further processing, count <= MIXER_MAX_BLOCK
+void mixer_render_mix(Mixer *m, int count);
+
+/*
+ * How many voices fit the refill deadline
+ * A block of block samples has to be rendered in block/sample_rate seconds, of which
+ * budget_percent is given to the mixer. The render cost is measured with the cycle
+ * counter as fixed + voices * per_voice and solved for voices.
+ */
+struct MixerFit {
+    uint32_t fixed_cycles;      //Clear and output passes per block
+    uint32_t voice_cycles;      //Each voice per block
+    uint32_t deadline_cycles;   //Share of the block period the mixer may use
+    int      max_voices;
+};
+
+//scratch must hold block words, the mixer's own voices are left as they were
+void mixer_fit(Mixer *m, uint32_t *scratch, int block, uint32_t sample_rate, int budget_percent, MixerFit *fit);
+
+#endif
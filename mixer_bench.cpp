@@ -0,0 +1,104 @@
+/*
+ * Mixer Benchmark
+ * Objective: Find how many voices the output path can afford
+ *
+ * Builds for the mbed and for the PC from the same source, like dds_bench.
+ * Times one block for every voice count, then asks mixer_fit() how many voices
+ * fit the refill deadline with BENCH_BUDGET percent of the CPU.
+ * On the PC the cycles are the host clock scaled to 96MHz, only the mbed
+ * figures say anything about the M3.
+ *
+ * Host build:
+ *   g++ -O2 -o mixer_bench mixer_bench.cpp mixer.cpp dds.cpp
+ *
+ * The PC build also renders a harmonic stack at two gains and counts how much
+ * of it saturates in the 10 bit DAC range.
+ */
+
+#include <stdio.h>
+
+#include "cycle_counter.h"
+#include "dds.h"
+#include "mixer.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+Serial pc(USBTX, USBRX);
+#define report pc.printf
+#else
+#include <vector>
+#define report printf
+#endif
+
+#define BENCH_RATE 48000
+#define BENCH_BLOCK 256
+#define BENCH_BUDGET 50         //Percent of the CPU the mixer may use, the rest is analysis
+#define BENCH_BITS 8            //256 entry linear table, see dds_bench
+
+static int16_t table[DDS_TABLE_LENGTH(BENCH_BITS)];
+static Mixer mixer;
+static uint32_t dacr[BENCH_BLOCK];
+
+//Best of a few blocks
+static uint32_t cycles_per_block(void) {
+    uint32_t best = 0xFFFFFFFF;
+    for (int k = 0; k < 16; k++) {
+        uint32_t start = cycle_count();
+        mixer_render(&mixer, dacr, BENCH_BLOCK);
+        uint32_t cycles = cycle_count() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+#ifndef TARGET_LPC1768
+//Share of one second of output pinned at either end of the DAC range
+static double clipped_percent(void) {
+    std::vector<uint32_t> words(BENCH_RATE);
+    mixer_render(&mixer, &words[0], BENCH_RATE);
+    int clipped = 0;
+    for (int i = 0; i < BENCH_RATE; i++) {
+        uint32_t v = DACR_VALUE(words[i]);
+        if (v == 0 || v == 1023) clipped++;
+    }
+    return 100.0 * clipped / BENCH_RATE;
+}
+
+//Fundamental plus harmonics 2 to 4 falling off as 1/h, gain scales the whole stack
+static void harmonic_stack(int32_t gain) {
+    while (mixer.voices) mixer_remove_voice(&mixer, 0);
+    for (int h = 1; h <= 4; h++) mixer_add_voice(&mixer, (220 * h) << 8, BENCH_RATE, (int16_t)(gain / h));
+}
+#endif
+
+int main() {
+    cycle_counter_init();
+    dds_table_init(table, BENCH_BITS);
+    mixer_init(&mixer, table, BENCH_BITS);
+
+    uint32_t period = (uint32_t)((uint64_t)CCLK_HZ * BENCH_BLOCK / BENCH_RATE);
+    report("Mixer, %d samples at %d Hz: %u cycles between refills\n", BENCH_BLOCK, BENCH_RATE, period);
+    report("voices cycles/block cycles/sample share\n");
+    for (int v = 1; v <= MIXER_MAX_VOICES; v++) {
+        mixer_add_voice(&mixer, (110 * v) << 8, BENCH_RATE, 32767 / MIXER_MAX_VOICES);
+        uint32_t cycles = cycles_per_block();
+        uint32_t per_sample_x10 = cycles * 10 / BENCH_BLOCK;
+        uint32_t share_x10 = (uint32_t)((uint64_t)cycles * 1000 / period);
+        report("%6d %12u %11u.%u %4u.%u%%\n", v, cycles, per_sample_x10 / 10, per_sample_x10 % 10, share_x10 / 10, share_x10 % 10);
+    }
+
+    MixerFit fit;
+    mixer_fit(&mixer, dacr, BENCH_BLOCK, BENCH_RATE, BENCH_BUDGET, &fit);
+    report("fit: %u fixed + %u per voice cycles, deadline %u (%d%%), max voices %d%s\n",
+        fit.fixed_cycles, fit.voice_cycles, fit.deadline_cycles, BENCH_BUDGET, fit.max_voices,
+        fit.max_voices == MIXER_MAX_VOICES ? " (all)" : "");
+
+#ifndef TARGET_LPC1768
+    //The gains sum to 2.08 at full scale, so the stack needs about half gain to stay clean
+    harmonic_stack(32767);
+    report("harmonic stack 220Hz x4 at full gain: %.2f%% of samples saturated\n", clipped_percent());
+    harmonic_stack(32767 * 100 / 208);
+    report("harmonic stack 220Hz x4 at 1/2.08 gain: %.2f%% of samples saturated\n", clipped_percent());
+#endif
+    return 0;
+}
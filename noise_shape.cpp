@@ -0,0 +1,75 @@
+/*
+ * Noise Shaped Output
+ * See noise_shape.h
+ *
+ * The quantiser is the DACR mask itself: (w + 32768) & 0xFFC0 rounds down, the
+ * error e = q - w is always within one step below, plus the dither. Feeding it back
+ * as w = x - (2 e1 - e2) makes the output x + e - 2 e1 + e2, the input plus the
+ * error through (1 - z^-1)^2. The floor's half step bias has no DC path left
+ * once the order is 1 or more.
+ */
+
+#include "dds.h"
+#include "noise_shape.h"
+#include "wave_table.h"
+
+#define NOISE_SHAPE_STEP 64                     //One DAC step in Q15
+#define NOISE_SHAPE_ERR_MAX (4 * NOISE_SHAPE_STEP)
+
+bool noise_shape_init(NoiseShaper *ns, int oversample, int order, bool dither) {
+    int shift = 0;
+    while ((1 << shift) < oversample) shift++;
+    if ((1 << shift) != oversample || oversample > NOISE_SHAPE_MAX_OVERSAMPLE) return false;
+    if (order < 0 || order > 2) return false;
+    ns->oversample = oversample;
+    ns->shift = shift;
+    ns->order = order;
+    ns->dither = dither;
+    ns->last = 0;
+    ns->e1 = ns->e2 = 0;
+    ns->seed = 22222;
+    return true;
+}
+
+//Triangular over +-1 DAC step: two 6 bit fields of one LCG step, summed
+static inline int32_t tpdf(uint32_t *seed) {
+    uint32_t r = *seed = *seed * 1664525 + 1013904223;
+    return (int32_t)(r >> 26) + (int32_t)((r >> 20) & 63) - 63;
+}
+
+void noise_shape_render(NoiseShaper *ns, const int32_t *in, uint32_t *dacr, int count) {
+    int shift = ns->shift, over = ns->oversample;
+    int32_t last = ns->last, e1 = ns->e1, e2 = ns->e2;
+    uint32_t seed = ns->seed;
+    //Feedback taps for the order, (1 - z^-1)^order without the leading 1
+    int32_t k1 = ns->order == 0 ? 0 : ns->order == 1 ? 1 : 2;
+    int32_t k2 = ns->order == 2 ? -1 : 0;
+    bool dither = ns->dither;
+
+    for (int i = 0; i < count; i++) {
+        int32_t x = dds_saturate(in[i]);
+        int32_t dx = x - last;
+        //x_j = last + dx * (j + 1) / over, so the last word of the sample is x itself
+        int32_t acc = last * over;
+        for (int j = 0; j < over; j++) {
+            acc += dx;
+            int32_t w = (acc >> shift) - (k1 * e1 + k2 * e2);
+            int32_t u = w + 32768;
+            if (dither) u += tpdf(&seed);
+            if (u < 0) u = 0;
+            if (u > 65535) u = 65535;
+            uint32_t q = (uint32_t)u & 0xFFC0;
+            int32_t e = (int32_t)q - 32768 - w;
+            if (e > NOISE_SHAPE_ERR_MAX) e = NOISE_SHAPE_ERR_MAX;
+            if (e < -NOISE_SHAPE_ERR_MAX) e = -NOISE_SHAPE_ERR_MAX;
+            e2 = e1;
+            e1 = e;
+            *dacr++ = DACR_BIAS | q;
+        }
+        last = x;
+    }
+    ns->last = last;
+    ns->e1 = e1;
+    ns->e2 = e2;
+    ns->seed = seed;
+}
@@ -0,0 +1,56 @@
+/*
+ * Noise Shaped Output
+ * Objective: Get more than 10 bits of resolution out of the 10 bit DAC
+ *
+ * Plain truncation to the DACR VALUE field leaves a 1/1024 step, so a quiet note
+ * (volume antenna down) sinks into quantisation noise that follows the signal
+ * around. This stage trades DAC update rate for resolution in the audio band:
+ *
+ *   oversample  each Q15 sample becomes 1, 2, 4 or 8 DAC updates, linearly
+ *               interpolated from the one before. The DAC takes up to 400kHz
+ *               with the DACR BIAS bit set, so 8x is the limit at 48kHz.
+ *   dither      TPDF, +-1 DAC step, added before the quantiser. The error
+ *               becomes noise that does not depend on the signal.
+ *   order       error feedback, 1 shapes the error by (1 - z^-1), 2 by (1 - z^-1)^2.
+ *               The error moves from the audio band up towards half the update
+ *               rate, where the AOUT filter and the ear lose it.
+ *
+ * With oversample 1, order 0 and no dither it is the old truncation, word for word.
+ * Oversampling divides the slack the ping-pong TC interrupt has (one DAC update,
+ * see health.h) by the same factor: at 4x it is ~500 cycles instead of ~2000.
+ *
+ * Fixed point throughout: samples are Q15, one DAC step is 64, errors are
+ * clamped to a few steps so a clipped passage cannot wind up the feedback.
+ * Per DAC word it costs an interpolation add, the feedback, one LCG step for the
+ * dither, the clamps and the store. dac_render -u/-q/-p measures it.
+ */
+
+#ifndef NOISE_SHAPE_H
+#define NOISE_SHAPE_H
+
+#include <stdint.h>
+
+#define NOISE_SHAPE_MAX_OVERSAMPLE 8
+
+struct NoiseShaper {
+    int      oversample;    //DAC words per sample, 1, 2, 4 or 8
+    int      shift;         //log2(oversample)
+    int      order;         //0, 1 or 2
+    bool     dither;
+    int32_t  last;          //Previous Q15 input, the interpolation starts from it
+    int32_t  e1, e2;        //Last two quantisation errors, Q15
+    uint32_t seed;          //Dither LCG
+};
+
+//Returns false unless oversample is 1, 2, 4 or 8 and order 0 to 2
+bool noise_shape_init(NoiseShaper *ns, int oversample, int order, bool dither);
+
+//True when it would just truncate, callers can keep their plain path
+static inline bool noise_shape_is_plain(const NoiseShaper *ns) {
+    return ns->oversample == 1 && ns->order == 0 && !ns->dither;
+}
+
+//Turns count Q15 samples (not saturated yet) into count * oversample DACR words
+void noise_shape_render(NoiseShaper *ns, const int32_t *in, uint32_t *dacr, int count);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Control Parameter Block
+ * See params.h
+ *
+ * The barriers keep the compiler (and on the M3 the write buffer) from moving the
+ * copy of data across the seq accesses. __sync_synchronize() is a DMB on ARMv7-M
+ * and a full fence on the host.
+ */
+
+#include "params.h"
+
+#define PARAMS_BARRIER() __sync_synchronize()
+
+void params_init(ParamsBlock *b, const ControlParams *initial) {
+    b->data = *initial;
+    b->seq = 0;
+}
+
+void params_publish(ParamsBlock *b, const ControlParams *p) {
+    uint32_t s = b->seq;
+    b->seq = s + 1;
+    PARAMS_BARRIER();
+    b->data = *p;
+    PARAMS_BARRIER();
+    b->seq = s + 2;
+}
+
+void params_reader_init(ParamsReader *r, const ParamsBlock *b) {
+    r->seq = b->seq;
+    PARAMS_BARRIER();
+    r->last = b->data;
+    r->reads = 0;
+    r->fallbacks = 0;
+}
+
+bool params_read(ParamsReader *r, const ParamsBlock *b, ControlParams *out) {
+    r->reads++;
+    for (int t = 0; t < PARAMS_READ_TRIES; t++) {
+        uint32_t s = b->seq;
+        if (s == r->seq) {
+            *out = r->last;
+            return false;
+        }
+        //Odd: we interrupted the writer, it cannot finish until we return
+        if (s & 1) break;
+        PARAMS_BARRIER();
+        ControlParams copy = b->data;
+        PARAMS_BARRIER();
+        if (b->seq == s) {
+            r->last = copy;
+            r->seq = s;
+            *out = copy;
+            return true;
+        }
+    }
+    r->fallbacks++;
+    *out = r->last;
+    return false;
+}
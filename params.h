@@ -0,0 +1,59 @@
+/*
+ * Control Parameter Block
+ * Objective: Hand pitch, volume and voice settings from analysis to synthesis as one consistent set
+ *
+ * Analysis decides what to play, synthesis renders it, and they run at unrelated
+ * rates and possibly at different interrupt levels. The parameters travel through
+ * a seqlock: the one writer makes seq odd, copies the set in and makes seq even
+ * again. A reader copies the set out between two reads of seq and keeps it only if
+ * seq was even and unchanged, so it never sees frequency from one update and gain
+ * from the next.
+ *
+ * The reader never waits. A reader that interrupted the writer would spin forever
+ * on an odd seq, so it gives up at once when seq is odd, retries at most
+ * PARAMS_READ_TRIES times after a torn copy, and otherwise returns the last good
+ * set it read. Neither side disables interrupts. The writer may publish as often
+ * as it likes, a reader simply sees the newest set when it looks.
+ *
+ * One writer per block. Any number of readers, each with its own ParamsReader.
+ */
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdint.h>
+
+#define PARAMS_READ_TRIES 2
+
+struct ControlParams {
+    uint32_t freq_q8;       //Pitch to play, Hz * 256
+    int16_t  gain;          //Q15 output level
+    uint8_t  waveform;      //Index into the synthesis side's waveforms
+    uint8_t  reserved;
+    uint16_t glide_ms;      //Time constant of the slide to a new pitch, 0 jumps
+};
+
+struct ParamsBlock {
+    volatile uint32_t seq;  //Odd while the writer is copying
+    ControlParams     data;
+};
+
+struct ParamsReader {
+    ControlParams last;     //Last consistent set, handed out when a read fails
+    uint32_t      seq;      //Its seq
+    uint32_t      reads;
+    uint32_t      fallbacks;    //Reads that had to return last
+};
+
+void params_init(ParamsBlock *b, const ControlParams *initial);
+
+//Writer side, never blocks
+void params_publish(ParamsBlock *b, const ControlParams *p);
+
+//Starts a reader off with the set published now
+void params_reader_init(ParamsReader *r, const ParamsBlock *b);
+
+//Copies the newest consistent set to out, true if it is newer than the last one this reader returned
+bool params_read(ParamsReader *r, const ParamsBlock *b, ControlParams *out);
+
+#endif
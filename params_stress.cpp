@@ -0,0 +1,104 @@
+/*
+ * Parameter Block Stress Test
+ * Objective: Show a seqlock reader never hands out a mixed set
+ *
+ * Host only (C++11 threads). On the mbed the writer and the reader take turns on
+ * one core, here they run flat out on two, which is the harder case: every read
+ * can overlap a write. Each published set is derived from one counter, so a set
+ * whose fields disagree with each other was torn.
+ *
+ * Build:
+ *   g++ -O2 -pthread -o params_stress params_stress.cpp params.cpp
+ *
+ * Usage: params_stress [seconds]    (default 2)
+ *
+ * Runs twice, half the time each: the writer publishing flat out, then once a ms
+ * like the dac_dma sweep. Reports the sets published and read, how many reads
+ * were new, how many fell back to the last set, and how many mixed sets got out
+ * (must be 0, the exit code says so too).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "params.h"
+
+static ParamsBlock block;
+static std::atomic<bool> stop(false);
+
+//Every field a function of n
+static void make_set(uint32_t n, ControlParams *p) {
+    p->freq_q8 = n;
+    p->gain = (int16_t)(n & 0x7FFF);
+    p->waveform = (uint8_t)(n >> 3);
+    p->reserved = (uint8_t)~n;
+    p->glide_ms = (uint16_t)(n * 7);
+}
+
+static bool consistent(const ControlParams *p) {
+    ControlParams want;
+    make_set(p->freq_q8, &want);
+    return p->gain == want.gain && p->waveform == want.waveform
+        && p->reserved == want.reserved && p->glide_ms == want.glide_ms;
+}
+
+static void writer(int period_us, uint32_t *published) {
+    ControlParams p;
+    uint32_t n = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        make_set(++n, &p);
+        params_publish(&block, &p);
+        if (period_us) std::this_thread::sleep_for(std::chrono::microseconds(period_us));
+    }
+    *published = n;
+}
+
+//One run, writer publishing every period_us (0 flat out), returns the number of bad reads
+static uint64_t run(double seconds, int period_us) {
+    ControlParams p;
+    make_set(0, &p);
+    params_init(&block, &p);
+    ParamsReader reader;
+    params_reader_init(&reader, &block);
+
+    stop = false;
+    uint32_t published = 0;
+    std::thread w(writer, period_us, &published);
+
+    uint64_t fresh = 0, torn = 0, backwards = 0;
+    uint32_t last = 0;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now()
+        + std::chrono::microseconds((long long)(seconds * 1e6));
+    while (std::chrono::steady_clock::now() < end) {
+        for (int i = 0; i < 1000; i++) {
+            if (params_read(&reader, &block, &p)) fresh++;
+            if (!consistent(&p)) torn++;
+            if (p.freq_q8 < last) backwards++;
+            last = p.freq_q8;
+        }
+    }
+    stop = true;
+    w.join();
+
+    if (period_us) printf("every %dus: ", period_us);
+    else printf("flat out:    ");
+    printf("%u sets published, %u reads: %llu new, %u fell back, %llu went backwards, %llu mixed\n",
+        published, reader.reads, (unsigned long long)fresh, reader.fallbacks,
+        (unsigned long long)backwards, (unsigned long long)torn);
+    return torn + backwards;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+
+    //Flat out nearly every read overlaps a write, at the sweep's rate almost none do
+    uint64_t bad = run(seconds / 2, 0);
+    bad += run(seconds / 2, 1000);
+
+    printf(bad ? "FAILED\n" : "every read was a whole set\n");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Pitch Estimation
+ * See pitch.h
+ */
+
+#include <math.h>
+
+#include "fft_r4.h"
+#include "fixed_math.h"
+#include "pitch.h"
+
+uint32_t pitch_peak_interval(const uint16_t *samples, int count, uint32_t sample_rate) {
+    if (count < 3) return 0;
+
+    uint32_t sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i] & 0xFFF;
+    int mean = sum / count;
+
+    //Slope Bool holds whether we are above the mean, PeakVal/PeakIdx the highest point so far
+    //The block can start part way through a half cycle, that one is never counted
+    bool above = (samples[0] & 0xFFF) > mean;
+    bool started = false;
+    int PeakVal = -1, PeakIdx = 0;
+    int FirstPeak = -1, LastPeak = -1, PeakCount = 0;
+
+    for (int i = 1; i < count; i++) {
+        int v = samples[i] & 0xFFF;
+        if (v > mean) {
+            if (!above) {
+                //Rising through the mean, a new half cycle starts
+                above = true;
+                started = true;
+                PeakVal = -1;
+            }
+            if (v > PeakVal) {
+                PeakVal = v;
+                PeakIdx = i;
+            }
+        } else if (above) {
+            //Falling through the mean, the half cycle we just left had its peak at PeakIdx
+            above = false;
+            if (started) {
+                if (FirstPeak < 0) FirstPeak = PeakIdx;
+                LastPeak = PeakIdx;
+                PeakCount++;
+            }
+        }
+    }
+
+    if (PeakCount < 2 || LastPeak == FirstPeak) return 0;
+    return (uint32_t)(((uint64_t)sample_rate * 256 * (PeakCount - 1)) / (LastPeak - FirstPeak));
+}
+
+void pitch_window_init(short *window, int N, int type) {
+    for (int i = 0; i < N; i++) {
+        double c = cos(2.0 * 3.14159265358979 * i / N);
+        double w = 1.0;
+        if (type == WINDOW_HANN)    w = 0.5 - 0.5 * c;
+        if (type == WINDOW_HAMMING) w = 0.54 - 0.46 * c;
+        int q = (int)(w * 32767.0 + 0.5);
+        window[i] = (short)q;
+    }
+}
+
+static inline uint32_t bin_power(const short *y, int k) {
+    int32_t re = y[2 * k], im = y[2 * k + 1];
+    return (uint32_t)(re * re) + (uint32_t)(im * im);
+}
+
+//Search band in bins, leaving room for the parabola either side
+static bool search_band(const PitchFft *cfg, int *kmin, int *kmax) {
+    int N = cfg->N;
+    *kmin = (int)(((uint64_t)cfg->fmin_q8 * N) / ((uint64_t)cfg->sample_rate * 256));
+    *kmax = (int)(((uint64_t)cfg->fmax_q8 * N) / ((uint64_t)cfg->sample_rate * 256)) + 1;
+    if (*kmin < 1) *kmin = 1;
+    if (*kmax > N / 2 - 2) *kmax = N / 2 - 2;
+    return *kmin <= *kmax;
+}
+
+void pitch_transform(const PitchFft *cfg) {
+    if (cfg->coef) fftR4c(cfg->y, cfg->x, cfg->N, cfg->coef);
+    else fftR4(cfg->y, cfg->x, cfg->N);
+}
+
+void pitch_peak(const PitchFft *cfg, PitchResult *out) {
+    int N = cfg->N;
+    out->freq_q8 = 0;
+    out->confidence = 0;
+
+    int kmin, kmax;
+    if (!search_band(cfg, &kmin, &kmax)) return;
+
+    uint64_t total = 0;
+    uint32_t best = 0;
+    int k = kmin;
+    for (int i = kmin; i <= kmax; i++) {
+        uint32_t p = bin_power(cfg->y, i);
+        total += p;
+        if (p > best) {
+            best = p;
+            k = i;
+        }
+    }
+    if (best == 0) return;
+
+    //Parabola through the magnitudes either side of the peak, delta in 1/256 of a bin
+    int32_t a = isqrt32(bin_power(cfg->y, k - 1));
+    int32_t b = isqrt32(best);
+    int32_t c = isqrt32(bin_power(cfg->y, k + 1));
+    int32_t den = a - 2 * b + c;
+    int32_t delta = den ? ((a - c) * 128) / den : 0;
+    if (delta > 128) delta = 128;
+    if (delta < -128) delta = -128;
+
+    out->freq_q8 = (uint32_t)(((int64_t)(k * 256 + delta) * cfg->sample_rate) / N);
+
+    uint64_t peak = (uint64_t)bin_power(cfg->y, k - 1) + best + bin_power(cfg->y, k + 1);
+    out->confidence = (uint16_t)(total ? (peak * 32767) / total : 0);
+}
+
+void pitch_fft(const PitchFft *cfg, const uint16_t *samples, PitchResult *out) {
+    int N = cfg->N;
+
+    //Remove the antenna bias, scale 12 bits up to Q15 and window
+    uint32_t sum = 0;
+    for (int i = 0; i < N; i++) sum += samples[i] & 0xFFF;
+    int mean = sum / N;
+    for (int i = 0; i < N; i++) {
+        //More than 2047 codes from the mean clips instead of wrapping
+        int32_t v = sat_q15(((samples[i] & 0xFFF) - mean) << 4);
+        if (cfg->window) v = (v * cfg->window[i]) >> 15;
+        cfg->x[2 * i] = (short)v;
+        cfg->x[2 * i + 1] = 0;
+    }
+    pitch_transform(cfg);
+    pitch_peak(cfg, out);
+}
+
+void pitch_window_q15(const PitchFft *cfg, const int16_t *samples) {
+    int N = cfg->N;
+    for (int i = 0; i < N; i++) {
+        int32_t v = samples[i];
+        if (cfg->window) v = (v * cfg->window[i]) >> 15;
+        cfg->x[2 * i] = (short)v;
+        cfg->x[2 * i + 1] = 0;
+    }
+}
+
+void pitch_fft_q15(const PitchFft *cfg, const int16_t *samples, PitchResult *out) {
+    pitch_window_q15(cfg, samples);
+    pitch_transform(cfg);
+    pitch_peak(cfg, out);
+}
+
+/*
+ * Octave correction thresholds, log2 power in Q8 (256 = 3dB)
+ * The floor sits HPS_FLOOR above the mean log power of the band, so noise bins
+ * score nothing. A subharmonic candidate needs a peak of its own above the floor
+ * and within HPS_PRESENT of the strongest, at least HPS_SEPARATION bins below it
+ * (closer is still the main lobe of the window), and a harmonic score HPS_MARGIN
+ * above the current choice.
+ */
+#define HPS_HARMONICS   5
+#define HPS_MAX_DIVISOR 4
+#define HPS_PRESENT     (10 * 256)  //30dB
+#define HPS_MARGIN      (3 * 256)   //9dB
+#define HPS_SEPARATION  4
+#define HPS_FLOOR       (4 * 256)   //12dB over the mean log power
+
+//Strongest log power within a bin of k (Q8 bins), never below floor
+static inline int32_t near_log(const short *L, uint32_t k_q8, int half, int32_t floor) {
+    int k = (int)((k_q8 + 128) >> 8);
+    if (k < 1 || k > half - 2) return floor;
+    int32_t v = L[k];
+    if (L[k - 1] > v) v = L[k - 1];
+    if (L[k + 1] > v) v = L[k + 1];
+    return v > floor ? v : floor;
+}
+
+//True if the strongest bin within a bin of k is higher than both its neighbours
+static bool is_peak(const short *L, uint32_t k_q8, int half) {
+    int k = (int)((k_q8 + 128) >> 8);
+    if (k < 2 || k > half - 3) return false;
+    if (L[k - 1] > L[k] && L[k - 1] >= L[k + 1]) k--;
+    else if (L[k + 1] > L[k]) k++;
+    return L[k] > L[k - 1] && L[k] > L[k + 1];
+}
+
+/*
+ * Harmonic product of the first HPS_HARMONICS multiples of k, as a sum of their
+ * log powers above the floor. A missing harmonic, or one past N/2, adds nothing
+ * rather than counting against the candidate.
+ */
+static int32_t harmonic_score(const short *L, uint32_t k_q8, int half, int32_t floor) {
+    int32_t score = 0;
+    for (int r = 1; r <= HPS_HARMONICS; r++) score += near_log(L, r * k_q8, half, floor) - floor;
+    return score;
+}
+
+void pitch_octave_correct(const PitchFft *cfg, PitchResult *out) {
+    if (out->freq_q8 == 0) return;
+    int N = cfg->N, half = N / 2;
+    int kmin, kmax;
+    if (!search_band(cfg, &kmin, &kmax)) return;
+
+    //The FFT input is not needed any more, its first N/2 shorts hold the log spectrum
+    short *L = cfg->x;
+    int32_t peak = 0, log_sum = 0;
+    uint64_t total = 0;
+    for (int k = 0; k < half; k++) {
+        uint32_t p = bin_power(cfg->y, k);
+        L[k] = (short)log2_q8(p);
+        if (k >= kmin && k <= kmax) {
+            log_sum += L[k];
+            if (L[k] > peak) peak = L[k];
+        }
+        if (k > 0) total += p;
+    }
+    int32_t floor = log_sum / (kmax - kmin + 1) + HPS_FLOOR;
+
+    //The raw peak is harmonic 1 to HPS_MAX_DIVISOR of the note
+    uint32_t kf = (uint32_t)(((uint64_t)out->freq_q8 * N) / cfg->sample_rate);
+    int best = 1;
+    int32_t best_score = harmonic_score(L, kf, half, floor);
+    for (int d = 2; d <= HPS_MAX_DIVISOR; d++) {
+        uint32_t kc = kf / d;
+        if ((int)(kc >> 8) < kmin || kf - kc < (HPS_SEPARATION << 8)) break;
+        int32_t own = near_log(L, kc, half, floor);
+        if (own == floor || own < peak - HPS_PRESENT || !is_peak(L, kc, half)) continue;
+        int32_t score = harmonic_score(L, kc, half, floor);
+        if (score > best_score + HPS_MARGIN) {
+            best = d;
+            best_score = score;
+        }
+    }
+    //Dividing the refined harmonic keeps its precision
+    out->freq_q8 /= best;
+
+    //Confidence becomes the share of the spectrum in the note's harmonics
+    uint32_t k0 = kf / best;
+    uint64_t harmonics = 0;
+    for (int r = 1; r <= HPS_HARMONICS; r++) {
+        int k = (int)((r * k0 + 128) >> 8);
+        if (k < 1 || k > half - 2) break;
+        harmonics += (uint64_t)bin_power(cfg->y, k - 1) + bin_power(cfg->y, k) + bin_power(cfg->y, k + 1);
+    }
+    uint64_t c = total ? (harmonics * 32767) / total : 0;
+    out->confidence = (uint16_t)(c > 32767 ? 32767 : c);
+}
+
+//Middle value of up to three estimates
+static uint32_t median3(const uint32_t *h, int count) {
+    if (count == 1) return h[0];
+    if (count == 2) return (h[0] + h[1]) / 2;
+    uint32_t a = h[0], b = h[1], c = h[2];
+    if (a > b) { uint32_t t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return a > b ? a : b;
+}
+
+void pitch_tracker_init(PitchTracker *t, uint16_t min_confidence, uint16_t smoothing, int hold_frames) {
+    t->count = 0;
+    t->freq_q8 = 0;
+    t->min_confidence = min_confidence;
+    t->smoothing = smoothing;
+    t->hold_frames = hold_frames;
+    t->missed = 0;
+}
+
+uint32_t pitch_tracker_update(PitchTracker *t, const PitchResult *r) {
+    if (r->freq_q8 == 0 || r->confidence < t->min_confidence) {
+        if (++t->missed >= t->hold_frames) {
+            t->freq_q8 = 0;
+            t->count = 0;
+        }
+        return t->freq_q8;
+    }
+    t->missed = 0;
+
+    if (t->count < 3) {
+        t->history[t->count++] = r->freq_q8;
+    } else {
+        //Shift the oldest out
+        t->history[0] = t->history[1];
+        t->history[1] = t->history[2];
+        t->history[2] = r->freq_q8;
+    }
+    uint32_t m = median3(t->history, t->count);
+
+    //More than a semitone (~6%) away is a new note, anything less gets smoothed
+    uint32_t diff = m > t->freq_q8 ? m - t->freq_q8 : t->freq_q8 - m;
+    if (t->freq_q8 == 0 || diff * 16 > t->freq_q8) {
+        t->freq_q8 = m;
+    } else {
+        int32_t step = (int32_t)(((int64_t)((int32_t)m - (int32_t)t->freq_q8) * t->smoothing) >> 15);
+        t->freq_q8 += step;
+    }
+    return t->freq_q8;
+}
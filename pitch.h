@@ -0,0 +1,117 @@
+/*
+ * Pitch Estimation
+ * Objective: Turn a block of antenna samples into a frequency
+ *
+ * Frequencies are passed around as Hz * 256 (Q8) so the M3 never needs floating point.
+ * e.g. A4 = 440Hz = 112640
+ *
+ * Two estimators live here:
+ *   pitch_peak_interval()  time domain, cheap, the original peak detector
+ *   pitch_fft()            fftR4 magnitude peak with parabolic refinement
+ *   pitch_octave_correct() harmonic product check of the pitch_fft() result
+ * and a PitchTracker that turns frame by frame estimates into a steady note.
+ */
+
+#ifndef PITCH_H
+#define PITCH_H
+
+#include <stdint.h>
+
+#define PITCH_Q8(hz) ((uint32_t)((hz) * 256))
+
+/*
+ * Peak interval estimator, the cal_slope() peak detector from MUHAHAHAHA.cpp cleaned up
+ * A peak is the top of the wave between two upward crossings of the block mean,
+ * so small wiggles on the slope no longer count as peaks.
+ * The frequency is the sample rate over the mean distance between peaks.
+ * samples are 12 bit ADC codes, anything above bit 11 (the channel) is ignored
+ * Returns 0 if fewer than two peaks were found
+ */
+uint32_t pitch_peak_interval(const uint16_t *samples, int count, uint32_t sample_rate);
+
+enum PitchWindow {
+    WINDOW_RECT = 0,
+    WINDOW_HANN,
+    WINDOW_HAMMING
+};
+
+//Fills window[0..N-1] with Q15 coefficients, done once at startup
+void pitch_window_init(short *window, int N, int type);
+
+/*
+ * FFT estimator setup
+ * x and y are the fftR4 work buffers, 2*N shorts each and 4 byte aligned
+ * window may be 0 for a rectangular window
+ * coef may be 0 for the built in fftR4 table, or an FftPlan's table (fft_plan.h)
+ */
+struct PitchFft {
+    int          N;             //FFT size, one of the fftR4 sizes
+    uint32_t     sample_rate;   //Hz
+    uint32_t     fmin_q8;       //Search band
+    uint32_t     fmax_q8;
+    const short *window;
+    const short *coef;
+    short       *x;
+    short       *y;
+};
+
+struct PitchResult {
+    uint32_t freq_q8;       //0 if no peak was found
+    uint16_t confidence;    //Q15, share of the band's energy in the peak and its neighbours
+};
+
+/*
+ * Removes the block mean, windows, runs fftR4 and picks the strongest bin in the band
+ * The peak is refined with a parabola through the magnitudes of its neighbours
+ * samples are N 12 bit ADC codes
+ */
+void pitch_fft(const PitchFft *cfg, const uint16_t *samples, PitchResult *out);
+
+/*
+ * Same search on N Q15 samples that are already zero mean, e.g. frontend_process() output
+ * Only the window is applied
+ */
+void pitch_fft_q15(const PitchFft *cfg, const int16_t *samples, PitchResult *out);
+
+/*
+ * The three steps of pitch_fft_q15() one at a time, so each can be timed:
+ * window the samples into cfg->x, FFT cfg->x into cfg->y, pick the peak in cfg->y
+ */
+void pitch_window_q15(const PitchFft *cfg, const int16_t *samples);
+void pitch_transform(const PitchFft *cfg);
+void pitch_peak(const PitchFft *cfg, PitchResult *out);
+
+/*
+ * Octave correction, run straight after pitch_fft() or pitch_fft_q15() on the same cfg
+ * The strongest bin is often the 2nd or 3rd harmonic. Each of f, f/2, f/3, f/4
+ * is scored by the harmonic product of its first harmonics (a sum of log powers),
+ * and a lower candidate replaces f only if it has a peak of its own and a clearly
+ * better product. confidence becomes the share of the spectrum in the chosen
+ * note's harmonics.
+ * One pass over the N/2 bins, the log spectrum is kept in cfg->x, no other buffers.
+ */
+void pitch_octave_correct(const PitchFft *cfg, PitchResult *out);
+
+/*
+ * Tracker
+ * A median of the last 3 estimates removes single frame octave jumps.
+ * Small moves are smoothed, moves bigger than a semitone are taken straight away
+ * so note changes are not slurred.
+ * Frames below min_confidence are ignored, hold_frames of them in a row mean silence.
+ */
+struct PitchTracker {
+    uint32_t history[3];
+    int      count;
+    uint32_t freq_q8;           //Tracked pitch, 0 when unvoiced
+    uint16_t min_confidence;    //Q15
+    uint16_t smoothing;         //Q15 weight given to each new estimate
+    int      hold_frames;
+    int      missed;
+};
+
+void pitch_tracker_init(PitchTracker *t, uint16_t min_confidence, uint16_t smoothing, int hold_frames);
+
+//Feeds one frame, returns the tracked pitch
+uint32_t pitch_tracker_update(PitchTracker *t, const PitchResult *r);
+
+#endif
@@ -0,0 +1,471 @@
+/*
+ * Pitch Regression
+ * Objective: Catch any change to pitch detection that costs accuracy
+ *
+ * Host only. Generates a synthetic corpus, runs every pitch estimator over it
+ * and compares the results with the checked in pitch_baseline.txt.
+ *
+ * Build:
+ *   g++ -O2 -o pitch_regression pitch_regression.cpp fft_r4.cpp pitch.cpp frontend.cpp adc_unpack.cpp fft_plan.cpp change_detect.cpp
+ *
+ * Usage:
+ *   pitch_regression                   compare against pitch_baseline.txt, exit 1 on a regression
+ *   pitch_regression --update          rewrite pitch_baseline.txt with the current results
+ *   pitch_regression --baseline FILE   compare against another baseline
+ *
+ * Corpus, all at CORPUS_RATE as 12 bit ADC codes around mid scale:
+ *   pure       sine on every one of the 88 piano keys
+ *   harmonic   same keys, 8 harmonics with a 1/n rolloff (fundamental strongest)
+ *   weakfund   same keys, fundamental 12dB below the 2nd harmonic
+ *   noise20    every 4th key, white noise at 20dB SNR
+ *   noise10    every 4th key, 10dB SNR
+ *   noise0     every 4th key, 0dB SNR
+ *   glide      exponential glides of an octave up and down
+ *   ampstep    steady tone that drops 24dB for a second then comes back
+ * Every signal starts with SILENCE_S of quiet (bias + a little noise) so onset
+ * latency can be measured.
+ *
+ * Metrics per estimator and category:
+ *   cents      mean |error| over frames within 100 cents of the truth
+ *   gross%     frames more than 100 cents out
+ *   octave%    frames a whole number of octaves out (within 100 cents)
+ *   voiced%    frames after onset with a pitch at all
+ *   latency    ms from onset until the first frame within 50 cents
+ *   cycles     per frame (host clock scaled to 96MHz, informational only)
+ *   skip%      frames that reused the previous result (change_detect.h), informational
+ *
+ * Everything except cycles is deterministic, the noise comes from a fixed seed.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cycle_counter.h"
+#include "adc_defs.h"
+#include "change_detect.h"
+#include "fft_plan.h"
+#include "frontend.h"
+#include "pitch.h"
+
+#define CORPUS_RATE 16000
+#define SILENCE_S   0.25
+#define TONE_S      1.0
+#define FRAME_N     1024
+#define HOP         256
+
+#define DEFAULT_BASELINE "pitch_baseline.txt"
+
+/*
+ * Corpus
+ */
+
+struct Signal {
+    std::string category;
+    std::vector<uint16_t> samples;
+    std::vector<double> truth;      //Hz per sample, 0 before the onset
+    int onset;                      //First sample of the tone
+};
+
+static uint32_t rng_state = 12345;
+
+//Uniform in [-1, 1), xorshift so the corpus is the same on every machine
+static double noise(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (double)rng_state / 2147483648.0 - 1.0;
+}
+
+static double key_hz(int key) {
+    return 440.0 * pow(2.0, (key - 49) / 12.0);    //Key 1 = A0, key 88 = C8
+}
+
+static uint16_t to_code(double v) {
+    int code = (int)floor(2048.0 + v * 2047.0 + 0.5);
+    if (code < 0) code = 0;
+    if (code > 4095) code = 4095;
+    return (uint16_t)code;
+}
+
+/*
+ * Builds one signal: silence, then a tone whose frequency and amplitude follow
+ * freq(t) and amp(t). harmonics[] are relative amplitudes of partials 1..n
+ */
+static void make_signal(Signal *s, const char *category, double seconds,
+                        double (*freq)(double, const double *), const double *fargs,
+                        double (*amp)(double), const double *harmonics, int nharm, double snr_db) {
+    int silence = (int)(SILENCE_S * CORPUS_RATE);
+    int total = silence + (int)(seconds * CORPUS_RATE);
+    s->category = category;
+    s->onset = silence;
+    s->samples.resize(total);
+    s->truth.assign(total, 0.0);
+
+    double norm = 0;
+    for (int h = 0; h < nharm; h++) norm += fabs(harmonics[h]);
+    //Tone power at full amp is 0.5^2/2, uniform noise of amplitude a has power a^2/3
+    double noise_amp = snr_db < 100 ? sqrt(3.0 * 0.125) * pow(10.0, -snr_db / 20.0) : 0;
+    double phase = 0;
+
+    for (int i = 0; i < total; i++) {
+        double v = 0.002 * noise();
+        if (i >= silence) {
+            double t = (double)(i - silence) / CORPUS_RATE;
+            double f = freq(t, fargs);
+            s->truth[i] = f;
+            phase += 2.0 * M_PI * f / CORPUS_RATE;
+            double tone = 0;
+            for (int h = 0; h < nharm; h++) {
+                if (f * (h + 1) < CORPUS_RATE / 2) tone += harmonics[h] * sin((h + 1) * phase);
+            }
+            v += 0.5 * amp(t) * tone / norm + noise_amp * noise();
+        }
+        s->samples[i] = to_code(v);
+    }
+}
+
+static double steady(double, const double *a) { return a[0]; }
+static double glide(double t, const double *a) { return a[0] * pow(a[1] / a[0], t / TONE_S); }
+static double full(double) { return 1.0; }
+static double step(double t) { return (t >= 0.5 && t < 1.5) ? 0.063 : 1.0; }  //-24dB
+
+static void build_corpus(std::vector<Signal> *corpus) {
+    static const double pure[] = { 1.0 };
+    static const double rich[] = { 1.0, 0.5, 0.33, 0.25, 0.2, 0.17, 0.14, 0.125 };
+    static const double weak[] = { 0.25, 1.0, 0.5, 0.33 };
+
+    for (int key = 1; key <= 88; key++) {
+        double f = key_hz(key);
+        Signal s;
+        make_signal(&s, "pure", TONE_S, steady, &f, full, pure, 1, 1000);
+        corpus->push_back(s);
+        make_signal(&s, "harmonic", TONE_S, steady, &f, full, rich, 8, 1000);
+        corpus->push_back(s);
+        make_signal(&s, "weakfund", TONE_S, steady, &f, full, weak, 4, 1000);
+        corpus->push_back(s);
+    }
+    for (int key = 4; key <= 88; key += 4) {
+        double f = key_hz(key);
+        Signal s;
+        make_signal(&s, "noise20", TONE_S, steady, &f, full, pure, 1, 20);
+        corpus->push_back(s);
+        make_signal(&s, "noise10", TONE_S, steady, &f, full, pure, 1, 10);
+        corpus->push_back(s);
+        make_signal(&s, "noise0", TONE_S, steady, &f, full, pure, 1, 0);
+        corpus->push_back(s);
+    }
+    for (int key = 16; key <= 64; key += 12) {
+        double up[2] = { key_hz(key), key_hz(key + 12) };
+        double down[2] = { key_hz(key + 12), key_hz(key) };
+        Signal s;
+        make_signal(&s, "glide", TONE_S, glide, up, full, rich, 4, 1000);
+        corpus->push_back(s);
+        make_signal(&s, "glide", TONE_S, glide, down, full, rich, 4, 1000);
+        corpus->push_back(s);
+    }
+    for (int key = 28; key <= 76; key += 12) {
+        double f = key_hz(key);
+        Signal s;
+        make_signal(&s, "ampstep", 2.0, steady, &f, step, rich, 4, 1000);
+        corpus->push_back(s);
+    }
+}
+
+/*
+ * Estimators
+ * Each one gets a frame of FRAME_N codes and returns a raw result for the tracker
+ * Streaming stages that have to see every sample once, in order, go in start(),
+ * which gets the whole signal before its first frame (0 if not needed)
+ */
+
+struct Estimator {
+    const char *name;
+    void (*init)(void);
+    void (*start)(const uint16_t *samples, int count);
+    void (*frame)(const uint16_t *samples, PitchResult *out);
+};
+
+static short window[FRAME_N];
+static short fft_x[2 * FRAME_N], fft_y[2 * FRAME_N];
+static PitchFft fft_cfg;
+static FftPlan fft_plan;    //Same RAM twiddle path as the firmware
+
+static void fft_init(void) {
+    pitch_window_init(window, FRAME_N, WINDOW_HANN);
+    fft_cfg.N = FRAME_N;
+    fft_cfg.sample_rate = CORPUS_RATE;
+    fft_cfg.fmin_q8 = PITCH_Q8(25);
+    fft_cfg.fmax_q8 = PITCH_Q8(4200);
+    fft_cfg.window = window;
+    fft_plan_init(&fft_plan, FRAME_N);
+    fft_cfg.coef = fft_plan.coef;
+    fft_cfg.x = fft_x;
+    fft_cfg.y = fft_y;
+}
+
+static void fft_frame(const uint16_t *samples, PitchResult *out) {
+    pitch_fft(&fft_cfg, samples, out);
+}
+
+/*
+ * Front end run over the signal in HOP sized blocks as the DMA would deliver them,
+ * frames then read the matching stretch of its output
+ */
+static Frontend frontend;
+static const uint16_t *agc_codes;
+static std::vector<int16_t> agc_samples;
+static std::vector<uint32_t> agc_levels, agc_spacings;     //Per HOP block
+
+static void agc_start(const uint16_t *samples, int count) {
+    frontend_init(&frontend, 10, FRONTEND_MAX_GAIN);
+    agc_codes = samples;
+    agc_samples.assign(count, 0);
+    agc_levels.clear();
+    agc_spacings.clear();
+    uint32_t words[HOP];
+    for (int pos = 0; pos + HOP <= count; pos += HOP) {
+        for (int i = 0; i < HOP; i++) words[i] = ADC_WORD(0, samples[pos + i]);
+        frontend_process(&frontend, words, &agc_samples[pos], HOP, ADC_ANY_CHANNEL, 0);
+        agc_levels.push_back(frontend.level);
+        agc_spacings.push_back(frontend.spacing_q8);
+    }
+}
+
+static void agc_frame(const uint16_t *samples, PitchResult *out) {
+    pitch_fft_q15(&fft_cfg, &agc_samples[samples - agc_codes], out);
+}
+
+//The adc_fft path: front end, FFT, octave correction
+static void agc_hps_frame(const uint16_t *samples, PitchResult *out) {
+    agc_frame(samples, out);
+    pitch_octave_correct(&fft_cfg, out);
+}
+
+/*
+ * The adc_fft path with lazy analysis: the newest HOP block of the frame is
+ * fingerprinted, and a frame that has not changed reuses the last result
+ */
+static ChangeDetect change;
+static PitchResult lazy_last;
+static int frames_skipped;
+
+static void lazy_start(const uint16_t *samples, int count) {
+    agc_start(samples, count);
+    //1/4 level, 1/128 crossing spacing (~14 cents), refresh every 8 blocks
+    change_detect_init(&change, 8192, 256, 33, 8, FRAME_N / HOP);
+}
+
+static void lazy_frame(const uint16_t *samples, PitchResult *out) {
+    size_t block = (samples - agc_codes + FRAME_N) / HOP - 1;
+    if (change_detect_block(&change, agc_levels[block], agc_spacings[block])) {
+        agc_hps_frame(samples, &lazy_last);
+    } else {
+        frames_skipped++;
+    }
+    *out = lazy_last;
+}
+
+static void hps_frame(const uint16_t *samples, PitchResult *out) {
+    fft_frame(samples, out);
+    pitch_octave_correct(&fft_cfg, out);
+}
+
+static void peak_init(void) {
+}
+
+static void peak_frame(const uint16_t *samples, PitchResult *out) {
+    out->freq_q8 = pitch_peak_interval(samples, FRAME_N, CORPUS_RATE);
+    out->confidence = out->freq_q8 ? 32767 : 0;
+}
+
+static const Estimator estimators[] = {
+    { "peak_interval", peak_init, 0,          peak_frame    },
+    { "fft_hann",      fft_init,  0,          fft_frame     },
+    { "fft_hann_agc",  fft_init,  agc_start,  agc_frame     },
+    { "fft_hann_hps",  fft_init,  0,          hps_frame     },
+    { "fft_agc_hps",   fft_init,  agc_start,  agc_hps_frame },
+    { "fft_agc_lazy",  fft_init,  lazy_start, lazy_frame    },
+};
+#define ESTIMATOR_COUNT (int)(sizeof(estimators) / sizeof(estimators[0]))
+
+/*
+ * Scoring
+ */
+
+struct Score {
+    double cents_sum;
+    int fine;           //Frames within 100 cents
+    int gross;
+    int octave;
+    int voiced;
+    int frames;         //Frames entirely after the onset
+    double latency_sum;
+    int latency_count;
+    double cycles_sum;
+    int cycles_frames;
+    int skipped;
+};
+
+static void run(const Estimator &e, const Signal &s, Score *score) {
+    PitchTracker tracker;
+    pitch_tracker_init(&tracker, 6554, 8192, 4);
+    bool locked = false;
+    frames_skipped = 0;
+
+    if (e.start) {
+        uint32_t start = cycle_count();
+        e.start(&s.samples[0], (int)s.samples.size());
+        score->cycles_sum += cycle_count() - start;
+    }
+
+    for (size_t pos = 0; pos + FRAME_N <= s.samples.size(); pos += HOP) {
+        PitchResult raw;
+        uint32_t start = cycle_count();
+        e.frame(&s.samples[pos], &raw);
+        uint32_t hz_q8 = pitch_tracker_update(&tracker, &raw);
+        score->cycles_sum += cycle_count() - start;
+        score->cycles_frames++;
+
+        if ((int)pos < s.onset) continue;
+        double truth = s.truth[pos + FRAME_N / 2];
+        score->frames++;
+        if (!hz_q8) continue;
+        score->voiced++;
+
+        double cents = 1200.0 * log2((hz_q8 / 256.0) / truth);
+        if (fabs(cents) < 100.0) {
+            score->fine++;
+            score->cents_sum += fabs(cents);
+        } else {
+            score->gross++;
+            double octaves = floor(cents / 1200.0 + 0.5);
+            if (octaves != 0 && fabs(cents - 1200.0 * octaves) < 100.0) score->octave++;
+        }
+        if (!locked && fabs(cents) < 50.0) {
+            locked = true;
+            score->latency_sum += 1000.0 * (double)(pos + FRAME_N - s.onset) / CORPUS_RATE;
+            score->latency_count++;
+        }
+    }
+    score->skipped += frames_skipped;
+}
+
+typedef std::map<std::string, double> Results;     //"estimator category metric" -> value
+
+static void score_to_results(const std::string &key, const Score &s, Results *r) {
+    (*r)[key + " cents"]   = s.fine ? s.cents_sum / s.fine : 0;
+    (*r)[key + " gross%"]  = s.voiced ? 100.0 * s.gross / s.voiced : 0;
+    (*r)[key + " octave%"] = s.voiced ? 100.0 * s.octave / s.voiced : 0;
+    (*r)[key + " voiced%"] = s.frames ? 100.0 * s.voiced / s.frames : 0;
+    (*r)[key + " latency"] = s.latency_count ? s.latency_sum / s.latency_count : 0;
+    (*r)[key + " cycles"]  = s.cycles_frames ? s.cycles_sum / s.cycles_frames : 0;
+    (*r)[key + " skip%"]   = s.cycles_frames ? 100.0 * s.skipped / s.cycles_frames : 0;
+}
+
+static bool load_baseline(const char *path, Results *r) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return false;
+    char line[256], est[64], cat[64], metric[64];
+    double v;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %63s %63s %lf", est, cat, metric, &v) == 4) {
+            (*r)[std::string(est) + " " + cat + " " + metric] = v;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static void save_baseline(const char *path, const Results &r) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "could not write %s\n", path);
+        exit(1);
+    }
+    fprintf(fp, "# pitch_regression baseline, regenerate with pitch_regression --update\n");
+    fprintf(fp, "# estimator category metric value\n");
+    for (Results::const_iterator i = r.begin(); i != r.end(); ++i) {
+        fprintf(fp, "%s %.3f\n", i->first.c_str(), i->second);
+    }
+    fclose(fp);
+}
+
+/*
+ * True if value is a regression from base for this metric
+ * Tolerances allow for rounding in the baseline file, not for real losses
+ */
+static bool regressed(const std::string &metric, double value, double base) {
+    if (metric == "cents")   return value > base * 1.10 + 0.5;
+    if (metric == "gross%")  return value > base + 1.0;
+    if (metric == "octave%") return value > base + 1.0;
+    if (metric == "voiced%") return value < base - 1.0;
+    if (metric == "latency") return value > base + 5.0;
+    return false;   //cycles are machine dependent and skip% trades against the rest, report only
+}
+
+int main(int argc, char **argv) {
+    const char *baseline = DEFAULT_BASELINE;
+    bool update = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--update")) update = true;
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baseline = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--update] [--baseline FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Signal> corpus;
+    build_corpus(&corpus);
+
+    Results results;
+    for (int e = 0; e < ESTIMATOR_COUNT; e++) {
+        estimators[e].init();
+        std::map<std::string, Score> scores;
+        for (size_t i = 0; i < corpus.size(); i++) {
+            Score &score = scores[corpus[i].category];
+            run(estimators[e], corpus[i], &score);
+        }
+        for (std::map<std::string, Score>::iterator i = scores.begin(); i != scores.end(); ++i) {
+            score_to_results(std::string(estimators[e].name) + " " + i->first, i->second, &results);
+        }
+    }
+
+    if (update) {
+        save_baseline(baseline, results);
+        printf("wrote %s (%zu values)\n", baseline, results.size());
+        return 0;
+    }
+
+    Results base;
+    bool have_base = load_baseline(baseline, &base);
+    if (!have_base) printf("no baseline at %s, showing results only\n", baseline);
+
+    int failures = 0;
+    printf("%-34s %12s %12s\n", "estimator category metric", "value", "baseline");
+    for (Results::const_iterator i = results.begin(); i != results.end(); ++i) {
+        std::string metric = i->first.substr(i->first.rfind(' ') + 1);
+        Results::const_iterator b = base.find(i->first);
+        if (b == base.end()) {
+            printf("%-34s %12.3f %12s\n", i->first.c_str(), i->second, have_base ? "new" : "-");
+            continue;
+        }
+        bool bad = regressed(metric, i->second, b->second);
+        if (bad) failures++;
+        printf("%-34s %12.3f %12.3f%s\n", i->first.c_str(), i->second, b->second, bad ? "  REGRESSION" : "");
+    }
+
+    if (failures) {
+        printf("%d regression(s) against %s\n", failures, baseline);
+        return 1;
+    }
+    if (have_base) printf("no regressions against %s\n", baseline);
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Cycle Profiler
+ * See profile.h
+ */
+
+#include <string.h>
+
+#include "fixed_math.h"
+#include "profile.h"
+
+static const char *names[PROF_SCOPES] = {
+    "capture_wait", "unpack", "window", "fft", "pitch", "publish", "synth"
+};
+
+#if PROFILE_ENABLED
+
+static ProfileCounter counters[PROF_SCOPES];
+
+//Bin from the top set bit, clamped at both ends
+static inline int bin_of(uint32_t cycles) {
+    int b = 31 - clz32(cycles | 1) - PROFILE_BIN_SHIFT;
+    if (b < 0) return 0;
+    return b < PROFILE_BINS ? b : PROFILE_BINS - 1;
+}
+
+void profile_reset(void) {
+    memset(counters, 0, sizeof(counters));
+    for (int s = 0; s < PROF_SCOPES; s++) counters[s].min = 0xFFFFFFFF;
+}
+
+void profile_add(int scope, uint32_t cycles) {
+    if ((unsigned)scope >= PROF_SCOPES) return;
+    ProfileCounter *c = &counters[scope];
+    c->runs++;
+    c->total += cycles;
+    if (cycles < c->min) c->min = cycles;
+    if (cycles > c->max) c->max = cycles;
+    c->hist[bin_of(cycles)]++;
+}
+
+bool profile_get(int scope, ProfileCounter *out) {
+    if ((unsigned)scope >= PROF_SCOPES) return false;
+    *out = counters[scope];
+    return true;
+}
+
+//Counters start cleared without anyone calling profile_reset()
+static struct ProfileInit {
+    ProfileInit() { profile_reset(); }
+} profile_init_at_startup;
+
+#else
+
+void profile_reset(void) {
+}
+
+void profile_add(int, uint32_t) {
+}
+
+bool profile_get(int, ProfileCounter *) {
+    return false;
+}
+
+#endif
+
+const char *profile_name(int scope) {
+    return (unsigned)scope < PROF_SCOPES ? names[scope] : "?";
+}
+
+void profile_dump(FILE *f) {
+#if !PROFILE_ENABLED
+    fprintf(f, "profiling compiled out, build with PROFILE_ENABLED 1\n");
+    return;
+#endif
+    fprintf(f, "scope         runs       min      mean       max  histogram from %u cycles, x2 per bin\n",
+        profile_bin_low(1));
+    for (int s = 0; s < PROF_SCOPES; s++) {
+        ProfileCounter c;
+        if (!profile_get(s, &c) || c.runs == 0) continue;
+        fprintf(f, "%-12s %5u %9u %9u %9u ", names[s], c.runs, c.min, (uint32_t)(c.total / c.runs), c.max);
+        for (int b = 0; b < PROFILE_BINS; b++) fprintf(f, " %u", c.hist[b]);
+        fprintf(f, "\n");
+    }
+}
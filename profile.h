@@ -0,0 +1,89 @@
+/*
+ * Cycle Profiler
+ * Objective: Show which stage of capture -> analysis -> synthesis eats the frame budget
+ *
+ * Every named scope keeps fixed size counters: runs, min, max, total (for the mean)
+ * and a histogram with one bin per power of two of cycles. Bin 0 holds everything
+ * under 2^(PROFILE_BIN_SHIFT+1) cycles, the last bin everything from
+ * 2^(PROFILE_BIN_SHIFT+PROFILE_BINS-1) up (~22ms at 96MHz).
+ *
+ *   PROFILE_START(t);              //uint32_t t = cycle_count()
+ *   ...
+ *   PROFILE_STOP(PROF_FFT, t);     //adds cycle_count() - t to PROF_FFT
+ *   PROFILE_ADD(PROF_CAPTURE_WAIT, cycles);    //a span measured some other way
+ *
+ * With PROFILE_ENABLED 0 all three compile to nothing and the counters are gone.
+ * Only call them from main context (the event handlers), the counters are not
+ * locked against ISRs. A span that starts in an ISR is timestamped there and added
+ * by the handler.
+ *
+ * profile_dump() writes the table as text to a FILE: stdout (the USB serial port
+ * on the mbed) or a file on the LocalFileSystem. Programs streaming binary
+ * telemetry send it as TLM_PROFILE frames instead, see tlm_send_profile().
+ * On the host cycle_count() is the scaled host clock, so the same calls time the
+ * host simulator tools in the same units.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cycle_counter.h"
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+#define PROFILE_BINS 16
+#define PROFILE_BIN_SHIFT 6
+
+enum ProfileScope {
+    PROF_CAPTURE_WAIT = 0,  //A DMA block landing to its handler starting
+    PROF_UNPACK,            //ADC words to levelled Q15 samples
+    PROF_WINDOW,
+    PROF_FFT,
+    PROF_PITCH,             //Peak search, octave correction and tracker
+    PROF_PUBLISH,           //Handing the results on (telemetry, parameters)
+    PROF_SYNTH,             //Rendering one output block
+    PROF_SCOPES
+};
+
+struct ProfileCounter {
+    uint32_t runs;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PROFILE_BINS];
+};
+
+#if PROFILE_ENABLED
+#define PROFILE_START(t)        uint32_t t = cycle_count()
+#define PROFILE_STOP(scope, t)  profile_add((scope), cycle_count() - (t))
+#define PROFILE_ADD(scope, c)   profile_add((scope), (c))
+#else
+#define PROFILE_START(t)        do {} while (0)
+#define PROFILE_STOP(scope, t)  do {} while (0)
+#define PROFILE_ADD(scope, c)   do {} while (0)
+#endif
+
+//Clears every scope
+void profile_reset(void);
+
+void profile_add(int scope, uint32_t cycles);
+
+//Copies one scope, false if it is out of range or profiling is compiled out
+bool profile_get(int scope, ProfileCounter *out);
+
+const char *profile_name(int scope);
+
+//Lower edge of histogram bin b in cycles
+static inline uint32_t profile_bin_low(int b) {
+    return b ? 1UL << (b + PROFILE_BIN_SHIFT) : 0;
+}
+
+//One line per scope that has run: runs, min/mean/max cycles and the histogram
+void profile_dump(FILE *f);
+
+#endif
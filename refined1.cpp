@@ -4,8 +4,16 @@
  
 #include "mbed.h"
 #include "MODDMA.h"
+#include "adc_defs.h"
+#include "logger.h"
+#include "sram.h"
 
 #define SAMPLE_BUFFER_LENGTH 1000
+#define LOG_FILE "/local/ADCLOG.THL"   //Binary, logger_dump turns it into CSV
+
+//Log events: a is the 12 bit code, b the index in the buffer
+enum { LOG_SAMPLE };
+static const char *const log_names[] = { "sample" };
 
 DigitalOut led1(LED1);
 DigitalOut led2(LED2);
@@ -43,14 +51,15 @@ LocalFileSystem local("local");
 
 bool slope = false;
 
-uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH];    
+uint32_t adcInputBuffer[SAMPLE_BUFFER_LENGTH] SRAM_IN(AHB0);    
+SRAM_LIST(AHB0, adcInputBuffer);
 
 int main() {
     
-     // Open up output file for debugging
-    FILE *log = fopen("/local/log.txt","w");
-    fprintf(log,"ADC with DMA example\n");
-    fprintf(log,"====================\n");
+    if (!sram_check()) error("Buffers are not in their SRAM banks, check the linker script");
+    
+    //Debug log, nothing here has a deadline so a full ring is written out on the spot
+    logger_start(LOG_FILE, log_names, 1, LOGGER_FLUSH_INLINE);
     
     
     // We use the ADC irq to trigger DMA and the manual says
@@ -146,16 +155,12 @@ int main() {
             //delete conf; // No memory leaks, delete the configuration.
             dmaTransferComplete = false;
             
-			//RAW DATA PRINTING BLOCK
+			//RAW DATA LOGGING BLOCK, a record per sample into RAM, volts are worked out on the PC
             for (int i = 0; i < SAMPLE_BUFFER_LENGTH; i++) {
-                   
-                int channel = (adcInputBuffer[i] >> 24) & 0x7;
-                int iVal = (adcInputBuffer[i] >> 4) & 0xFFF;
-                double fVal = 3.3 * (double)((double)iVal) / ((double)0x1000); // scale to 0v to 3.3v
-                fprintf(log,"Array index %02d : ADC input channel %d = 0x%03x %01.3f volts\n", i, channel, iVal, fVal);                  
+                logger_write(LOG_SAMPLE, ADC_CHANNEL(adcInputBuffer[i]), ADC_RESULT(adcInputBuffer[i]), i);
                 if(i == SAMPLE_BUFFER_LENGTH) led3 = 1;
             }
-                fclose(log);
+                logger_stop();
 		
         // Just flash LED1 for something to do.
         led1 = 1;        
@@ -0,0 +1,139 @@
+/*
+ * Event Scheduler
+ * See scheduler.h for how the pieces fit together
+ *
+ * Pending events are one bit each in a 32 bit word.
+ * ISRs set bits with LDREX/STREX so a post can never be lost, even if another
+ * interrupt posts in the middle of it.
+ * The dispatcher clears a bit the same way just before it runs the handler,
+ * so an event posted again while its handler is running gets run once more.
+ */
+
+#include "scheduler.h"
+#include "cycle_counter.h"
+
+#ifdef TARGET_LPC1768
+#include "mbed.h"
+#endif
+
+static void (*handlers[EVT_COUNT])(void);
+static volatile uint32_t pending = 0;
+
+static void (*sleep_hook)(void) = 0;
+
+static SchedStats stats;
+static uint32_t window_start = 0;
+
+#ifdef TARGET_LPC1768
+
+static inline void pending_set(uint32_t mask) {
+    uint32_t v;
+    do {
+        v = __LDREXW(&pending) | mask;
+    } while (__STREXW(v, &pending));
+}
+
+static inline void pending_clear(uint32_t mask) {
+    uint32_t v;
+    do {
+        v = __LDREXW(&pending) & ~mask;
+    } while (__STREXW(v, &pending));
+}
+
+#else
+
+//The host simulator calls "ISRs" from the same thread, so plain read-modify-write is enough
+static inline void pending_set(uint32_t mask)   { pending |= mask; }
+static inline void pending_clear(uint32_t mask) { pending &= ~mask; }
+
+#endif
+
+void sched_init(void) {
+    for (int i = 0; i < EVT_COUNT; i++) handlers[i] = 0;
+    pending = 0;
+    cycle_counter_init();
+    sched_stats(0, true);
+}
+
+void sched_attach(int event, void (*handler)(void)) {
+    if (event < 0 || event >= EVT_COUNT) return;
+    handlers[event] = handler;
+}
+
+void sched_post(int event) {
+    pending_set(1UL << event);
+}
+
+void sched_set_sleep_hook(void (*hook)(void)) {
+    sleep_hook = hook;
+}
+
+/*
+ * Sleeping has to be race free: an ISR that posts between "nothing pending" and WFI
+ * would otherwise leave us asleep with work queued.
+ * Interrupts are masked while checking, WFI still wakes on a pending interrupt with
+ * PRIMASK set, and the ISR runs as soon as they are unmasked again.
+ */
+static void sleep_until_interrupt(void) {
+    uint32_t start = cycle_count();
+#ifdef TARGET_LPC1768
+    //The end is read while still masked, the waking ISR's cycles are not idle time
+    __disable_irq();
+    if (pending == 0) __WFI();
+    uint32_t end = cycle_count();
+    __enable_irq();
+#else
+    if (pending == 0 && sleep_hook) sleep_hook();
+    uint32_t end = cycle_count();
+#endif
+    stats.idle_cycles += end - start;
+}
+
+bool sched_step(void) {
+    uint32_t p = pending;
+    if (p == 0) {
+        sleep_until_interrupt();
+        return false;
+    }
+
+    //Lowest set bit is the highest priority event
+    int event = 0;
+    while (!(p & (1UL << event))) event++;
+    pending_clear(1UL << event);
+
+    if (handlers[event]) {
+        uint32_t start = cycle_count();
+        handlers[event]();
+        uint32_t took = cycle_count() - start;
+        stats.dispatched[event]++;
+        if (took > stats.max_cycles[event]) stats.max_cycles[event] = took;
+    }
+    return true;
+}
+
+void sched_run(void) {
+    while (1) {
+        sched_step();
+    }
+}
+
+void sched_stats(SchedStats *out, bool reset) {
+    uint32_t now = cycle_count();
+    stats.window_cycles = now - window_start;
+    if (out) *out = stats;
+    if (reset) {
+        stats.idle_cycles = 0;
+        for (int i = 0; i < EVT_COUNT; i++) {
+            stats.dispatched[i] = 0;
+            stats.max_cycles[i] = 0;
+        }
+        window_start = now;
+    }
+}
+
+uint32_t sched_idle_permille(bool reset) {
+    SchedStats s;
+    sched_stats(&s, reset);
+    if (s.window_cycles == 0) return 1000;
+    return (uint32_t)(((uint64_t)s.idle_cycles * 1000) / s.window_cycles);
+}
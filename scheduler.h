@@ -0,0 +1,72 @@
+/*
+ * Event Scheduler
+ * Objective: Run-to-completion main loop that sleeps instead of busy polling
+ *
+ * ISRs (DMA terminal count, Tickers, Serial) do the bare minimum and call sched_post().
+ * main() attaches one handler per event and then hands control to sched_run().
+ * Pending events are dispatched one at a time, lowest id first, so the id is the priority.
+ * A handler always runs to completion before the next one is picked.
+ * When nothing is pending the core sleeps in WFI until the next interrupt.
+ *
+ * The time spent asleep is accumulated so sched_idle_permille() can tell us how much
+ * headroom is really left at a given FFT size and DAC rate.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+ * Event ids, lower number == higher priority
+ * Anything that has a hardware deadline goes at the top
+ */
+enum SchedEvent {
+    EVT_DAC_REFILL = 0,     //A DAC ping-pong buffer finished playing
+    EVT_ADC_BLOCK,          //A block of ADC samples landed in memory
+    EVT_ANALYSIS,           //Run pitch/volume analysis on the last block
+    EVT_CONTROL,            //Periodic control work (note sweeps, parameter updates)
+    EVT_CAPTURE_WRITE,      //A capture block is full and can go to the file system
+    EVT_REPORT,             //Periodic status output
+    EVT_HEARTBEAT,          //LED blinking and other background work
+    EVT_LOG_FLUSH,          //A log block is full, written once nothing else is pending
+    EVT_COUNT
+};
+
+//Idle and dispatch statistics for one measurement window
+struct SchedStats {
+    uint32_t window_cycles;         //Cycles since the last reset
+    uint32_t idle_cycles;           //Cycles spent asleep in that window
+    uint32_t dispatched[EVT_COUNT]; //Handler runs per event in that window
+    uint32_t max_cycles[EVT_COUNT]; //Longest single handler run per event in that window
+};
+
+//Must be called once before any event is posted
+void sched_init(void);
+
+//Registers the handler for an event, passing 0 detaches it
+void sched_attach(int event, void (*handler)(void));
+
+//Marks an event as pending, safe to call from any ISR
+void sched_post(int event);
+
+//Runs the highest priority pending handler, or sleeps until an interrupt if there is none
+//Returns true if a handler ran
+bool sched_step(void);
+
+//Never returns, this replaces while(1) in main()
+void sched_run(void);
+
+//Idle time in 1/10 of a percent since the last reset, 1000 == completely idle
+uint32_t sched_idle_permille(bool reset);
+
+//Copies out the current window, optionally starting a new one
+void sched_stats(SchedStats *out, bool reset);
+
+/*
+ * On the host there is no WFI; the simulator installs a hook here that advances
+ * simulated time to the next peripheral event instead
+ */
+void sched_set_sleep_hook(void (*hook)(void));
+
+#endif
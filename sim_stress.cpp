@@ -0,0 +1,213 @@
+/*
+ * Simulator Stress Test
+ * Objective: Find how much interrupt jitter and CPU load each DMA configuration takes
+ *
+ * Host only. Runs the two DMA paths on the host simulator (host_sim.h) with its
+ * stress mode on and searches for the breaking point of each block size:
+ *
+ *   dac   dac_dma.cpp: synth engine, ping-pong TC ISRs arm the other buffer,
+ *         EVT_DAC_REFILL renders. Breaks on a late re-arm (the DAC held a sample)
+ *         or, under load, a buffer played again without a refill.
+ *   adc   adc_fft.cpp: ping-pong TC ISRs arm the other buffer and post
+ *         EVT_ADC_BLOCK, the handler unpacks the block and then analyses for the
+ *         load. Breaks when a conversion is lost between a block landing and the
+ *         other buffer being armed, a block lands before the handler took the
+ *         one before it (dropped, health.h), or while the handler is still busy
+ *         with it: a handler that runs past a block period only falls further
+ *         behind, which a short trial would not show as a drop.
+ *
+ * For each it reports the largest random ISR jitter with no load, the largest
+ * handler load with no jitter, and the largest load with half the jitter limit,
+ * each the last value a binary search found clean over a simulated second.
+ * The counters come from health.h, as on the board.
+ *
+ * Build:
+ *   g++ -O2 -o sim_stress sim_stress.cpp host_sim.cpp capture.cpp scheduler.cpp synth.cpp mixer.cpp noise_shape.cpp dds.cpp params.cpp adc_unpack.cpp health.cpp profile.cpp wave_table.cpp
+ *
+ * Usage: sim_stress [seconds]    (default 1 per trial)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adc_defs.h"
+#include "adc_unpack.h"
+#include "cycle_counter.h"
+#include "dds.h"
+#include "health.h"
+#include "host_sim.h"
+#include "scheduler.h"
+#include "synth.h"
+
+#define STRESS_RATE 48000
+#define STRESS_TABLE_BITS 8
+#define STRESS_MAX_BLOCK 1024
+
+static double seconds = 1.0;
+static uint32_t load = 0;       //Cycles each handler spends
+
+/*
+ * DAC path
+ */
+
+static int16_t sine_table[DDS_TABLE_LENGTH(STRESS_TABLE_BITS)];
+static Synth synth;
+static SynthBuffers synth_buffers;
+
+static void dac_TC0(void);
+static void dac_TC1(void);
+
+static void dac_TC0(void) {
+    health_dac_tc((uint32_t)sim_cycles(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
+    sim_dac_start(synth.buffer[1], synth.words, &dac_TC1);
+    synth_buffer_done(&synth, 0);
+}
+
+static void dac_TC1(void) {
+    health_dac_tc((uint32_t)sim_cycles(), synth.stats.period_cycles, synth.stats.period_cycles / synth.words);
+    sim_dac_start(synth.buffer[0], synth.words, &dac_TC0);
+    synth_buffer_done(&synth, 1);
+}
+
+static void dac_refill_handler(void) {
+    if (load) sim_spend(load);
+    synth_refill(&synth);
+}
+
+//True if a simulated run of seconds had no late re-arm and no repeated buffer
+static bool dac_run(int block, uint32_t jitter) {
+    sim_reset();
+    health_reset();
+    sim_set_irq_jitter(jitter, 12345);
+    synth_init(&synth, &synth_buffers, sine_table, STRESS_TABLE_BITS, block, STRESS_RATE);
+    mixer_add_voice(&synth.mixer, 440 << 8, STRESS_RATE, 32767);
+    synth_prime(&synth);
+
+    sched_init();
+    sched_attach(EVT_DAC_REFILL, &dac_refill_handler);
+    sched_set_sleep_hook(&sim_sleep);
+    sim_dac_start(synth.buffer[0], synth.words, &dac_TC0);
+    sim_dac_set_count(DAC_PCLK_HZ / STRESS_RATE);
+    uint64_t end = (uint64_t)(seconds * CCLK_HZ);
+    while (sim_cycles() < end && !sim_finished()) sched_step();
+    return health.dac_late_rearms == 0 && health.dac_repeats == 0;
+}
+
+/*
+ * ADC path
+ */
+
+//Endless sine at a fixed ADC rate, channel 0
+class ToneSource : public SampleSource {
+public:
+    ToneSource() : n(0) {}
+    virtual bool next(uint16_t *sample) {
+        *sample = (uint16_t)(2048 + 1500 * sin(2 * M_PI * 440.0 * n++ / STRESS_RATE));
+        return true;
+    }
+private:
+    uint64_t n;
+};
+
+static ToneSource tone;
+static uint32_t adc_words[2][STRESS_MAX_BLOCK];
+static int16_t adc_samples[STRESS_MAX_BLOCK];
+static int adc_block;
+static int adc_ready;           //Buffer the DMA just finished
+static bool adc_untaken;        //and the handler has not taken it yet
+static bool adc_busy;           //Handler running
+static uint32_t adc_behind;     //Blocks that landed while it was
+
+static void adc_TC0(void);
+static void adc_TC1(void);
+
+//As adc_fft.cpp's adc_block_landed(): arm the other buffer, then hand this one over
+static void adc_landed(int b) {
+    health_adc_landed((uint32_t)sim_cycles());
+    sim_adc_start(adc_words[b ^ 1], adc_block, b ? &adc_TC0 : &adc_TC1);
+    health_adc_rearmed((uint32_t)sim_cycles());
+    health_adc_armed((uint32_t)sim_cycles(), (uint32_t)((uint64_t)CCLK_HZ * adc_block / STRESS_RATE));
+    if (adc_untaken) health.adc_dropped++;
+    if (adc_busy) adc_behind++;
+    adc_ready = b;
+    adc_untaken = true;
+    sched_post(EVT_ADC_BLOCK);
+}
+
+static void adc_TC0(void) {
+    adc_landed(0);
+}
+
+static void adc_TC1(void) {
+    adc_landed(1);
+}
+
+//Unpack, then the analysis load while the other buffer fills
+static void adc_block_handler(void) {
+    int b = adc_ready;
+    adc_untaken = false;
+    adc_busy = true;
+    adc_unpack_real(adc_words[b], adc_samples, adc_block, 0, &health.adc);
+    if (load) sim_spend(load);
+    adc_busy = false;
+}
+
+//True if a simulated run of seconds lost no conversion and dropped no block
+static bool adc_run(int block, uint32_t jitter) {
+    sim_reset();
+    health_reset();
+    sim_set_irq_jitter(jitter, 12345);
+    sim_adc_attach(&tone, STRESS_RATE);
+    adc_block = block;
+    adc_ready = 0;
+    adc_untaken = adc_busy = false;
+    adc_behind = 0;
+
+    sched_init();
+    sched_attach(EVT_ADC_BLOCK, &adc_block_handler);
+    sched_set_sleep_hook(&sim_sleep);
+    sim_adc_start(adc_words[0], adc_block, &adc_TC0);
+    health_adc_armed(0, (uint32_t)((uint64_t)CCLK_HZ * adc_block / STRESS_RATE));
+    uint64_t end = (uint64_t)(seconds * CCLK_HZ);
+    while (sim_cycles() < end && !sim_finished()) sched_step();
+    return sim_adc_lost() == 0 && health.adc.overruns == 0 && health.adc_dropped == 0 && adc_behind == 0;
+}
+
+//Largest value in 0..hi for which run stays clean, *value is either jitter or load
+static uint32_t search(bool (*run)(int, uint32_t), int block, uint32_t hi, bool jitter, uint32_t fixed) {
+    uint32_t lo = 0;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if (jitter) load = fixed;
+        else load = mid;
+        bool clean = run(block, jitter ? mid : fixed);
+        if (clean) lo = mid;
+        else hi = mid - 1;
+    }
+    load = 0;
+    return lo;
+}
+
+static void stress(const char *name, bool (*run)(int, uint32_t), int block) {
+    uint32_t period = (uint32_t)((uint64_t)CCLK_HZ * block / STRESS_RATE);
+    uint32_t jitter = search(run, block, period, true, 0);
+    uint32_t busy = search(run, block, 2 * period, false, 0);
+    uint32_t busy_jitter = search(run, block, 2 * period, false, jitter / 2);
+    printf("%-4s %5d %8.0f %10u %10u %5.1f%% %10u %5.1f%%\n", name, block, period * 1e6 / CCLK_HZ,
+        jitter, busy, 100.0 * busy / period, busy_jitter, 100.0 * busy_jitter / period);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) seconds = atof(argv[1]);
+    dds_table_init(sine_table, STRESS_TABLE_BITS);
+
+    printf("path block   period  max jitter   max load of block  load, jitter/2\n");
+    printf("                 us      cycles      cycles                cycles\n");
+    static const int dac_blocks[] = { 64, 128, 256, 512 };
+    for (int i = 0; i < 4; i++) stress("dac", dac_run, dac_blocks[i]);
+    static const int adc_blocks[] = { 256, 1024 };
+    for (int i = 0; i < 2; i++) stress("adc", adc_run, adc_blocks[i]);
+    printf("one DAC update or ADC conversion is %lu cycles at %u Hz\n", CCLK_HZ / STRESS_RATE, STRESS_RATE);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * SRAM Placement
+ * See sram.h
+ *
+ * The list head is zero before any constructor runs, so entries can be listed from
+ * any translation unit in any order.
+ */
+
+#include "sram.h"
+
+static SramEntry *entries;
+
+static const char *const bank_names[SRAM_BANKS] = { "local", "ahb0", "ahb1" };
+static const uint32_t bank_base[SRAM_BANKS] = { 0x10000000, 0x2007C000, 0x20080000 };
+static const uint32_t bank_size[SRAM_BANKS] = { SRAM_LOCAL_SIZE, SRAM_AHB_SIZE, SRAM_AHB_SIZE };
+
+SramEntry::SramEntry(SramBank bank, const char *name, const void *addr, size_t size)
+    : bank(bank), name(name), addr(addr), size(size), next(entries) {
+    entries = this;
+}
+
+size_t sram_used(SramBank bank) {
+    size_t used = 0;
+    for (const SramEntry *e = entries; e; e = e->next) {
+        if (e->bank == bank) used += e->size;
+    }
+    return used;
+}
+
+//Where the buffer really is, always true on the host
+static bool in_bank(const SramEntry *e) {
+#ifdef TARGET_LPC1768
+    uint32_t start = (uint32_t)(uintptr_t)e->addr;
+    return start >= bank_base[e->bank] && start + e->size <= bank_base[e->bank] + bank_size[e->bank];
+#else
+    (void)e;
+    return true;
+#endif
+}
+
+bool sram_check(void) {
+    for (int b = 0; b < SRAM_BANKS; b++) {
+        if (sram_used((SramBank)b) > bank_size[b]) return false;
+    }
+    for (const SramEntry *e = entries; e; e = e->next) {
+        if (!in_bank(e)) return false;
+    }
+    return true;
+}
+
+void sram_report(FILE *f) {
+    for (int b = 0; b < SRAM_BANKS; b++) {
+        for (const SramEntry *e = entries; e; e = e->next) {
+            if (e->bank != b) continue;
+            fprintf(f, "%-5s %08lx %6u %s%s\n", bank_names[b], (unsigned long)(uintptr_t)e->addr,
+                (unsigned)e->size, e->name, in_bank(e) ? "" : " (not in this bank)");
+        }
+    }
+    for (int b = 0; b < SRAM_BANKS; b++) {
+        size_t used = sram_used((SramBank)b);
+        fprintf(f, "%-5s %u of %u bytes listed, %d free\n", bank_names[b], (unsigned)used,
+            (unsigned)bank_size[b], (int)bank_size[b] - (int)used);
+    }
+}
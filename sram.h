@@ -0,0 +1,87 @@
+/*
+ * SRAM Placement
+ * Objective: Keep the DMA and the CPU out of each other's way on the bus
+ *
+ * The LPC1768 has three blocks of SRAM, each on its own bus matrix port:
+ *
+ *   LOCAL  32KB at 0x10000000, on the core's code and system buses. Stack, heap and
+ *          every ordinary global end up here.
+ *   AHB0   16KB at 0x2007C000 (AHBSRAM0 section), on the AHB matrix.
+ *   AHB1   16KB at 0x20080000 (AHBSRAM1 section), its own port on the AHB matrix.
+ *
+ * A DMA burst into a bank only stalls the core when the core wants the same bank
+ * in the same cycle. So the buffers a DMA channel streams through go in an AHB
+ * bank, capture (ADC) in AHB0 and playback (DAC) in AHB1, and everything the CPU
+ * grinds on (FFT scratch, windows, mixers, stacks) stays in LOCAL.
+ *
+ * Declare a buffer with its bank after the declarator, then list it for the report:
+ *
+ *   uint32_t adcInputBuffer[N] SRAM_IN(AHB0);
+ *   SRAM_LIST(AHB0, adcInputBuffer);
+ *
+ * The AHB sections are NOLOAD in the mbed linker scripts: nothing in them is zeroed
+ * or initialised at reset, clear them before use. mbed itself only puts the
+ * Ethernet and USB device buffers there, neither of which these programs build in.
+ *
+ * On the host the placement is ignored and the report just adds up the sizes.
+ */
+
+#ifndef SRAM_H
+#define SRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum SramBank {
+    SRAM_LOCAL,
+    SRAM_AHB0,
+    SRAM_AHB1,
+    SRAM_BANKS
+};
+
+#define SRAM_LOCAL_SIZE 32768
+#define SRAM_AHB_SIZE 16384
+
+#ifdef TARGET_LPC1768
+#define SRAM_SECTION_LOCAL __attribute__((aligned(4)))
+#define SRAM_SECTION_AHB0 __attribute__((section("AHBSRAM0"), aligned(4)))
+#define SRAM_SECTION_AHB1 __attribute__((section("AHBSRAM1"), aligned(4)))
+#else
+#define SRAM_SECTION_LOCAL __attribute__((aligned(4)))
+#define SRAM_SECTION_AHB0 __attribute__((aligned(4)))
+#define SRAM_SECTION_AHB1 __attribute__((aligned(4)))
+#endif
+
+//Placement for a buffer declaration, bank is LOCAL, AHB0 or AHB1
+#define SRAM_IN(bank) SRAM_SECTION_##bank
+
+//One listed buffer, linked into the report by its constructor
+struct SramEntry {
+    SramEntry(SramBank bank, const char *name, const void *addr, size_t size);
+    SramBank bank;
+    const char *name;
+    const void *addr;
+    size_t size;
+    SramEntry *next;
+};
+
+//Lists buffer under bank for sram_report(), a buffer bigger than the bank does not compile
+#define SRAM_LIST(bank, buffer) \
+    static_assert(sizeof(buffer) <= (SRAM_##bank == SRAM_LOCAL ? SRAM_LOCAL_SIZE : SRAM_AHB_SIZE), \
+        #buffer " does not fit in " #bank); \
+    static SramEntry buffer##_sram(SRAM_##bank, #buffer, &buffer, sizeof(buffer))
+
+//Bytes listed in bank
+size_t sram_used(SramBank bank);
+
+/*
+ * False if a bank is over its size or, on the board, a listed buffer is not where
+ * it was put (a linker script without the AHBSRAM sections). Call once at boot.
+ */
+bool sram_check(void);
+
+//Every listed buffer by bank with its address and size, then each bank's total and what is free
+void sram_report(FILE *f);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Block Synthesis Engine
+ * See synth.h
+ */
+
+#include <string.h>
+
+#include "cycle_counter.h"
+#include "dds.h"
+#include "health.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "synth.h"
+
+bool synth_init(Synth *s, SynthBuffers *buffers, const int16_t *table, int bits, int block, uint32_t sample_rate) {
+    if (block < 4 || block > SYNTH_MAX_BLOCK || sample_rate == 0) return false;
+    memset(s, 0, sizeof(*s));
+    s->buffer[0] = (*buffers)[0];
+    s->buffer[1] = (*buffers)[1];
+    mixer_init(&s->mixer, table, bits);
+    s->block = block;
+    s->words = block;
+    noise_shape_init(&s->shaper, 1, 0, false);
+    s->sample_rate = sample_rate;
+    s->gain = s->target_gain = 32767;
+    s->tone = 32767;
+    s->stats.period_cycles = (uint32_t)((uint64_t)CCLK_HZ * block / sample_rate);
+    s->voice = -1;
+    s->waveforms[0] = table;
+    return true;
+}
+
+bool synth_set_output(Synth *s, int oversample, int order, bool dither) {
+    if (s->block * oversample > SYNTH_MAX_WORDS) return false;
+    if (!noise_shape_init(&s->shaper, oversample, order, dither)) return false;
+    s->words = s->block * oversample;
+    return true;
+}
+
+bool synth_set_waveform(Synth *s, int index, const int16_t *table) {
+    if (index < 0 || index >= SYNTH_WAVEFORMS) return false;
+    s->waveforms[index] = table;
+    return true;
+}
+
+void synth_attach_params(Synth *s, const ParamsBlock *b, int voice) {
+    params_reader_init(&s->reader, b);
+    s->control = s->reader.last;
+    s->freq_q8 = s->control.freq_q8;
+    s->voice = voice;
+    s->params = b;
+}
+
+//Newest parameters, then one glide step per block
+static void follow_params(Synth *s) {
+    if (params_read(&s->reader, s->params, &s->control)) {
+        s->target_gain = s->control.gain;
+        int w = s->control.waveform;
+        if (w < SYNTH_WAVEFORMS && s->waveforms[w]) s->mixer.table = s->waveforms[w];
+    }
+
+    //One pole towards the target, k = block period / time constant in Q15
+    int64_t diff = (int64_t)s->control.freq_q8 - s->freq_q8;
+    uint32_t k = 32768;
+    if (s->control.glide_ms) {
+        uint64_t q = ((uint64_t)s->block * 1000 << 15) / ((uint64_t)s->control.glide_ms * s->sample_rate);
+        if (q < k) k = (uint32_t)q;
+    }
+    int64_t step = (diff * k) >> 15;
+    //The last fraction of a Q8 Hz would never close
+    if (step == 0) step = diff;
+    s->freq_q8 = (uint32_t)(s->freq_q8 + step);
+    if (s->voice >= 0 && s->voice < s->mixer.voices) {
+        mixer_set_voice(&s->mixer, s->voice, s->freq_q8, s->sample_rate, (int16_t)s->mixer.gain[s->voice]);
+    }
+}
+
+static void render(Synth *s, uint32_t *out) {
+    int n = s->block;
+    int32_t *mix = s->mixer.mix;
+
+    if (s->params) follow_params(s);
+    if (s->source) s->source(mix, n);
+    else mixer_render_mix(&s->mixer, n);
+    if (s->effect) s->effect(mix, n);
+
+    //Gain steps a little every sample so a change never clicks
+    int32_t gain = s->gain, dgain = (s->target_gain - s->gain) / n;
+    int32_t tone = s->tone, y = s->tone_state;
+    if (noise_shape_is_plain(&s->shaper)) {
+        for (int i = 0; i < n; i++) {
+            int32_t v = (dds_saturate(mix[i]) * gain) >> 15;
+            y += ((v - y) * tone) >> 15;
+            out[i] = dds_dacr(y);
+            gain += dgain;
+        }
+    } else {
+        //Filtered samples back into mix, then words DAC updates from them
+        for (int i = 0; i < n; i++) {
+            int32_t v = (dds_saturate(mix[i]) * gain) >> 15;
+            y += ((v - y) * tone) >> 15;
+            mix[i] = y;
+            gain += dgain;
+        }
+        noise_shape_render(&s->shaper, mix, out, n);
+    }
+    s->gain = s->target_gain;
+    s->tone_state = y;
+    s->stats.blocks++;
+}
+
+void synth_prime(Synth *s) {
+    render(s, s->buffer[0]);
+    render(s, s->buffer[1]);
+    s->dirty[0] = s->dirty[1] = 0;
+}
+
+void synth_buffer_done(Synth *s, int b) {
+    //The buffer the DMA just moved on to was never refilled, it replays old samples
+    if (s->dirty[b ^ 1]) {
+        s->stats.underruns++;
+        health.dac_repeats++;
+    }
+    s->done_at[b] = cycle_count();
+    s->last_done = b;
+    s->dirty[b] = 1;
+    sched_post(EVT_DAC_REFILL);
+}
+
+void synth_refill(Synth *s) {
+    //The buffer that finished last plays after the current one, do it first
+    int first = s->last_done;
+    for (int k = 0; k < 2; k++) {
+        int b = k ? first ^ 1 : first;
+        if (!s->dirty[b]) continue;
+
+        uint32_t start = cycle_count();
+        render(s, s->buffer[b]);
+        uint32_t end = cycle_count();
+        s->dirty[b] = 0;
+        PROFILE_ADD(PROF_SYNTH, end - start);
+
+        if (end - start > s->stats.max_render_cycles) s->stats.max_render_cycles = end - start;
+        if (end - s->done_at[b] > s->stats.max_wait_cycles) s->stats.max_wait_cycles = end - s->done_at[b];
+    }
+}
+
+void synth_stats(Synth *s, SynthStats *out, bool reset) {
+    *out = s->stats;
+    if (reset) {
+        s->stats.blocks = 0;
+        s->stats.max_render_cycles = 0;
+        s->stats.max_wait_cycles = 0;
+    }
+}
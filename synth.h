@@ -0,0 +1,119 @@
+/*
+ * Block Synthesis Engine
+ * Objective: Render the output a block at a time into whichever ping-pong buffer is free
+ *
+ * The DAC DMA plays buffer[0] and buffer[1] in turn. When one finishes, its
+ * terminal count ISR starts the other one and calls synth_buffer_done(), which
+ * posts EVT_DAC_REFILL. synth_refill() then renders the next block into the
+ * buffer that just finished, so it is ready before the playing one runs out:
+ *
+ *   mixer voices (or source hook) -> effect hook -> master gain (ramped) -> tone low pass -> output stage -> DACR
+ *
+ * The output stage truncates to the 10 bit DAC unless synth_set_output() turns
+ * on oversampling, dither and noise shaping (noise_shape.h). Oversampled, each
+ * buffer holds words = block * oversample DAC updates and the DAC has to run at
+ * sample_rate * oversample; block, the latency and the deadline stay in samples.
+ *
+ * With a parameter block attached (params.h) every render first takes the newest
+ * consistent set from it: the gain becomes the master gain target, the waveform
+ * picks one of the tables given to synth_set_waveform(), and the driven voice
+ * slides to the new pitch with glide_ms as its time constant, retuned once a block.
+ *
+ * The renderer has one block period to get there. If a buffer finishes while
+ * the other one was never refilled, the DMA has to replay stale samples and
+ * that is counted as an underrun.
+ *
+ * The two buffers are the caller's, so they can go where the DMA has the bus to
+ * itself (sram.h) while the mixer and the rest of the state stay in local SRAM.
+ *
+ * block trades latency (two blocks from render to AOUT) against the fixed cost
+ * paid once per block (ISR, scheduler, loop setup).
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+
+#include "mixer.h"
+#include "noise_shape.h"
+#include "params.h"
+
+#define SYNTH_MAX_BLOCK MIXER_MAX_BLOCK
+#define SYNTH_MAX_WORDS (2 * SYNTH_MAX_BLOCK)    //DAC words per buffer, oversampled
+#define SYNTH_WAVEFORMS 4
+
+//Ping-pong DMA source, DACR words
+typedef uint32_t SynthBuffers[2][SYNTH_MAX_WORDS];
+
+struct SynthStats {
+    uint32_t blocks;            //Blocks rendered
+    uint32_t underruns;         //Buffers that were played again without being refilled
+    uint32_t max_render_cycles; //Longest single render
+    uint32_t max_wait_cycles;   //Longest time from a buffer finishing to it being refilled
+    uint32_t period_cycles;     //Deadline, one block period
+};
+
+struct Synth {
+    Mixer    mixer;                             //Oscillators, add voices with mixer_add_voice()
+    uint32_t *buffer[2];                        //DMA source, the SynthBuffers given to synth_init()
+    int      block;                             //Samples per buffer
+    int      words;                             //DAC words per buffer, the DMA transfer size
+    NoiseShaper shaper;                         //Output stage, see synth_set_output()
+    uint32_t sample_rate;                       //Samples a second, the DAC updates oversample times as often
+    int32_t  gain;                              //Q15 master gain, ramps to target_gain over one block
+    int32_t  target_gain;
+    int32_t  tone;                              //Q15 one pole low pass coefficient, 32767 is flat
+    int32_t  tone_state;
+    void   (*source)(int32_t *mix, int count);  //Optional, fills the Q15 sum instead of the mixer voices
+    void   (*effect)(int32_t *mix, int count);  //Optional, runs on the Q15 voice sum
+    const ParamsBlock *params;                  //Optional, see synth_attach_params()
+    ParamsReader reader;
+    ControlParams control;                      //Set in use
+    int      voice;                             //Mixer voice the parameters tune, -1 for none
+    uint32_t freq_q8;                           //Where the glide has got to, for a source hook too
+    const int16_t *waveforms[SYNTH_WAVEFORMS];  //0 is the table synth_init() was given
+    volatile uint8_t  dirty[2];                 //Set by the ISR when a buffer finished playing
+    volatile uint8_t  last_done;
+    volatile uint32_t done_at[2];               //cycle_count() when each buffer finished
+    SynthStats stats;
+};
+
+//Renders into buffers, returns false if block is out of range
+bool synth_init(Synth *s, SynthBuffers *buffers, const int16_t *table, int bits, int block, uint32_t sample_rate);
+
+/*
+ * Output stage: oversample 1, 2, 4 or 8 DAC words a sample, noise shaping order
+ * 0 to 2, TPDF dither. False if the settings are out of range or block * oversample
+ * is over SYNTH_MAX_WORDS. Call before synth_prime(), then run the DAC at
+ * sample_rate * oversample with s->words a transfer.
+ */
+bool synth_set_output(Synth *s, int oversample, int order, bool dither);
+
+//Table for waveform index, same bits as the one given to synth_init(), false if index is out of range
+bool synth_set_waveform(Synth *s, int index, const int16_t *table);
+
+/*
+ * Takes pitch, gain and waveform from b from the next block on, retuning voice
+ * (-1 leaves the voices alone, a source hook can follow s->freq_q8 instead)
+ */
+void synth_attach_params(Synth *s, const ParamsBlock *b, int voice);
+
+//Renders both buffers, call once before the DMA starts
+void synth_prime(Synth *s);
+
+//From the terminal count ISR of buffer b, after the other buffer has been started
+void synth_buffer_done(Synth *s, int b);
+
+//EVT_DAC_REFILL handler body, renders every buffer that is waiting
+void synth_refill(Synth *s);
+
+//Time from a block being rendered to it reaching AOUT, at most
+static inline uint32_t synth_latency_us(const Synth *s) {
+    return (uint32_t)(2ULL * s->block * 1000000 / s->sample_rate);
+}
+
+//Copies the statistics, reset starts a new window (underruns are never reset)
+void synth_stats(Synth *s, SynthStats *out, bool reset);
+
+#endif
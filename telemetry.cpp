@@ -0,0 +1,245 @@
+/*
+ * Binary Telemetry
+ * See telemetry.h
+ */
+
+#include "cycle_counter.h"
+#include "telemetry.h"
+
+//type + seq + payload + crc, and the COBS worst case of one extra byte per 254 plus the delimiter
+#define TLM_FRAME_MAX (2 + TLM_MAX_PAYLOAD + 2)
+#define TLM_WIRE_MAX (TLM_FRAME_MAX + TLM_FRAME_MAX / 254 + 2)
+
+static uint8_t ring[TLM_RING_SIZE];
+static volatile uint32_t head = 0;      //Written by tlm_send()
+static volatile uint32_t tail = 0;      //Written by tlm_read()
+static uint8_t seq = 0;
+static uint32_t sent = 0;
+static uint32_t dropped = 0;
+
+void tlm_init(void) {
+    head = tail = 0;
+    seq = 0;
+    sent = dropped = 0;
+    //A leading delimiter, so a decoder that was already listening syncs on the first frame
+    ring[head++] = 0;
+}
+
+//CRC-16/CCITT-FALSE, poly 0x1021, init 0xFFFF, a nibble at a time from a 16 entry table
+uint16_t tlm_crc16(const uint8_t *data, int length) {
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+int tlm_cobs_encode(const uint8_t *src, int length, uint8_t *dst) {
+    int code_pos = 0, out = 1;
+    uint8_t code = 1;
+    for (int i = 0; i < length; i++) {
+        if (src[i] == 0) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        } else {
+            dst[out++] = src[i];
+            if (++code == 0xFF) {
+                dst[code_pos] = code;
+                code_pos = out++;
+                code = 1;
+            }
+        }
+    }
+    dst[code_pos] = code;
+    return out;
+}
+
+int tlm_cobs_decode(const uint8_t *src, int length, uint8_t *dst) {
+    int in = 0, out = 0;
+    while (in < length) {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1 > length) return -1;
+        for (int i = 1; i < code; i++) dst[out++] = src[in++];
+        if (code != 0xFF && in < length) dst[out++] = 0;
+    }
+    return out;
+}
+
+int tlm_pending(void) {
+    return (int)(head - tail);
+}
+
+bool tlm_send(uint8_t type, const uint8_t *payload, int length) {
+    uint8_t frame[TLM_FRAME_MAX];
+    uint8_t wire[TLM_WIRE_MAX];
+
+    if (length > TLM_MAX_PAYLOAD) return false;
+    frame[0] = type;
+    frame[1] = seq++;
+    for (int i = 0; i < length; i++) frame[2 + i] = payload[i];
+    uint16_t crc = tlm_crc16(frame, 2 + length);
+    frame[2 + length] = crc & 0xFF;
+    frame[3 + length] = crc >> 8;
+
+    int n = tlm_cobs_encode(frame, 4 + length, wire);
+    wire[n++] = 0;
+
+    uint32_t h = head;
+    if (TLM_RING_SIZE - (h - tail) < (uint32_t)n) {
+        dropped++;
+        return false;
+    }
+    for (int i = 0; i < n; i++) ring[(h + i) & (TLM_RING_SIZE - 1)] = wire[i];
+    head = h + n;   //Publish only once the whole frame is in
+    sent++;
+    return true;
+}
+
+int tlm_read(uint8_t *dst, int max) {
+    uint32_t t = tail;
+    int n = (int)(head - t);
+    if (n > max) n = max;
+    for (int i = 0; i < n; i++) dst[i] = ring[(t + i) & (TLM_RING_SIZE - 1)];
+    tail = t + n;
+    return n;
+}
+
+uint32_t tlm_sent(void) {
+    return sent;
+}
+
+uint32_t tlm_dropped(void) {
+    return dropped;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+    p = put16(p, v & 0xFFFF);
+    return put16(p, v >> 16);
+}
+
+bool tlm_send_pitch(uint32_t raw_q8, uint32_t tracked_q8, uint16_t confidence, uint16_t volume, uint32_t played_q8) {
+    uint8_t buf[20], *p = buf;
+    p = put32(p, cycle_count());
+    p = put32(p, raw_q8);
+    p = put32(p, tracked_q8);
+    p = put16(p, confidence);
+    p = put16(p, volume);
+    p = put32(p, played_q8);
+    return tlm_send(TLM_PITCH, buf, p - buf);
+}
+
+bool tlm_send_timing(const uint32_t *stage_cycles, int count) {
+    uint8_t buf[5 + 4 * TLM_TIMING_STAGES], *p = buf;
+    if (count > TLM_TIMING_STAGES) count = TLM_TIMING_STAGES;
+    p = put32(p, cycle_count());
+    *p++ = (uint8_t)count;
+    for (int i = 0; i < count; i++) p = put32(p, stage_cycles[i]);
+    return tlm_send(TLM_TIMING, buf, p - buf);
+}
+
+bool tlm_send_status(uint32_t idle_permille, uint32_t skip_permille) {
+    uint8_t buf[16], *p = buf;
+    p = put32(p, cycle_count());
+    p = put16(p, (uint16_t)idle_permille);
+    p = put32(p, sent);
+    p = put32(p, dropped);
+    p = put16(p, (uint16_t)skip_permille);
+    return tlm_send(TLM_STATUS, buf, p - buf);
+}
+
+bool tlm_send_calib(int event, int points, uint32_t antenna_q8, uint32_t note_q8) {
+    uint8_t buf[14], *p = buf;
+    p = put32(p, cycle_count());
+    *p++ = (uint8_t)event;
+    *p++ = (uint8_t)points;
+    p = put32(p, antenna_q8);
+    p = put32(p, note_q8);
+    return tlm_send(TLM_CALIB, buf, p - buf);
+}
+
+bool tlm_send_health(const Health *h) {
+    uint8_t buf[48], *p = buf;
+    p = put32(p, cycle_count());
+    p = put32(p, h->adc_blocks);
+    p = put32(p, h->adc.overruns);
+    p = put32(p, h->adc.not_done + h->adc.wrong_channel);
+    p = put32(p, h->adc_latency_max);
+    p = put32(p, h->adc_gap_max);
+    p = put32(p, h->capture_dropped);
+    p = put32(p, h->dac_blocks);
+    p = put32(p, h->dac_late_rearms);
+    p = put32(p, h->dac_repeats);
+    p = put32(p, h->dac_latency_max);
+    p = put32(p, h->adc_dropped);
+    return tlm_send(TLM_HEALTH, buf, p - buf);
+}
+
+bool tlm_send_midi(const MidiStats *m) {
+    uint8_t buf[28], *p = buf;
+    p = put32(p, cycle_count());
+    p = put32(p, m->messages);
+    p = put32(p, m->bytes);
+    p = put32(p, m->running);
+    p = put32(p, m->coalesced);
+    p = put32(p, m->latency_count ? (uint32_t)(m->latency_total / m->latency_count) : 0);
+    p = put32(p, m->latency_max);
+    return tlm_send(TLM_MIDI, buf, p - buf);
+}
+
+bool tlm_send_profile(int scope, uint32_t runs, uint32_t min, uint32_t mean, uint32_t max,
+                      const uint32_t *hist, int bins) {
+    uint8_t buf[TLM_MAX_PAYLOAD], *p = buf;
+    if (bins > (TLM_MAX_PAYLOAD - 23) / 2) bins = (TLM_MAX_PAYLOAD - 23) / 2;
+    p = put32(p, cycle_count());
+    *p++ = (uint8_t)scope;
+    p = put32(p, runs);
+    p = put32(p, min);
+    p = put32(p, mean);
+    p = put32(p, max);
+    *p++ = (uint8_t)bins;
+    for (int b = 0; b < bins; b++) p = put16(p, (uint16_t)(hist[b] > 65535 ? 65535 : hist[b]));
+    return tlm_send(TLM_PROFILE, buf, p - buf);
+}
+
+//8 * log2(v), the fraction from the three bits below the top one
+static uint8_t log2_q3(uint32_t v) {
+    if (v == 0) return 0;
+    int top = 31;
+    while (!(v & (1UL << top))) top--;
+    uint32_t frac = top >= 3 ? (v >> (top - 3)) & 7 : (v << (3 - top)) & 7;
+    return (uint8_t)(8 * top + frac);
+}
+
+bool tlm_send_spectrum(const short *y, int N, uint32_t sample_rate, int count) {
+    uint8_t buf[9 + TLM_MAX_PAYLOAD], *p = buf;
+    int half = N / 2;
+    if (count > TLM_MAX_PAYLOAD - 9) count = TLM_MAX_PAYLOAD - 9;
+    if (count > half) count = half;
+    int per = half / count;
+
+    p = put32(p, cycle_count());
+    p = put32(p, (uint32_t)(((uint64_t)sample_rate << 8) * per / N));   //Hz * 256 per level
+    *p++ = (uint8_t)count;
+    for (int b = 0; b < count; b++) {
+        uint32_t loudest = 0;
+        for (int k = b * per; k < (b + 1) * per; k++) {
+            int32_t re = y[2 * k], im = y[2 * k + 1];
+            uint32_t mag = (re < 0 ? -re : re) + (im < 0 ? -im : im);
+            if (mag > loudest) loudest = mag;
+        }
+        *p++ = log2_q3(loudest);
+    }
+    return tlm_send(TLM_SPECTRUM, buf, p - buf);
+}
@@ -0,0 +1,95 @@
+/*
+ * Binary Telemetry
+ * Objective: Stream analysis results over the USB serial link without choking it
+ *
+ * Text lines at 115200 baud run out of link after a few dozen values a second.
+ * Instead each record is a small binary frame:
+ *
+ *   type (1) | seq (1) | payload (0..TLM_MAX_PAYLOAD) | CRC-16/CCITT of the above (2, LE)
+ *
+ * COBS encoded, so the only 0x00 on the wire is the delimiter after each frame.
+ * A decoder can join at any point, drops a frame with a bad CRC and sees lost
+ * frames as gaps in seq. All fields are little endian.
+ *
+ * tlm_send() only copies the encoded frame into a TX ring and never waits.
+ * If the ring is full the frame is dropped and counted (its seq is still used up).
+ * The link side drains the ring with tlm_read(), from the UART TX interrupt on
+ * the mbed, as many bytes as the FIFO takes at a time.
+ * One producer (main context) and one consumer (the ISR), so no locking is needed.
+ *
+ * telemetry_decode turns a recorded stream back into CSV files.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#include "health.h"
+#include "midi_out.h"
+
+#define TLM_RING_SIZE 2048      //Power of 2, ~180ms of link at 115200 baud
+#define TLM_MAX_PAYLOAD 128
+#define TLM_TIMING_STAGES 4
+
+enum TlmType {
+    TLM_PITCH = 1,      //u32 time, u32 raw_q8, u32 tracked_q8, u16 confidence (Q15), u16 volume (input RMS, Q15), u32 played_q8
+    TLM_TIMING,         //u32 time, u8 count, count * u32 stage cycles
+    TLM_SPECTRUM,       //u32 time, u32 bin_hz_q8, u8 count, count * u8 level (1/8 of log2 magnitude)
+    TLM_STATUS,         //u32 time, u16 idle permille, u32 frames sent, u32 frames dropped, u16 analysis skipped permille
+    TLM_PROFILE,        //u32 time, u8 scope, u32 runs, u32 min, u32 mean, u32 max cycles, u8 bins, bins * u16 histogram (saturated)
+    TLM_CALIB,          //u32 time, u8 event (TlmCalibEvent), u8 points so far, u32 antenna_q8, u32 note_q8
+    TLM_HEALTH,         //u32 time, 11 * u32: adc blocks, overrun words, other bad words, worst ISR, worst DMA gap,
+                        //capture dropped, dac blocks, late re-arms, repeated buffers, worst ISR,
+                        //adc blocks dropped (health.h, the last one is new, older frames end before it)
+    TLM_MIDI            //u32 time, 6 * u32: messages, bytes, status bytes saved, coalesced results,
+                        //mean and worst result to UART cycles (midi_out.h)
+};
+
+enum TlmCalibEvent {
+    TLM_CALIB_START = 0,    //Recording starts, note_q8 is the first note to play
+    TLM_CALIB_POINT,        //A reference point was recorded
+    TLM_CALIB_REJECT,       //No steady pitch to record, play the note again
+    TLM_CALIB_SAVED,        //Table written and in use
+    TLM_CALIB_FAILED        //Too few points, or the file could not be written
+};
+
+void tlm_init(void);
+
+//Encodes one frame into the TX ring, false if it was dropped
+bool tlm_send(uint8_t type, const uint8_t *payload, int length);
+
+//Bytes waiting for the link
+int tlm_pending(void);
+
+//Takes up to max bytes off the ring for the link, returns how many
+int tlm_read(uint8_t *dst, int max);
+
+uint32_t tlm_sent(void);
+uint32_t tlm_dropped(void);
+
+//Record builders, time is cycle_count() at the moment of the call
+bool tlm_send_pitch(uint32_t raw_q8, uint32_t tracked_q8, uint16_t confidence, uint16_t volume, uint32_t played_q8);
+bool tlm_send_timing(const uint32_t *stage_cycles, int count);
+bool tlm_send_status(uint32_t idle_permille, uint32_t skip_permille);
+bool tlm_send_calib(int event, int points, uint32_t antenna_q8, uint32_t note_q8);
+bool tlm_send_health(const Health *h);
+bool tlm_send_midi(const MidiStats *m);
+
+//One profiler scope (profile.h), histogram counts above 65535 are sent as 65535
+bool tlm_send_profile(int scope, uint32_t runs, uint32_t min, uint32_t mean, uint32_t max,
+                      const uint32_t *hist, int bins);
+
+/*
+ * Spectrum from an fftR4 output of N complex bins, decimated to count levels over
+ * bins 0..N/2, each the loudest bin it covers as 8 * log2(|re| + |im|), ~0.75dB a step
+ */
+bool tlm_send_spectrum(const short *y, int N, uint32_t sample_rate, int count);
+
+//Shared with the decoder
+uint16_t tlm_crc16(const uint8_t *data, int length);
+int tlm_cobs_encode(const uint8_t *src, int length, uint8_t *dst);
+//Returns the decoded length, or -1 if the block structure is broken
+int tlm_cobs_decode(const uint8_t *src, int length, uint8_t *dst);
+
+#endif
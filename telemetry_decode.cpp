@@ -0,0 +1,229 @@
+/*
+ * Telemetry Decoder
+ * Objective: Turn the binary telemetry stream into tables for analysis
+ *
+ * Host only. Reads the raw bytes from the mbed's serial port (or a file they were
+ * saved to), splits frames at 0x00, COBS decodes them, checks the CRC and writes
+ * one CSV per record type. Every CSV has a typed header row (name:type) so the
+ * files load straight into pandas/arrow with the right column types.
+ *
+ * Build:
+ *   g++ -O2 -o telemetry_decode telemetry_decode.cpp telemetry.cpp profile.cpp
+ *
+ * Usage: telemetry_decode [-o prefix] [FILE]
+ *   FILE defaults to stdin, e.g. stty -F /dev/ttyACM0 115200 raw; telemetry_decode -o run1 < /dev/ttyACM0
+ *   writes prefix_pitch.csv, prefix_timing.csv, prefix_spectrum.csv, prefix_status.csv,
+ *   prefix_profile.csv, prefix_calib.csv, prefix_health.csv, prefix_midi.csv
+ *
+ * time_s is the mbed cycle counter converted to seconds, unwrapped across its
+ * 44 second wrap. A summary of good, corrupt and lost frames goes to stderr.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "cycle_counter.h"
+#include "profile.h"
+#include "telemetry.h"
+
+#define MAX_WIRE 512
+
+struct Stream {
+    FILE *pitch, *timing, *spectrum, *status, *profile, *calib, *health, *midi;
+    uint32_t good, corrupt, lost, oversize;
+    int last_seq;
+    uint32_t last_time;
+    uint64_t time_high;     //Wraps of the 32 bit cycle counter
+};
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+//Seconds since the counter started, assuming frames are never 44s apart
+static double unwrap(Stream *s, uint32_t t) {
+    if (t < s->last_time) s->time_high += 1ULL << 32;
+    s->last_time = t;
+    return (double)(s->time_high + t) / CCLK_HZ;
+}
+
+static FILE *open_csv(const std::string &prefix, const char *name, const char *header) {
+    std::string path = prefix + "_" + name + ".csv";
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp) fprintf(fp, "%s\n", header);
+    else fprintf(stderr, "could not create %s\n", path.c_str());
+    return fp;
+}
+
+static void record(Stream *s, const uint8_t *frame, int length) {
+    if (length < 4 || tlm_crc16(frame, length - 2) != get16(frame + length - 2)) {
+        s->corrupt++;
+        return;
+    }
+    s->good++;
+    int seq = frame[1];
+    if (s->last_seq >= 0) s->lost += (uint8_t)(seq - s->last_seq - 1);
+    s->last_seq = seq;
+
+    const uint8_t *p = frame + 2;
+    int n = length - 4;
+    switch (frame[0]) {
+    case TLM_PITCH:
+        if (n < 16 || !s->pitch) break;
+        fprintf(s->pitch, "%.6f,%d,%.3f,%.3f,%.4f,%u,", unwrap(s, get32(p)), seq,
+            get32(p + 4) / 256.0, get32(p + 8) / 256.0, get16(p + 12) / 32767.0, get16(p + 14));
+        //Streams from before the calibration table end here
+        if (n >= 20) fprintf(s->pitch, "%.3f\n", get32(p + 16) / 256.0);
+        else fprintf(s->pitch, "\n");
+        break;
+    case TLM_TIMING: {
+        if (n < 5 || !s->timing) break;
+        int count = p[4];
+        if (n < 5 + 4 * count) break;
+        fprintf(s->timing, "%.6f,%d", unwrap(s, get32(p)), seq);
+        for (int i = 0; i < TLM_TIMING_STAGES; i++) {
+            if (i < count) fprintf(s->timing, ",%u", get32(p + 5 + 4 * i));
+            else fprintf(s->timing, ",");
+        }
+        fprintf(s->timing, "\n");
+        break;
+    }
+    case TLM_SPECTRUM: {
+        if (n < 9 || !s->spectrum) break;
+        int count = p[8];
+        if (n < 9 + count) break;
+        double t = unwrap(s, get32(p)), bin_hz = get32(p + 4) / 256.0;
+        //Long format, one row per level, 8 * log2 back to dB
+        for (int i = 0; i < count; i++) {
+            fprintf(s->spectrum, "%.6f,%d,%.1f,%.2f\n", t, seq, i * bin_hz, p[9 + i] * 6.0206 / 8);
+        }
+        break;
+    }
+    case TLM_STATUS:
+        if (n < 14 || !s->status) break;
+        fprintf(s->status, "%.6f,%d,%.1f,%u,%u,", unwrap(s, get32(p)), seq,
+            get16(p + 4) / 10.0, get32(p + 6), get32(p + 10));
+        //Streams from before lazy analysis end here
+        if (n >= 16) fprintf(s->status, "%.1f\n", get16(p + 14) / 10.0);
+        else fprintf(s->status, "\n");
+        break;
+    case TLM_CALIB: {
+        static const char *events[] = { "start", "point", "reject", "saved", "failed" };
+        if (n < 14 || !s->calib) break;
+        fprintf(s->calib, "%.6f,%d,%s,%u,%.3f,%.3f\n", unwrap(s, get32(p)), seq,
+            p[4] < 5 ? events[p[4]] : "?", p[5], get32(p + 6) / 256.0, get32(p + 10) / 256.0);
+        break;
+    }
+    case TLM_HEALTH:
+        if (n < 44 || !s->health) break;
+        fprintf(s->health, "%.6f,%d", unwrap(s, get32(p)), seq);
+        for (int i = 1; i <= 10; i++) fprintf(s->health, ",%u", get32(p + 4 * i));
+        //Frames from before the dropped block count end here
+        if (n >= 48) fprintf(s->health, ",%u\n", get32(p + 44));
+        else fprintf(s->health, ",\n");
+        break;
+    case TLM_MIDI:
+        if (n < 28 || !s->midi) break;
+        fprintf(s->midi, "%.6f,%d,%u,%u,%u,%u,%.1f,%.1f\n", unwrap(s, get32(p)), seq,
+            get32(p + 4), get32(p + 8), get32(p + 12), get32(p + 16),
+            get32(p + 20) * 1e6 / CCLK_HZ, get32(p + 24) * 1e6 / CCLK_HZ);
+        break;
+    case TLM_PROFILE: {
+        if (n < 23 || !s->profile) break;
+        int bins = p[21];
+        if (n < 22 + 2 * bins) break;
+        fprintf(s->profile, "%.6f,%d,%s,%u,%u,%u,%u", unwrap(s, get32(p)), seq, profile_name(p[4]),
+            get32(p + 5), get32(p + 9), get32(p + 13), get32(p + 17));
+        for (int b = 0; b < PROFILE_BINS; b++) {
+            if (b < bins) fprintf(s->profile, ",%u", get16(p + 22 + 2 * b));
+            else fprintf(s->profile, ",");
+        }
+        fprintf(s->profile, "\n");
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string prefix = "telemetry";
+    const char *path = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) prefix = argv[++i];
+        else if (argv[i][0] == '-' && argv[i][1]) {
+            fprintf(stderr, "usage: %s [-o prefix] [FILE]\n", argv[0]);
+            return 1;
+        } else path = argv[i];
+    }
+
+    FILE *in = path && strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!in) {
+        fprintf(stderr, "could not open %s\n", path);
+        return 1;
+    }
+
+    Stream s;
+    memset(&s, 0, sizeof(s));
+    s.last_seq = -1;
+    s.pitch = open_csv(prefix, "pitch", "time_s:f64,seq:u8,raw_hz:f64,tracked_hz:f64,confidence:f64,volume:u16,played_hz:f64");
+    s.timing = open_csv(prefix, "timing", "time_s:f64,seq:u8,unpack_cycles:u32,fft_cycles:u32,track_cycles:u32,total_cycles:u32");
+    s.spectrum = open_csv(prefix, "spectrum", "time_s:f64,seq:u8,freq_hz:f64,level_db:f64");
+    s.status = open_csv(prefix, "status", "time_s:f64,seq:u8,idle_pct:f64,frames_sent:u32,frames_dropped:u32,skip_pct:f64");
+    //One histogram column per bin, named after its lower edge in cycles
+    std::string header = "time_s:f64,seq:u8,scope:str,runs:u32,min_cycles:u32,mean_cycles:u32,max_cycles:u32";
+    for (int b = 0; b < PROFILE_BINS; b++) {
+        char column[32];
+        snprintf(column, sizeof(column), ",from_%u:u16", profile_bin_low(b));
+        header += column;
+    }
+    s.profile = open_csv(prefix, "profile", header.c_str());
+    s.calib = open_csv(prefix, "calib", "time_s:f64,seq:u8,event:str,points:u8,antenna_hz:f64,note_hz:f64");
+    s.health = open_csv(prefix, "health", "time_s:f64,seq:u8,adc_blocks:u32,adc_overruns:u32,adc_bad_words:u32,"
+        "adc_isr_late_max:u32,adc_dma_gap_max:u32,capture_dropped:u32,dac_blocks:u32,dac_late_rearms:u32,"
+        "dac_repeats:u32,dac_isr_late_max:u32,adc_blocks_dropped:u32");
+    s.midi = open_csv(prefix, "midi", "time_s:f64,seq:u8,messages:u32,bytes:u32,running_saved:u32,coalesced:u32,"
+        "latency_mean_us:f64,latency_max_us:f64");
+
+    uint8_t wire[MAX_WIRE], frame[MAX_WIRE];
+    int fill = 0;
+    bool skipping = true;   //Joined mid frame, wait for the first delimiter
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        if (c != 0) {
+            if (fill < MAX_WIRE) wire[fill] = (uint8_t)c;
+            fill++;
+            continue;
+        }
+        if (!skipping) {
+            if (fill > MAX_WIRE) {
+                s.oversize++;
+            } else {
+                int n = tlm_cobs_decode(wire, fill, frame);
+                if (n < 0) s.corrupt++;
+                else record(&s, frame, n);
+            }
+        }
+        skipping = false;
+        fill = 0;
+    }
+
+    if (s.pitch) fclose(s.pitch);
+    if (s.timing) fclose(s.timing);
+    if (s.spectrum) fclose(s.spectrum);
+    if (s.status) fclose(s.status);
+    if (s.profile) fclose(s.profile);
+    if (s.calib) fclose(s.calib);
+    if (s.health) fclose(s.health);
+    if (s.midi) fclose(s.midi);
+    if (in != stdin) fclose(in);
+
+    fprintf(stderr, "%u frames, %u corrupt, %u lost (seq gaps), %u oversize\n", s.good, s.corrupt, s.lost, s.oversize);
+    return 0;
+}
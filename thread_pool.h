@@ -0,0 +1,138 @@
+/*
+ * Work Stealing Thread Pool
+ * Objective: Keep every core of the analysis PC busy with offline jobs
+ *
+ * Each worker has its own deque. Jobs submitted from outside go round robin,
+ * jobs submitted from inside a job go to the submitting worker.
+ * A worker takes its newest job first (good cache locality) and when it runs dry
+ * steals the oldest job from another worker, so long runs spread out on their own.
+ *
+ * Host only (C++11), never built for the mbed.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    typedef std::function<void()> Job;
+
+    //threads == 0 means one per hardware thread
+    explicit ThreadPool(unsigned threads = 0) : queued(0), running(0), stopping(false), next(0) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; i++) workers.push_back(std::unique_ptr<Worker>(new Worker));
+        for (unsigned i = 0; i < threads; i++) pool.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+    }
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    void submit(Job job) {
+        unsigned target = current_worker();
+        if (target >= workers.size()) target = next++ % workers.size();
+        //Count it first so a worker that grabs it straight away never sees queued go negative
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queued++;
+        }
+        {
+            std::lock_guard<std::mutex> guard(workers[target]->lock);
+            workers[target]->jobs.push_back(job);
+        }
+        wake.notify_one();
+    }
+
+    //Blocks until every submitted job, including ones they submitted, has finished
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return queued == 0 && running == 0; });
+    }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> pool;
+
+    std::mutex lock;                //Guards queued, running and stopping
+    std::condition_variable wake;   //Work arrived or shutting down
+    std::condition_variable done;   //Pool went idle
+    size_t queued;
+    size_t running;
+    bool stopping;
+    std::atomic<unsigned> next;
+
+    static unsigned &current_worker() {
+        static thread_local unsigned index = ~0u;
+        return index;
+    }
+
+    bool take(unsigned self, Job &job) {
+        {
+            std::lock_guard<std::mutex> guard(workers[self]->lock);
+            if (!workers[self]->jobs.empty()) {
+                job = std::move(workers[self]->jobs.back());
+                workers[self]->jobs.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < workers.size(); i++) {
+            Worker &victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(unsigned self) {
+        current_worker() = self;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return queued > 0 || stopping; });
+                if (stopping && queued == 0) return;
+            }
+
+            Job job;
+            if (!take(self, job)) continue;     //Someone else got there first
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                queued--;
+                running++;
+            }
+
+            job();
+
+            std::lock_guard<std::mutex> guard(lock);
+            running--;
+            if (queued == 0 && running == 0) done.notify_all();
+        }
+    }
+};
+
+#endif
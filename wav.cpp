@@ -0,0 +1,47 @@
+/*
+ * WAV Writer
+ * See wav.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wav.h"
+
+struct WavHeader {
+    char     riff[4];           //"RIFF"
+    uint32_t riff_size;         //File size - 8
+    char     wave[4];           //"WAVE"
+    char     fmt[4];            //"fmt "
+    uint32_t fmt_size;          //16 for PCM
+    uint16_t format;            //1 = PCM
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits;
+    char     data[4];           //"data"
+    uint32_t data_size;
+};
+
+bool wav_write(const char *path, uint32_t sample_rate, const int16_t *samples, size_t count) {
+    WavHeader h;
+    memcpy(h.riff, "RIFF", 4);
+    memcpy(h.wave, "WAVE", 4);
+    memcpy(h.fmt, "fmt ", 4);
+    memcpy(h.data, "data", 4);
+    h.fmt_size = 16;
+    h.format = 1;
+    h.channels = 1;
+    h.sample_rate = sample_rate;
+    h.bits = 16;
+    h.block_align = h.channels * h.bits / 8;
+    h.byte_rate = sample_rate * h.block_align;
+    h.data_size = (uint32_t)(count * h.block_align);
+    h.riff_size = sizeof(h) - 8 + h.data_size;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return false;
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(samples, 2, count, fp) == count;
+    return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,18 @@
+/*
+ * WAV Writer
+ * Objective: Get simulated output somewhere it can be listened to
+ *
+ * 16 bit PCM, mono, little endian hosts only.
+ * Host only, never built for the mbed.
+ */
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Returns false if the file could not be written
+bool wav_write(const char *path, uint32_t sample_rate, const int16_t *samples, size_t count);
+
+#endif
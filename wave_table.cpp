@@ -0,0 +1,20 @@
+/*
+ * Wave Table
+ * See wave_table.h
+ */
+
+#include <math.h>
+
+#include "wave_table.h"
+
+void wave_table_init(int *table) {
+    //Quarter wave from sin(), the other three quarters by symmetry
+    for (int i =   0; i <=  90; i++) table[i] =  (512 * sin(3.14159/180.0 * i)) + 512;
+    for (int i =  91; i <= 180; i++) table[i] =  table[180 - i];
+    for (int i = 181; i <= 270; i++) table[i] =  512 - (table[i - 180] - 512);
+    for (int i = 271; i <  360; i++) table[i] =  512 - (table[360 - i] - 512);
+}
+
+void wave_table_encode(int *table, int length) {
+    for (int i = 0; i < length; i++) table[i] = dacr_encode(table[i]);
+}
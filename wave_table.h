@@ -0,0 +1,52 @@
+/*
+ * Wave Table
+ * Objective: One copy of the sine table and DACR encoding used by the DAC programs
+ *
+ * As specified in LPC17xx user manual(p583), the DACR Register controls the Voltage Output.
+ * Bit 16 of the DACR is the BIAS bit, set to 1 for a settling time of 2.5us, a max
+ * current of 350uA and a max update rate of 400kHz
+ * Bits 15:6 of the DACR is the VALUE field which contains the voltage output.
+ * Bits 5:0 of the DACR are reserved, and should not contain any value
+ */
+
+#ifndef WAVE_TABLE_H
+#define WAVE_TABLE_H
+
+#include <stdint.h>
+
+#define WAVE_TABLE_LENGTH 360   //One step per degree
+
+#define DACR_BIAS (1UL << 16)
+
+//PCLK_DAC at the default CCLK/4, the DAC counter decrements at this rate
+#define DAC_PCLK_HZ 24000000UL
+
+//Pulls the 10 bit VALUE field back out of a DACR word
+#define DACR_VALUE(w) (((w) >> 6) & 0x3FF)
+
+/*
+ * 10 bit sample to DACR word, (1 << 16) | (v << 6) & 0xFFC0
+ * Anything outside 0..1023 would wrap in VALUE (1024 comes out as 0V), so it is clamped
+ */
+static inline uint32_t dacr_encode(int v) {
+    if (v > 1023) v = 1023;
+    if (v < 0) v = 0;
+    return DACR_BIAS | (((uint32_t)v << 6) & 0xFFC0);
+}
+
+/*
+ * DACCNTVAL for an output frequency given as Hz * 256, rounded to nearest
+ * DACCNTVAL = 24Mhz/(f * WaveTableSize), the formula from dac_dma.cpp
+ */
+static inline uint32_t dac_count_for(uint32_t freq_q8, int table_length) {
+    uint64_t den = (uint64_t)freq_q8 * table_length;
+    return (uint32_t)(((uint64_t)DAC_PCLK_HZ * 256 + den / 2) / den);
+}
+
+//Generation of a Sine Wave of 360 Points, 10 bit values centered on 512
+void wave_table_init(int *table);
+
+//Converts a table of 10 bit values in place into DACR words
+void wave_table_encode(int *table, int length);
+
+#endif